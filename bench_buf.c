@@ -0,0 +1,481 @@
+/**
+ * @file bench_buf.c
+ *
+ * @brief      benchmark of ring_buf.h, fifo_buf.h, fifo_buf_spsc.h and
+ *             fifo_buf_mpmc.h
+ *
+ *             Reports ns/op for rc_ringbuf_insert, rc_ringbuf_get_value,
+ *             rc_fifobuf_push and rc_fifobuf_pop along with their unchecked
+ *             and bulk variants for buffer sizes from 8 to 1M elements and
+ *             element types from int to a 64-byte struct, and rc_ringbuf_dot
+ *             over the whole of a double buffer up to 4096 elements against
+ *             the same sum through rc_ringbuf_get_value. It finishes with
+ *             cross-thread throughput and latency percentiles for the spsc
+ *             fifo, flat out, in lockstep and paced at a fixed rate, each
+ *             with its indices published on every entry and in batches so
+ *             the gain in throughput can be weighed against the time
+ *             entries wait for their batch. Then it measures throughput
+ *             of the mpmc fifo against an rc_fifobuf_t wrapped in a mutex
+ *             with 1 to 8 producer/consumer pairs. Every result is one line
+ *             of whitespace separated key=value fields so runs from
+ *             different releases and machines can be diffed or loaded into
+ *             a spreadsheet.
+ *
+ *             Build with optimization and pthreads, for example:
+ *
+ *             gcc -O2 -pthread bench_buf.c -o bench_buf
+ *             ./bench_buf [scale]
+ *
+ *             where the optional scale multiplies the number of operations
+ *             timed per case, default 1.0.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+typedef struct bench64_t {
+	double v[8];
+} bench64_t;
+
+typedef struct bench_msg_t {
+	uint64_t ns;	///< time the message was pushed
+	uint64_t seq;	///< sequence number
+} bench_msg_t;
+
+#define RINGBUF_TYPE int
+#define RINGBUF_NAME i32
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#define RINGBUF_TYPE double
+#define RINGBUF_NAME f64
+#define RC_RINGBUF_DOUBLE
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#undef RC_RINGBUF_DOUBLE
+#define RINGBUF_TYPE bench64_t
+#define RINGBUF_NAME s64
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+
+#define FIFOBUF_TYPE int
+#define FIFOBUF_NAME i32
+#include "fifo_buf.h"
+#undef FIFOBUF_TYPE
+#undef FIFOBUF_NAME
+#define FIFOBUF_TYPE double
+#define FIFOBUF_NAME f64
+#include "fifo_buf.h"
+#undef FIFOBUF_TYPE
+#undef FIFOBUF_NAME
+#define FIFOBUF_TYPE bench64_t
+#define FIFOBUF_NAME s64
+#include "fifo_buf.h"
+#undef FIFOBUF_TYPE
+#undef FIFOBUF_NAME
+#define FIFOBUF_TYPE bench_msg_t
+#define FIFOBUF_NAME msg
+#include "fifo_buf_spsc.h"
+#undef FIFOBUF_TYPE
+#undef FIFOBUF_NAME
+#define FIFOBUF_TYPE int
+#define FIFOBUF_NAME i32
+#include "fifo_buf_mpmc.h"
+#undef FIFOBUF_TYPE
+#undef FIFOBUF_NAME
+
+
+#define MIN_SIZE	8
+#define MAX_SIZE	(1<<20)
+#define DOT_MAX_SIZE	4096
+#define OPS		(1<<22)
+#define SPSC_SIZE	1024
+#define SPSC_MSGS	(1<<21)
+#define LATENCY_MSGS	(1<<16)
+#define PACE_NS		1000
+#define MPMC_SIZE	1024
+#define MPMC_MSGS	(1<<21)
+#define MPMC_MAX_THREADS	8
+
+static double scale = 1.0;
+static volatile double sink;
+
+static uint64_t nanos(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+// number of operations to time, at least a few passes over the buffer
+static long ops_for(int size)
+{
+	long ops = (long)(OPS*scale);
+	if(ops<4L*size) ops = 4L*size;
+	return ops;
+}
+
+static void report(const char* op, const char* type, int size, long ops, uint64_t ns)
+{
+	printf("op=%-28s type=%-4s size=%-8d ns/op=%.3f\n", op, type, size,
+							(double)ns/(double)ops);
+}
+
+static inline int mk_i32(long i){ return (int)i; }
+static inline double val_i32(int x){ return x; }
+static inline double mk_f64(long i){ return (double)i; }
+static inline double val_f64(double x){ return x; }
+static inline bench64_t mk_s64(long i){ bench64_t x = {{(double)i}}; return x; }
+static inline double val_s64(bench64_t x){ return x.v[0]; }
+
+/*
+ * Generates the single threaded benchmarks for one element type. The fifo
+ * cases time pushes into an empty buffer until it's full, emptying it again
+ * with an O(1) rc_fifobuf_release, and pops from a buffer refilled with an
+ * O(1) rc_fifobuf_commit, so each loop only times the operation of interest.
+ */
+#define BENCH_TYPE(NAME, TYPE)							\
+static void bench_ring_##NAME(int size)						\
+{										\
+	long i, ops = ops_for(size);						\
+	int j, half = (size+1)/2;						\
+	uint64_t t;								\
+	double acc = 0;								\
+	TYPE v = mk_##NAME(0);							\
+	TYPE* blk = (TYPE*)calloc(half, sizeof(TYPE));				\
+	rc_ringbuf_##NAME##_t buf = RC_RINGBUF_INITIALIZER;			\
+	rc_ringbuf_##NAME##_alloc(&buf, size);					\
+	t = nanos();								\
+	for(i=0;i<ops;i++) rc_ringbuf_##NAME##_insert(&buf, mk_##NAME(i));	\
+	report("ringbuf_insert", #NAME, size, ops, nanos()-t);			\
+	t = nanos();								\
+	for(i=0;i<ops;i++) rc_ringbuf_##NAME##_insert_unchecked(&buf, mk_##NAME(i)); \
+	report("ringbuf_insert_unchecked", #NAME, size, ops, nanos()-t);	\
+	/* blocks of half the buffer so every other one wraps */		\
+	for(j=0;j<half;j++) blk[j] = mk_##NAME(j);				\
+	t = nanos();								\
+	for(i=0;i<ops;i+=half) rc_ringbuf_##NAME##_insert_n(&buf, blk, half);	\
+	report("ringbuf_insert_n", #NAME, size, i, nanos()-t);			\
+	t = nanos();								\
+	for(i=0;i<ops;i++){							\
+		rc_ringbuf_##NAME##_get_value(&buf, (int)(i&(size-1)), &v);	\
+		acc += val_##NAME(v);						\
+	}									\
+	report("ringbuf_get_value", #NAME, size, ops, nanos()-t);		\
+	t = nanos();								\
+	for(i=0;i<ops;i++){							\
+		v = rc_ringbuf_##NAME##_get_value_unchecked(&buf, (int)(i&(size-1))); \
+		acc += val_##NAME(v);						\
+	}									\
+	report("ringbuf_get_value_unchecked", #NAME, size, ops, nanos()-t);	\
+	rc_ringbuf_##NAME##_free(&buf);						\
+	free(blk);								\
+	sink = acc;								\
+}										\
+										\
+static void bench_fifo_##NAME(int size)						\
+{										\
+	long i, j, ops = ops_for(size);						\
+	uint64_t t;								\
+	double acc = 0;								\
+	TYPE v = mk_##NAME(0);							\
+	TYPE* blk = (TYPE*)calloc(size, sizeof(TYPE));				\
+	rc_fifobuf_##NAME##_t buf = RC_FIFOBUF_INITIALIZER;			\
+	rc_fifobuf_##NAME##_alloc(&buf, size);					\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		for(j=0;j<size;j++) rc_fifobuf_##NAME##_push(&buf, mk_##NAME(i+j)); \
+		rc_fifobuf_##NAME##_release(&buf, size);			\
+	}									\
+	report("fifobuf_push", #NAME, size, i, nanos()-t);			\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		rc_fifobuf_##NAME##_commit(&buf, size);				\
+		for(j=0;j<size;j++){						\
+			rc_fifobuf_##NAME##_pop(&buf, &v);			\
+			acc += val_##NAME(v);					\
+		}								\
+	}									\
+	report("fifobuf_pop", #NAME, size, i, nanos()-t);			\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		for(j=0;j<size;j++) rc_fifobuf_##NAME##_push_unchecked(&buf, mk_##NAME(i+j)); \
+		rc_fifobuf_##NAME##_release(&buf, size);			\
+	}									\
+	report("fifobuf_push_unchecked", #NAME, size, i, nanos()-t);		\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		rc_fifobuf_##NAME##_commit(&buf, size);				\
+		for(j=0;j<size;j++){						\
+			v = rc_fifobuf_##NAME##_pop_unchecked(&buf);		\
+			acc += val_##NAME(v);					\
+		}								\
+	}									\
+	report("fifobuf_pop_unchecked", #NAME, size, i, nanos()-t);		\
+	for(j=0;j<size;j++) blk[j] = mk_##NAME(j);				\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		rc_fifobuf_##NAME##_push_n(&buf, blk, size);			\
+		rc_fifobuf_##NAME##_release(&buf, size);			\
+	}									\
+	report("fifobuf_push_n", #NAME, size, i, nanos()-t);			\
+	t = nanos();								\
+	for(i=0;i<ops;i+=size){							\
+		rc_fifobuf_##NAME##_commit(&buf, size);				\
+		rc_fifobuf_##NAME##_pop_n(&buf, blk, size);			\
+		acc += val_##NAME(blk[0]);					\
+	}									\
+	report("fifobuf_pop_n", #NAME, size, i, nanos()-t);			\
+	rc_fifobuf_##NAME##_free(&buf);						\
+	free(blk);								\
+	sink = acc;								\
+}
+
+BENCH_TYPE(i32, int)
+BENCH_TYPE(f64, double)
+BENCH_TYPE(s64, bench64_t)
+
+// an FIR filter over the whole buffer each step, rc_ringbuf_dot against the
+// same sum done with rc_ringbuf_get_value
+static void bench_dot(int size)
+{
+	long i, ops = ops_for(size)/size+1;
+	int k;
+	uint64_t t;
+	double acc = 0, out = 0, v = 0;
+	double* coeffs = (double*)malloc(size*sizeof(double));
+	rc_ringbuf_f64_t buf = RC_RINGBUF_INITIALIZER;
+	rc_ringbuf_f64_alloc(&buf, size);
+	for(k=0;k<size;k++) coeffs[k] = 1.0/(k+1);
+	t = nanos();
+	for(i=0;i<ops;i++){
+		rc_ringbuf_f64_insert_unchecked(&buf, (double)i);
+		rc_ringbuf_f64_dot(&buf, coeffs, size, &out);
+		acc += out;
+	}
+	report("ringbuf_dot", "f64", size, ops, nanos()-t);
+	t = nanos();
+	for(i=0;i<ops;i++){
+		rc_ringbuf_f64_insert_unchecked(&buf, (double)i);
+		out = 0;
+		for(k=0;k<size;k++){
+			rc_ringbuf_f64_get_value(&buf, k, &v);
+			out += coeffs[size-1-k]*v;
+		}
+		acc += out;
+	}
+	report("ringbuf_dot_get_value_loop", "f64", size, ops, nanos()-t);
+	rc_ringbuf_f64_free(&buf);
+	free(coeffs);
+	sink = acc;
+}
+
+
+static rc_fifobuf_spsc_msg_t spsc = RC_FIFOBUF_SPSC_INITIALIZER;
+static volatile int spsc_mode;
+
+// modes of bench_spsc
+#define SPSC_FLAT_OUT	0
+#define SPSC_LOCKSTEP	1
+#define SPSC_PACED	2
+
+static void* spsc_producer(void* arg)
+{
+	long i, n = *(long*)arg;
+	uint64_t next = nanos();
+	bench_msg_t m;
+	for(i=0;i<n;i++){
+		// in lockstep mode wait for the consumer so we measure latency of
+		// an idle queue instead of time spent queued behind other entries
+		if(spsc_mode==SPSC_LOCKSTEP) while(rc_fifobuf_spsc_msg_available(&spsc)) sched_yield();
+		// paced like a sensor, so batched entries wait for the rest of
+		// their batch to arrive
+		if(spsc_mode==SPSC_PACED){
+			next += PACE_NS;
+			while(nanos()<next);
+		}
+		m.seq = i;
+		m.ns = nanos();
+		while(rc_fifobuf_spsc_msg_push(&spsc, m)) sched_yield();
+	}
+	rc_fifobuf_spsc_msg_flush(&spsc);
+	return NULL;
+}
+
+static int cmp_u64(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x>y)-(x<y);
+}
+
+static void bench_spsc(const char* op, long n, int mode, int batch)
+{
+	long i;
+	uint64_t t, *lat;
+	bench_msg_t m;
+	pthread_t thread;
+
+	lat = (uint64_t*)malloc(n*sizeof(uint64_t));
+	spsc_mode = mode;
+	rc_fifobuf_spsc_msg_alloc(&spsc, SPSC_SIZE);
+	rc_fifobuf_spsc_msg_set_batch(&spsc, batch);
+	t = nanos();
+	pthread_create(&thread, NULL, spsc_producer, &n);
+	for(i=0;i<n;i++){
+		while(rc_fifobuf_spsc_msg_pop(&spsc, &m)) sched_yield();
+		lat[i] = nanos()-m.ns;
+	}
+	t = nanos()-t;
+	pthread_join(thread, NULL);
+	rc_fifobuf_spsc_msg_free(&spsc);
+
+	qsort(lat, n, sizeof(uint64_t), cmp_u64);
+	printf("op=%-28s size=%-8d batch=%-4d msgs/s=%.0f p50_ns=%llu p90_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu\n",
+		op, SPSC_SIZE, batch, n/(t*1e-9),
+		(unsigned long long)lat[n/2],
+		(unsigned long long)lat[n*9/10],
+		(unsigned long long)lat[n*99/100],
+		(unsigned long long)lat[n*999/1000],
+		(unsigned long long)lat[n-1]);
+	free(lat);
+}
+
+
+static rc_fifobuf_mpmc_i32_t mpmc = RC_FIFOBUF_MPMC_INITIALIZER;
+static rc_fifobuf_i32_t locked = RC_FIFOBUF_INITIALIZER;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int use_mutex;
+
+// the baseline being replaced, one mutex around a plain fifo
+static inline int mpmc_push(int val)
+{
+	int ret;
+	if(!use_mutex) return rc_fifobuf_mpmc_i32_push(&mpmc, val);
+	pthread_mutex_lock(&lock);
+	ret = rc_fifobuf_i32_push(&locked, val);
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+static inline int mpmc_pop(int* val)
+{
+	int ret;
+	if(!use_mutex) return rc_fifobuf_mpmc_i32_pop(&mpmc, val);
+	pthread_mutex_lock(&lock);
+	ret = rc_fifobuf_i32_pop(&locked, val);
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+static void* mpmc_producer(void* arg)
+{
+	long i, n = *(long*)arg;
+	for(i=0;i<n;i++){
+		while(mpmc_push((int)i)) sched_yield();
+	}
+	return NULL;
+}
+
+static void* mpmc_consumer(void* arg)
+{
+	long i, n = *(long*)arg;
+	int val;
+	double sum = 0;
+	for(i=0;i<n;i++){
+		while(mpmc_pop(&val)) sched_yield();
+		sum += val;
+	}
+	sink = sum;
+	return NULL;
+}
+
+static void bench_mpmc(const char* op, int threads, long n, int mode)
+{
+	int i;
+	uint64_t t;
+	pthread_t prod[MPMC_MAX_THREADS], cons[MPMC_MAX_THREADS];
+	long per_thread = n/threads + 1;
+
+	use_mutex = mode;
+	rc_fifobuf_mpmc_i32_alloc(&mpmc, MPMC_SIZE);
+	rc_fifobuf_i32_alloc(&locked, MPMC_SIZE);
+	t = nanos();
+	for(i=0;i<threads;i++){
+		pthread_create(&cons[i], NULL, mpmc_consumer, &per_thread);
+		pthread_create(&prod[i], NULL, mpmc_producer, &per_thread);
+	}
+	for(i=0;i<threads;i++){
+		pthread_join(prod[i], NULL);
+		pthread_join(cons[i], NULL);
+	}
+	t = nanos()-t;
+	rc_fifobuf_mpmc_i32_free(&mpmc);
+	rc_fifobuf_i32_free(&locked);
+
+	printf("op=%-28s size=%-8d threads=%-2d msgs/s=%.0f\n",
+		op, MPMC_SIZE, threads, per_thread*threads/(t*1e-9));
+}
+
+int main(int argc, char* argv[])
+{
+	int size, threads, batch;
+
+	if(argc>1) scale = atof(argv[1]);
+	if(scale<=0){
+		fprintf(stderr,"usage: %s [scale]\n", argv[0]);
+		return -1;
+	}
+
+	printf("# compiler=%s", __VERSION__);
+#if defined(__x86_64__)
+	printf(" arch=x86_64");
+#elif defined(__aarch64__)
+	printf(" arch=aarch64");
+#elif defined(__arm__)
+	printf(" arch=arm");
+#endif
+	printf(" scale=%g\n", scale);
+
+	for(size=MIN_SIZE;size<=MAX_SIZE;size*=8){
+		bench_ring_i32(size);
+		bench_ring_f64(size);
+		bench_ring_s64(size);
+		bench_fifo_i32(size);
+		bench_fifo_f64(size);
+		bench_fifo_s64(size);
+		if(size<=DOT_MAX_SIZE) bench_dot(size);
+	}
+	// make sure the largest size is always covered
+	if(size/8!=MAX_SIZE){
+		bench_ring_i32(MAX_SIZE);
+		bench_ring_f64(MAX_SIZE);
+		bench_ring_s64(MAX_SIZE);
+		bench_fifo_i32(MAX_SIZE);
+		bench_fifo_f64(MAX_SIZE);
+		bench_fifo_s64(MAX_SIZE);
+	}
+
+	for(batch=1;batch<=64;batch*=4){
+		bench_spsc("spsc_throughput", (long)(SPSC_MSGS*scale)+1, SPSC_FLAT_OUT, batch);
+	}
+	bench_spsc("spsc_latency", (long)(LATENCY_MSGS*scale)+1, SPSC_LOCKSTEP, 1);
+	for(batch=1;batch<=64;batch*=4){
+		bench_spsc("spsc_paced_latency", (long)(LATENCY_MSGS*scale)+1, SPSC_PACED, batch);
+	}
+
+	for(threads=1;threads<=MPMC_MAX_THREADS;threads*=2){
+		bench_mpmc("mpmc_throughput", threads, (long)(MPMC_MSGS*scale), 0);
+		bench_mpmc("mutex_fifo_throughput", threads, (long)(MPMC_MSGS*scale), 1);
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * "buf_alloc.h"
+ *
+ * @brief      aligned allocation shared by the ring and fifo buffers
+ *
+ * By default buffers get their memory from calloc which only guarantees
+ * malloc's alignment, usually 16 bytes. Defining RC_RINGBUF_ALIGN or
+ * RC_FIFOBUF_ALIGN to a power of two before including the buffer headers makes
+ * their alloc functions start the data on that boundary instead, e.g. 64 or
+ * 128 for a cache line so SIMD loads never split one, and round the length
+ * up to a whole number of boundaries so nothing else shares the last line.
+ * Alignments of RC_BUF_HUGEPAGE or more are meant for big buffers, the memory
+ * is also advised as a transparent huge page candidate on Linux to cut TLB
+ * misses when walking it.
+ *
+ * Memory from here is released with plain free. This header is included by
+ * the buffer headers and does not need to be included directly. It does not
+ * depend on the buffer type and is only expanded once.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_BUF_ALLOC_H
+#define RC_BUF_ALLOC_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// size of a huge page on x86_64 and aarch64 with 4k base pages
+#ifndef RC_BUF_HUGEPAGE
+#define RC_BUF_HUGEPAGE (2*1024*1024)
+#endif
+
+
+/**
+ * Allocates n zero'd elements of elem_size bytes each starting on an align
+ * byte boundary. align must be 0 or a power of two, 0 behaves like calloc.
+ *
+ * @return     pointer to the memory or NULL on failure
+ */
+static inline void* __rc_buf_alloc(size_t n, size_t elem_size, size_t align)
+{
+	void* p;
+	size_t bytes = n*elem_size;
+
+	if(align==0) return calloc(n, elem_size);
+	if(elem_size && bytes/elem_size!=n) return NULL;
+	// aligned_alloc wants a whole number of boundaries
+	bytes = (bytes+align-1) & ~(align-1);
+	if(bytes==0) bytes = align;
+	p = aligned_alloc(align, bytes);
+	if(p==NULL) return NULL;
+#ifdef MADV_HUGEPAGE
+	// only a hint, nothing to do if the kernel says no
+	if(align>=RC_BUF_HUGEPAGE) madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+	memset(p, 0, bytes);
+	return p;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_BUF_ALLOC_H
@@ -0,0 +1,159 @@
+/**
+ * "buf_counters.h"
+ *
+ * @brief      optional instrumentation counters shared by the ring and fifo
+ *             buffers
+ *
+ * A failed push to a full fifo is silent and nothing records how close to
+ * full a buffer ran, so under load there is no way to tell whether it is
+ * sized right. Defining RC_BUF_COUNTERS before including the buffer headers
+ * gives each ring and fifo buffer a set of counters. The buffer's counters
+ * function copies them into an rc_buf_counters_t snapshot which can be
+ * exported to a metrics system. Without RC_BUF_COUNTERS the counters and
+ * snapshot functions don't exist and the buffers compile exactly as before.
+ * Since the counters change the struct layouts, define it the same way
+ * everywhere, including every process sharing an spsc buffer.
+ *
+ * The counters only ever go up, they are cleared by the buffers' alloc,
+ * init and reset functions, so export differences between snapshots for
+ * rates. The single threaded buffers count with plain increments. The spsc
+ * buffer keeps one set of counters for the producer and one for the
+ * consumer, each on that side's cache line and only written by that side, so
+ * a count is a relaxed load and store with no locked instruction. The mpmc
+ * buffer's counters are written by every thread with relaxed atomic adds on
+ * a cache line of their own, which costs one contended add per operation.
+ *
+ * This header is included by the buffer headers and does not need to be
+ * included directly. It does not depend on the buffer type and is only
+ * expanded once.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_BUF_COUNTERS_H
+#define RC_BUF_COUNTERS_H
+
+#include <stdint.h>
+#if defined(RC_BUF_COUNTERS) && !defined(__cplusplus)
+#include <stdatomic.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief      Snapshot of a buffer's counters. Fields which don't apply to a
+ * buffer type stay 0.
+ */
+typedef struct rc_buf_counters_t {
+	uint64_t pushes;	///< entries pushed, or values inserted into a ring
+	uint64_t pops;		///< entries popped or released
+	uint64_t rejected;	///< pushes which gave up on a full buffer, once per push_wait timeout
+	uint64_t overwrites;	///< old entries discarded to make room for new ones
+	uint64_t peak;		///< most entries waiting at once, count for a ring
+	uint64_t retries;	///< compare and swaps lost to another thread
+	uint64_t waits;		///< times a push_wait or pop_wait had to park
+} rc_buf_counters_t;
+
+
+#ifdef RC_BUF_COUNTERS
+
+// plain counting for buffers only used from one thread
+#define __RC_BUF_COUNT(c, field, n)	((c).field += (uint64_t)(n))
+#define __RC_BUF_PEAK(c, n)	do{ if((uint64_t)(n)>(c).peak) (c).peak=(uint64_t)(n); }while(0)
+
+#ifndef __cplusplus
+/**
+ * Counters of the thread safe buffers, read while they are in use so they
+ * are atomics like everything else the threads share.
+ */
+typedef struct rc_buf_atomic_counters_t {
+	atomic_ullong pushes;
+	atomic_ullong pops;
+	atomic_ullong rejected;
+	atomic_ullong overwrites;
+	atomic_ullong peak;
+	atomic_ullong retries;
+	atomic_ullong waits;
+} rc_buf_atomic_counters_t;
+
+// for counters with only one writer, no locked instruction needed
+static inline void __rc_buf_count_owned(atomic_ullong* c, uint64_t n)
+{
+	atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed)+n, memory_order_relaxed);
+}
+
+// for counters written by any number of threads
+static inline void __rc_buf_count_shared(atomic_ullong* c, uint64_t n)
+{
+	atomic_fetch_add_explicit(c, n, memory_order_relaxed);
+}
+
+// raises peak to n, only touching the line with a write when it is a new peak
+static inline void __rc_buf_peak_owned(atomic_ullong* peak, uint64_t n)
+{
+	if(n>atomic_load_explicit(peak, memory_order_relaxed)){
+		atomic_store_explicit(peak, n, memory_order_relaxed);
+	}
+}
+
+static inline void __rc_buf_peak_shared(atomic_ullong* peak, uint64_t n)
+{
+	unsigned long long p = atomic_load_explicit(peak, memory_order_relaxed);
+	while(n>p){
+		if(atomic_compare_exchange_weak_explicit(peak, &p, n,
+				memory_order_relaxed, memory_order_relaxed)) break;
+	}
+}
+
+static inline void __rc_buf_counters_clear(rc_buf_atomic_counters_t* c)
+{
+	atomic_store_explicit(&c->pushes, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->pops, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->rejected, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->overwrites, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->peak, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->retries, 0, memory_order_relaxed);
+	atomic_store_explicit(&c->waits, 0, memory_order_relaxed);
+}
+
+// adds c into out, taking the larger peak, so several sets can be merged
+static inline void __rc_buf_counters_add(rc_buf_counters_t* out, rc_buf_atomic_counters_t* c)
+{
+	uint64_t peak = atomic_load_explicit(&c->peak, memory_order_relaxed);
+	out->pushes += atomic_load_explicit(&c->pushes, memory_order_relaxed);
+	out->pops += atomic_load_explicit(&c->pops, memory_order_relaxed);
+	out->rejected += atomic_load_explicit(&c->rejected, memory_order_relaxed);
+	out->overwrites += atomic_load_explicit(&c->overwrites, memory_order_relaxed);
+	out->retries += atomic_load_explicit(&c->retries, memory_order_relaxed);
+	out->waits += atomic_load_explicit(&c->waits, memory_order_relaxed);
+	if(peak>out->peak) out->peak = peak;
+}
+
+#define __RC_BUF_COUNT_OWNED(c, field, n)	__rc_buf_count_owned(&(c).field, (uint64_t)(n))
+#define __RC_BUF_COUNT_SHARED(c, field, n)	__rc_buf_count_shared(&(c).field, (uint64_t)(n))
+#define __RC_BUF_PEAK_OWNED(c, n)	__rc_buf_peak_owned(&(c).peak, (uint64_t)(n))
+#define __RC_BUF_PEAK_SHARED(c, n)	__rc_buf_peak_shared(&(c).peak, (uint64_t)(n))
+#endif // __cplusplus
+
+#else
+
+#define __RC_BUF_COUNT(c, field, n)	((void)0)
+#define __RC_BUF_PEAK(c, n)	((void)0)
+#define __RC_BUF_COUNT_OWNED(c, field, n)	((void)0)
+#define __RC_BUF_COUNT_SHARED(c, field, n)	((void)0)
+#define __RC_BUF_PEAK_OWNED(c, n)	((void)0)
+#define __RC_BUF_PEAK_SHARED(c, n)	((void)0)
+
+#endif // RC_BUF_COUNTERS
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_BUF_COUNTERS_H
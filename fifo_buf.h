@@ -7,6 +7,39 @@
  * The user creates their own instance of a buffer and passes a pointer to the
  * these functions to perform normal operations.
  *
+ * All functions are static inline so this header may be included from as
+ * many .c files as needed. To use more than one FIFOBUF_TYPE in a program
+ * also #define FIFOBUF_NAME before each include. The buffer type and
+ * functions then take that name, e.g. with FIFOBUF_NAME f32 the type is
+ * rc_fifobuf_f32_t and the functions are rc_fifobuf_f32_push etc. Without
+ * FIFOBUF_NAME they keep the plain rc_fifobuf_t and rc_fifobuf_* names.
+ * #undef FIFOBUF_TYPE and FIFOBUF_NAME before including the header again.
+ *
+ * Instead of rc_fifobuf_alloc a buffer may be given memory of the user's
+ * choosing, such as a static array, a pool or shared memory, with
+ * rc_fifobuf_init_static. RC_FIFOBUF_DECLARE_STATIC declares a buffer and its
+ * storage at file scope so it lives in .bss and needs no allocator at all.
+ *
+ * By default pushing to a full buffer fails. After
+ * rc_fifobuf_set_overwrite(buf, 1) it instead discards the oldest entry to
+ * make room, like a ring buffer, while entries are still only read once.
+ * rc_fifobuf_dropped counts the entries lost this way.
+ *
+ * A buffer sized for its worst case burst wastes memory the rest of the time.
+ * rc_fifobuf_set_growth instead lets it start small and grow geometrically
+ * up to a hard ceiling when a push finds it full, moving the queued entries
+ * across rather than dropping them, and optionally shrink back after staying
+ * nearly empty for a while.
+ *
+ * #define RC_FIFOBUF_ALIGN to a power of two such as 64 or 128 before including
+ * to have the alloc functions of this and the thread safe fifo buffers start
+ * the data on that boundary, or to RC_BUF_HUGEPAGE for big buffers to back
+ * them with huge pages where the system allows it, see buf_alloc.h.
+ *
+ * With RC_BUF_COUNTERS defined the buffer also counts entries pushed, popped,
+ * rejected and overwritten and the most ever waiting at once, read with
+ * rc_fifobuf_counters, see buf_counters.h.
+ *
  * @author     James Strawson
  * @date       2019
  *
@@ -17,6 +50,10 @@
 #error "ERROR user must #define FIFOBUF_TYPE before including fifo_buf.h"
 #endif
 
+#include <sys/mman.h>
+#include "buf_alloc.h"
+#include "buf_counters.h"
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -29,26 +66,317 @@ extern "C" {
 #define likely(x)   __builtin_expect (!!(x), 1)
 #endif
 
+// alignment of the memory from rc_fifobuf_alloc in bytes, 0 for malloc's
+#ifndef RC_FIFOBUF_ALIGN
+#define RC_FIFOBUF_ALIGN 0
+#endif
+
+// name mangling for this instantiation, these stay defined until the header
+// is included again and always refer to the most recent FIFOBUF_TYPE
+#define __RC_FIFOBUF_CAT_(a,b,c)    a##b##c
+#define __RC_FIFOBUF_CAT(a,b,c)     __RC_FIFOBUF_CAT_(a,b,c)
+#undef RC_FIFOBUF_T
+#undef RC_FIFOBUF_SPAN_T
+#undef RC_FIFOBUF_FN
+#undef RC_FIFOBUF_PRIV
+#ifdef FIFOBUF_NAME
+#define RC_FIFOBUF_T        __RC_FIFOBUF_CAT(rc_fifobuf_, FIFOBUF_NAME, _t)
+#define RC_FIFOBUF_SPAN_T   __RC_FIFOBUF_CAT(rc_fifobuf_, FIFOBUF_NAME, _span_t)
+#define RC_FIFOBUF_FN(f)    __RC_FIFOBUF_CAT(rc_fifobuf_, FIFOBUF_NAME, _##f)
+#define RC_FIFOBUF_PRIV(f)  __RC_FIFOBUF_CAT(__rc_fifobuf_, FIFOBUF_NAME, _##f)
+#else
+#define RC_FIFOBUF_T        rc_fifobuf_t
+#define RC_FIFOBUF_SPAN_T   rc_fifobuf_span_t
+#define RC_FIFOBUF_FN(f)    rc_fifobuf_##f
+#define RC_FIFOBUF_PRIV(f)  __rc_fifobuf_##f
+#endif
+
 
 /**
  * @brief      Struct containing state of a fifobuffer and pointer to
  * dynamically allocated memory.
  */
-typedef struct rc_fifobuf_t {
+typedef struct RC_FIFOBUF_T {
     FIFOBUF_TYPE* d;    ///< pointer to dynamically allocated data
     int size;           ///< number of elements the buffer can hold
+#ifdef RC_FIFOBUF_POW2
+    unsigned int mask;  ///< length of d minus 1, d is a power of two long
+    unsigned int head;  ///< free-running count of entries pushed
+    unsigned int tail;  ///< free-running count of entries popped
+#else
     int tail;           ///< index of the next value to be read
     int available;      ///< number of entried waiting to be read
+#endif
     int initialized;    ///< flag indicating if memory has been allocated for the buffer
-} rc_fifobuf_t;
+    int user_mem;       ///< flag indicating d was provided by the user and must not be freed
+    int overwrite;      ///< flag indicating push discards the oldest entry when full
+    unsigned long dropped; ///< number of entries discarded by overwriting pushes
+    int max_size;       ///< size a growable buffer may grow to, 0 if it never grows
+    int min_size;       ///< size a growable buffer never shrinks below
+    int shrink_after;   ///< pops under a quarter full before shrinking, 0 to never shrink
+    int low_water;      ///< pops in a row which found the buffer under a quarter full
+    int peeked;         ///< entries handed out by the last peek and not released yet
+    int peek_lost;      ///< of those, how many overwriting pushes have dropped since
+#ifdef RC_BUF_COUNTERS
+    rc_buf_counters_t counters; ///< instrumentation, see buf_counters.h
+#endif
+} RC_FIFOBUF_T;
+
+
+/**
+ * @brief      Up to two contiguous segments of a fifo buffer's memory, used by
+ * the zero-copy reserve/commit and peek/release functions.
+ *
+ * When a block of entries wraps around the end of the backing memory the
+ * first segment runs to the end of memory and the second starts back at the
+ * beginning. Otherwise the second segment is empty.
+ */
+typedef struct RC_FIFOBUF_SPAN_T {
+    FIFOBUF_TYPE* d[2]; ///< pointer to the start of each segment
+    int len[2];         ///< number of entries in each segment, len[1] may be 0
+} RC_FIFOBUF_SPAN_T;
 
 
+// the index fields depend on RC_FIFOBUF_POW2 and are left to be zero
+// initialized so the same macro works for every instantiation
 #define RC_FIFOBUF_INITIALIZER {\
     .d = NULL,\
     .size = 0,\
+    .initialized = 0,\
+    .user_mem = 0}
+
+/**
+ * Smallest power of two >= n for n>=2, as a constant expression.
+ */
+#ifndef RC_FIFOBUF_NEXT_POW2
+#define __RC_FIFOBUF_SMEAR1(x)  ((x)|((x)>>1))
+#define __RC_FIFOBUF_SMEAR2(x)  (__RC_FIFOBUF_SMEAR1(x)|(__RC_FIFOBUF_SMEAR1(x)>>2))
+#define __RC_FIFOBUF_SMEAR4(x)  (__RC_FIFOBUF_SMEAR2(x)|(__RC_FIFOBUF_SMEAR2(x)>>4))
+#define __RC_FIFOBUF_SMEAR8(x)  (__RC_FIFOBUF_SMEAR4(x)|(__RC_FIFOBUF_SMEAR4(x)>>8))
+#define __RC_FIFOBUF_SMEAR16(x) (__RC_FIFOBUF_SMEAR8(x)|(__RC_FIFOBUF_SMEAR8(x)>>16))
+#define RC_FIFOBUF_NEXT_POW2(n) (__RC_FIFOBUF_SMEAR16((unsigned int)(n)-1)+1)
+#endif
+
+/**
+ * Number of FIFOBUF_TYPE elements of storage needed for a buffer of size n,
+ * for use with rc_fifobuf_init_static, along with an initializer for a
+ * buffer using the user's own storage array which must be at least that long.
+ * These refer to the most recent instantiation, e.g.
+ *
+ * static int cmd_mem[RC_FIFOBUF_STORAGE_LEN(64)];
+ * static rc_fifobuf_t cmds = RC_FIFOBUF_STATIC_INITIALIZER(cmd_mem, 64);
+ */
+#undef RC_FIFOBUF_STORAGE_LEN
+#undef RC_FIFOBUF_STATIC_INITIALIZER
+#ifdef RC_FIFOBUF_POW2
+#define RC_FIFOBUF_STORAGE_LEN(n)   RC_FIFOBUF_NEXT_POW2(n)
+#define RC_FIFOBUF_STATIC_INITIALIZER(storage, n) {\
+    .d = (storage),\
+    .size = (n),\
+    .mask = RC_FIFOBUF_STORAGE_LEN(n)-1,\
+    .head = 0,\
+    .tail = 0,\
+    .initialized = 1,\
+    .user_mem = 1}
+#else
+#define RC_FIFOBUF_STORAGE_LEN(n)   (n)
+#define RC_FIFOBUF_STATIC_INITIALIZER(storage, n) {\
+    .d = (storage),\
+    .size = (n),\
     .tail = 0,\
     .available = 0,\
-    .initialized = 0}
+    .initialized = 1,\
+    .user_mem = 1}
+#endif
+
+/**
+ * Declares a static buffer called name of size n along with its storage,
+ * using the current FIFOBUF_TYPE. Use at file scope right after including
+ * the header.
+ */
+#define RC_FIFOBUF_DECLARE_STATIC(name, n)\
+    static FIFOBUF_TYPE name##_storage[RC_FIFOBUF_STORAGE_LEN(n)];\
+    static RC_FIFOBUF_T name = RC_FIFOBUF_STATIC_INITIALIZER(name##_storage, n)
+
+
+/*
+ * Index bookkeeping shared by the functions below. By default the buffer
+ * tracks the tail index and the number of entries available. If the user
+ * #defines RC_FIFOBUF_POW2 before including this header then the backing
+ * memory is rounded up to a power of two and the buffer instead keeps
+ * free-running head and tail counters which wrap into d with a mask. Neither
+ * needs an integer division on push or pop.
+ */
+#ifdef RC_FIFOBUF_POW2
+
+static inline int RC_FIFOBUF_PRIV(len)(RC_FIFOBUF_T* buf)
+{
+    return (int)(buf->mask + 1);
+}
+
+static inline int RC_FIFOBUF_PRIV(count)(RC_FIFOBUF_T* buf)
+{
+    return (int)(buf->head - buf->tail);
+}
+
+static inline int RC_FIFOBUF_PRIV(read_index)(RC_FIFOBUF_T* buf)
+{
+    return (int)(buf->tail & buf->mask);
+}
+
+static inline int RC_FIFOBUF_PRIV(write_index)(RC_FIFOBUF_T* buf)
+{
+    return (int)(buf->head & buf->mask);
+}
+
+static inline void RC_FIFOBUF_PRIV(pushed)(RC_FIFOBUF_T* buf, int n)
+{
+    buf->head += n;
+}
+
+static inline void RC_FIFOBUF_PRIV(popped)(RC_FIFOBUF_T* buf, int n)
+{
+    buf->tail += n;
+}
+
+static inline void RC_FIFOBUF_PRIV(clear)(RC_FIFOBUF_T* buf)
+{
+    buf->head = 0;
+    buf->tail = 0;
+}
+
+#else
+
+static inline int RC_FIFOBUF_PRIV(len)(RC_FIFOBUF_T* buf)
+{
+    return buf->size;
+}
+
+static inline int RC_FIFOBUF_PRIV(count)(RC_FIFOBUF_T* buf)
+{
+    return buf->available;
+}
+
+static inline int RC_FIFOBUF_PRIV(read_index)(RC_FIFOBUF_T* buf)
+{
+    return buf->tail;
+}
+
+static inline int RC_FIFOBUF_PRIV(write_index)(RC_FIFOBUF_T* buf)
+{
+    // tail<size and available<=size so one subtraction is enough
+    int i = buf->tail + buf->available;
+    if(i>=buf->size) i-=buf->size;
+    return i;
+}
+
+static inline void RC_FIFOBUF_PRIV(pushed)(RC_FIFOBUF_T* buf, int n)
+{
+    buf->available += n;
+}
+
+static inline void RC_FIFOBUF_PRIV(popped)(RC_FIFOBUF_T* buf, int n)
+{
+    buf->tail += n;
+    if(buf->tail>=buf->size) buf->tail-=buf->size;
+    buf->available -= n;
+}
+
+static inline void RC_FIFOBUF_PRIV(clear)(RC_FIFOBUF_T* buf)
+{
+    buf->tail = 0;
+    buf->available = 0;
+}
+
+#endif
+
+// fill in span with the n entries starting at index i of d
+static inline void RC_FIFOBUF_PRIV(span)(RC_FIFOBUF_T* buf, int i, int n, RC_FIFOBUF_SPAN_T* span)
+{
+    int first = RC_FIFOBUF_PRIV(len)(buf) - i;
+    if(first>n) first=n;
+    span->d[0] = &buf->d[i];
+    span->len[0] = first;
+    span->d[1] = buf->d;
+    span->len[1] = n-first;
+}
+
+// moves the queued entries into fresh memory holding size entries with the
+// oldest at d[0], the old memory is freed unless it belongs to the user
+static inline int RC_FIFOBUF_PRIV(resize)(RC_FIFOBUF_T* buf, int size)
+{
+    int len = size;
+    int count = RC_FIFOBUF_PRIV(count)(buf);
+    FIFOBUF_TYPE* fresh;
+    RC_FIFOBUF_SPAN_T live;
+#ifdef RC_FIFOBUF_POW2
+    len = 2;
+    while(len<size) len<<=1;
+#endif
+    fresh = (FIFOBUF_TYPE*)__rc_buf_alloc(len,sizeof(FIFOBUF_TYPE),RC_FIFOBUF_ALIGN);
+    if(fresh==NULL) return -1;
+    // the live span wraps at most once so this is two copies at most
+    RC_FIFOBUF_PRIV(span)(buf, RC_FIFOBUF_PRIV(read_index)(buf), count, &live);
+    memcpy(fresh, live.d[0], live.len[0]*sizeof(FIFOBUF_TYPE));
+    memcpy(&fresh[live.len[0]], live.d[1], live.len[1]*sizeof(FIFOBUF_TYPE));
+    if(!buf->user_mem) free(buf->d);
+    buf->user_mem = 0;
+    buf->d = fresh;
+    buf->size = size;
+#ifdef RC_FIFOBUF_POW2
+    buf->mask = len-1;
+#endif
+    RC_FIFOBUF_PRIV(clear)(buf);
+    RC_FIFOBUF_PRIV(pushed)(buf, count);
+    buf->low_water = 0;
+    return 0;
+}
+
+// called when n entries don't fit. a growable buffer doubles until they do or
+// it reaches max_size. returns the free space afterwards
+static inline int RC_FIFOBUF_PRIV(grow)(RC_FIFOBUF_T* buf, int n)
+{
+    int count = RC_FIFOBUF_PRIV(count)(buf);
+    int size = buf->size;
+    int need;
+    if(buf->max_size<=size) return size-count;
+    need = (n > buf->max_size-count) ? buf->max_size : count+n;
+    while(size<need) size = (size > buf->max_size/2) ? buf->max_size : size*2;
+    if(RC_FIFOBUF_PRIV(resize)(buf, size)){
+        fprintf(stderr,"ERROR in rc_fifobuf_grow, failed to allocate memory\n");
+    }
+    return buf->size-RC_FIFOBUF_PRIV(count)(buf);
+}
+
+// called after popping from a buffer which may shrink. halves it once
+// shrink_after pops in a row have found it under a quarter full
+static inline void RC_FIFOBUF_PRIV(shrink)(RC_FIFOBUF_T* buf)
+{
+    int half = buf->size/2;
+    if(half<buf->min_size) half = buf->min_size;
+    if(half==buf->size || RC_FIFOBUF_PRIV(count)(buf) > buf->size/4){
+        buf->low_water = 0;
+        return;
+    }
+    if(++buf->low_water < buf->shrink_after) return;
+    // if there is no memory for the smaller copy just keep the bigger one
+    RC_FIFOBUF_PRIV(resize)(buf, half);
+    buf->low_water = 0;
+}
+
+// discards the n oldest entries to make room for an overwriting push. any of
+// them handed out by peek are remembered so the release doesn't remove the
+// same number of entries again from what is left
+static inline void RC_FIFOBUF_PRIV(drop)(RC_FIFOBUF_T* buf, int n)
+{
+    int lost = n<buf->peeked ? n : buf->peeked;
+    buf->peeked -= lost;
+    buf->peek_lost += lost;
+    RC_FIFOBUF_PRIV(popped)(buf, n);
+    buf->dropped += n;
+    __RC_BUF_COUNT(buf->counters, overwrites, n);
+}
+
 
 /**
  * @brief      Returns an rc_fifobuf_t struct which is completely zero'd out
@@ -61,9 +389,9 @@ typedef struct rc_fifobuf_t {
  *
  * @return     empty and ready-to-allocate rc_fifobuf_t
  */
-rc_fifobuf_t rc_fifobuf_empty(void)
+static inline RC_FIFOBUF_T RC_FIFOBUF_FN(empty)(void)
 {
-    rc_fifobuf_t out = RC_FIFOBUF_INITIALIZER;
+    RC_FIFOBUF_T out = RC_FIFOBUF_INITIALIZER;
     return out;
 }
 
@@ -71,17 +399,20 @@ rc_fifobuf_t rc_fifobuf_empty(void)
  * @brief      Allocates memory for a fifo buffer and initializes an
  * rc_fifobuf_t struct.
  *
- * If buf is already the right size then it is left untouched. Otherwise any
- * existing memory allocated for buf is freed to avoid memory leaks and new
- * memory is allocated.
+ * If buf is already the right size then its memory and entries are kept, but
+ * growth is turned off and the dropped count and low water mark are reset just
+ * as for a new buffer. Otherwise any existing memory allocated for buf is freed
+ * to avoid memory leaks and new memory is allocated. Memory provided by the
+ * user is never freed.
  *
  * @param      buf   Pointer to user's buffer
  * @param[in]  size  Number of elements to allocate space for
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_fifobuf_alloc(rc_fifobuf_t* buf, int size)
+static inline int RC_FIFOBUF_FN(alloc)(RC_FIFOBUF_T* buf, int size)
 {
+    int len = size;
     // sanity checks
     if(unlikely(buf==NULL)){
         fprintf(stderr,"ERROR in rc_fifobuf_alloc, received NULL pointer\n");
@@ -91,22 +422,49 @@ int rc_fifobuf_alloc(rc_fifobuf_t* buf, int size)
         fprintf(stderr,"ERROR in rc_fifobuf_alloc, size must be >=2\n");
         return -1;
     }
-    // if it's already allocated, nothing to do
-    if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+    // if it's already allocated keep the entries, only reset the settings
+    if(buf->initialized && buf->size==size && buf->d!=NULL){
+        buf->max_size = 0;
+        buf->shrink_after = 0;
+        buf->dropped = 0;
+        buf->low_water = 0;
+        return 0;
+    }
+#ifdef RC_FIFOBUF_POW2
+    if(unlikely(size>(1<<30))){
+        fprintf(stderr,"ERROR in rc_fifobuf_alloc, size must be <=2^30\n");
+        return -1;
+    }
+    // round the backing memory up to a power of two
+    len = 2;
+    while(len<size) len<<=1;
+#endif
     // make sure it's zero'd out
     buf->size = 0;
-    buf->tail = 0;
-    buf->available = 0;
+    RC_FIFOBUF_PRIV(clear)(buf);
     buf->initialized = 0;
+    buf->max_size = 0;
+    buf->shrink_after = 0;
+    buf->dropped = 0;
+    buf->low_water = 0;
+    buf->peeked = 0;
+    buf->peek_lost = 0;
+#ifdef RC_BUF_COUNTERS
+    memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
     // free memory and allocate fresh
-    free(buf->d);
-    buf->d = (FIFOBUF_TYPE*)calloc(size,sizeof(FIFOBUF_TYPE));
+    if(!buf->user_mem) free(buf->d);
+    buf->user_mem = 0;
+    buf->d = (FIFOBUF_TYPE*)__rc_buf_alloc(len,sizeof(FIFOBUF_TYPE),RC_FIFOBUF_ALIGN);
     if(buf->d==NULL){
         fprintf(stderr,"ERROR in rc_fifobuf_alloc, failed to allocate memory\n");
         return -1;
     }
     // write out other details
     buf->size = size;
+#ifdef RC_FIFOBUF_POW2
+    buf->mask = len-1;
+#endif
     buf->initialized = 1;
     return 0;
 }
@@ -121,18 +479,102 @@ int rc_fifobuf_alloc(rc_fifobuf_t* buf, int size)
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_fifobuf_free(rc_fifobuf_t* buf)
+static inline int RC_FIFOBUF_FN(free)(RC_FIFOBUF_T* buf)
 {
-    rc_fifobuf_t new = RC_FIFOBUF_INITIALIZER;
+    RC_FIFOBUF_T new = RC_FIFOBUF_INITIALIZER;
     if(unlikely(buf==NULL)){
         fprintf(stderr, "ERROR in rc_fifobuf_free, received NULL pointer\n");
         return -1;
     }
-    if(buf->initialized) free(buf->d);
+    if(buf->initialized && !buf->user_mem) free(buf->d);
     *buf = new;
     return 0;
 }
 
+/**
+ * @brief      Initializes a fifo buffer to use memory provided by the user
+ * instead of allocating it.
+ *
+ * storage may be a static array, part of a pool or shared memory and must be
+ * at least RC_FIFOBUF_STORAGE_LEN(size) elements long. It is zero'd out here
+ * and is never freed by rc_fifobuf_free or rc_fifobuf_alloc.
+ *
+ * @param      buf      Pointer to user's buffer
+ * @param      storage  memory for the buffer's contents
+ * @param[in]  size     Number of elements the buffer should hold
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(init_static)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE* storage, int size)
+{
+    // sanity checks
+    if(unlikely(buf==NULL || storage==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_init_static, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(size<2 || size>(1<<30))){
+        fprintf(stderr,"ERROR in rc_fifobuf_init_static, size must be >=2 and <=2^30\n");
+        return -1;
+    }
+    // release anything allocated previously
+    if(buf->initialized && !buf->user_mem && buf->d!=storage) free(buf->d);
+    memset(storage,0,RC_FIFOBUF_STORAGE_LEN(size)*sizeof(FIFOBUF_TYPE));
+    buf->d = storage;
+    buf->size = size;
+#ifdef RC_FIFOBUF_POW2
+    buf->mask = RC_FIFOBUF_STORAGE_LEN(size)-1;
+#endif
+    RC_FIFOBUF_PRIV(clear)(buf);
+#ifdef RC_BUF_COUNTERS
+    memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
+    buf->max_size = 0;
+    buf->shrink_after = 0;
+    buf->dropped = 0;
+    buf->low_water = 0;
+    buf->peeked = 0;
+    buf->peek_lost = 0;
+    buf->user_mem = 1;
+    buf->initialized = 1;
+    return 0;
+}
+
+/**
+ * @brief      Touches every page of the buffer's memory so it is resident
+ * before the first entry arrives, and optionally locks it in RAM.
+ *
+ * Call this at startup, not while the buffer is in use. Locking requires
+ * permission to mlock, e.g. CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  lock  nonzero to also mlock the memory
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(prefault)(RC_FIFOBUF_T* buf, int lock)
+{
+    size_t i, bytes;
+    volatile char* p;
+    // sanity checks
+    if(unlikely(buf==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_prefault, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_prefault, fifobuf uninitialized\n");
+        return -1;
+    }
+    bytes = (size_t)RC_FIFOBUF_PRIV(len)(buf)*sizeof(FIFOBUF_TYPE);
+    // write to each page so copy-on-write and zero pages get a real frame
+    p = (volatile char*)buf->d;
+    for(i=0;i<bytes;i+=4096) p[i] = p[i];
+    if(lock && mlock((const void*)buf->d, bytes)){
+        fprintf(stderr,"ERROR in rc_fifobuf_prefault, mlock failed\n");
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * @brief      memsets the buffer to 0 and sets the buffer index
  * back to 0.
@@ -141,7 +583,7 @@ int rc_fifobuf_free(rc_fifobuf_t* buf)
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_fifobuf_reset(rc_fifobuf_t* buf)
+static inline int RC_FIFOBUF_FN(reset)(RC_FIFOBUF_T* buf)
 {
     // sanity checks
     if(unlikely(buf==NULL)){
@@ -153,13 +595,112 @@ int rc_fifobuf_reset(rc_fifobuf_t* buf)
         return -1;
     }
     // wipe the data and index
-    memset(buf->d,0,buf->size*sizeof(FIFOBUF_TYPE));
-    buf->tail=0;
-    buf->available=0;
+    memset(buf->d,0,RC_FIFOBUF_PRIV(len)(buf)*sizeof(FIFOBUF_TYPE));
+    RC_FIFOBUF_PRIV(clear)(buf);
+    buf->dropped = 0;
+    buf->low_water = 0;
+    buf->peeked = 0;
+    buf->peek_lost = 0;
+#ifdef RC_BUF_COUNTERS
+    memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
     return 0;
 }
 
-int rc_fifobuf_available(rc_fifobuf_t* buf)
+/**
+ * @brief      Chooses what rc_fifobuf_push and rc_fifobuf_push_n do when the
+ * buffer is full.
+ *
+ * With enable 0 (the default) they reject new entries. Otherwise they discard
+ * the oldest entries to make room so the buffer always holds the newest data.
+ * The setting survives rc_fifobuf_alloc and rc_fifobuf_reset.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  enable  nonzero to overwrite the oldest entries when full
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(set_overwrite)(RC_FIFOBUF_T* buf, int enable)
+{
+    if(unlikely(buf==NULL)){
+        fprintf(stderr, "ERROR in rc_fifobuf_set_overwrite, received NULL pointer\n");
+        return -1;
+    }
+    buf->overwrite = (enable!=0);
+    return 0;
+}
+
+/**
+ * @brief      Returns the number of entries discarded by pushes to a full
+ * buffer in overwrite mode since it was allocated or last reset.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of entries dropped, or -1 on error.
+ */
+static inline long RC_FIFOBUF_FN(dropped)(RC_FIFOBUF_T* buf)
+{
+    if(unlikely(buf==NULL)){
+        fprintf(stderr, "ERROR in rc_fifobuf_dropped, received NULL pointer\n");
+        return -1;
+    }
+    return (long)buf->dropped;
+}
+
+/**
+ * @brief      Lets the buffer grow when a push finds it full instead of
+ * rejecting or overwriting entries.
+ *
+ * When rc_fifobuf_push, rc_fifobuf_push_n or rc_fifobuf_reserve run out of
+ * space the buffer doubles in size, up to max_size, and the queued entries
+ * are copied across in at most two memcpy calls. Only once it has reached
+ * max_size does a full buffer reject or, in overwrite mode, overwrite. With
+ * shrink_after nonzero the buffer halves again once that many pops in a row
+ * have found it less than a quarter full, but never below the size it had
+ * when this was called.
+ *
+ * Growing or shrinking moves the entries to new memory, so spans from
+ * rc_fifobuf_peek and pointers from rc_fifobuf_pop_ptr only stay valid until
+ * the next push or pop, and a reserve which grows the buffer loses anything
+ * written into an earlier reservation that was not committed. Memory passed
+ * to rc_fifobuf_init_static is left alone, the buffer moves off it onto the
+ * heap. rc_fifobuf_alloc and rc_fifobuf_init_static turn growth off again.
+ *
+ * @param      buf           Pointer to user's buffer
+ * @param[in]  max_size      hard ceiling on the size, at least the current
+ *                           size, or 0 to turn growth off
+ * @param[in]  shrink_after  number of pops under a quarter full before
+ *                           shrinking, 0 to never shrink
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(set_growth)(RC_FIFOBUF_T* buf, int max_size, int shrink_after)
+{
+    // sanity checks
+    if(unlikely(buf==NULL)){
+        fprintf(stderr, "ERROR in rc_fifobuf_set_growth, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR rc_fifobuf_set_growth, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(max_size!=0 && (max_size<buf->size || max_size>(1<<30)))){
+        fprintf(stderr,"ERROR in rc_fifobuf_set_growth, max_size must be >=size and <=2^30\n");
+        return -1;
+    }
+    if(unlikely(shrink_after<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_set_growth, shrink_after must be >=0\n");
+        return -1;
+    }
+    buf->max_size = max_size;
+    buf->min_size = buf->size;
+    buf->shrink_after = max_size ? shrink_after : 0;
+    buf->low_water = 0;
+    return 0;
+}
+
+static inline int RC_FIFOBUF_FN(available)(RC_FIFOBUF_T* buf)
 {
     // sanity checks
     if(unlikely(buf==NULL)){
@@ -170,24 +711,68 @@ int rc_fifobuf_available(rc_fifobuf_t* buf)
         fprintf(stderr,"ERROR rc_fifobuf_available, fifobuf uninitialized\n");
         return -1;
     }
-    return buf->available;
+    return RC_FIFOBUF_PRIV(count)(buf);
+}
+
+#ifdef RC_BUF_COUNTERS
+/**
+ * @brief      Takes a snapshot of the buffer's counters, see buf_counters.h.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the current counters
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(counters)(RC_FIFOBUF_T* buf, rc_buf_counters_t* out)
+{
+    // sanity checks
+    if(unlikely(buf==NULL || out==NULL)){
+        fprintf(stderr, "ERROR in rc_fifobuf_counters, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR rc_fifobuf_counters, fifobuf uninitialized\n");
+        return -1;
+    }
+    *out = buf->counters;
+    return 0;
 }
+#endif
 
 
 
+/**
+ * @brief      Same as rc_fifobuf_push but without any sanity checks.
+ *
+ * For inner loops where the caller already knows buf is valid, allocated and
+ * has room, e.g. from rc_fifobuf_available. Compiles down to a few
+ * instructions with no calls.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be inserted
+ */
+static inline void RC_FIFOBUF_FN(push_unchecked)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE val)
+{
+    buf->d[RC_FIFOBUF_PRIV(write_index)(buf)]=val;
+    RC_FIFOBUF_PRIV(pushed)(buf, 1);
+    __RC_BUF_COUNT(buf->counters, pushes, 1);
+    __RC_BUF_PEAK(buf->counters, RC_FIFOBUF_PRIV(count)(buf));
+}
+
 /**
  * @brief      Puts a new entry into the fifo buffer and updates the index
  * accordingly.
  *
+ * If the buffer is full this fails, unless overwrite mode is on in which case
+ * the oldest entry is discarded to make room.
  *
  * @param      buf   Pointer to user's buffer
  * @param[in]  val   The value to be inserted
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_fifobuf_push(rc_fifobuf_t* buf, FIFOBUF_TYPE val)
+static inline int RC_FIFOBUF_FN(push)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE val)
 {
-    int new_index;
     // sanity checks
     if(unlikely(buf==NULL)){
         fprintf(stderr,"ERROR in rc_fifobuf_insert, received NULL pointer\n");
@@ -200,16 +785,37 @@ int rc_fifobuf_push(rc_fifobuf_t* buf, FIFOBUF_TYPE val)
 
     // check for full. fail silently as the user may run into this as an
     // intentional check for the buffer being full
-    if(buf->available == buf->size) return -1;
+    if(RC_FIFOBUF_PRIV(count)(buf) == buf->size && RC_FIFOBUF_PRIV(grow)(buf, 1)==0){
+        if(!buf->overwrite){
+            __RC_BUF_COUNT(buf->counters, rejected, 1);
+            return -1;
+        }
+        // make room by dropping the oldest entry
+        RC_FIFOBUF_PRIV(drop)(buf, 1);
+    }
 
-    // calculate index to put the new value into
-    new_index = (buf->tail + buf->available) % buf->size;
-    buf->d[new_index]=val;
-    // increment available count
-    buf->available++;
+    RC_FIFOBUF_FN(push_unchecked)(buf, val);
     return 0;
 }
 
+/**
+ * @brief      Same as rc_fifobuf_pop but without any sanity checks, returns
+ * the value directly.
+ *
+ * The caller is responsible for buf being allocated and not empty.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     the oldest value, which is removed from the buffer
+ */
+static inline FIFOBUF_TYPE RC_FIFOBUF_FN(pop_unchecked)(RC_FIFOBUF_T* buf)
+{
+    FIFOBUF_TYPE val = buf->d[RC_FIFOBUF_PRIV(read_index)(buf)];
+    RC_FIFOBUF_PRIV(popped)(buf, 1);
+    __RC_BUF_COUNT(buf->counters, pops, 1);
+    return val;
+}
+
 /**
  * @brief      Fetches the float which is 'position' steps behind the last value
  * added to the buffer.
@@ -223,9 +829,8 @@ int rc_fifobuf_push(rc_fifobuf_t* buf, FIFOBUF_TYPE val)
  * @return     Returns the requested float. Prints an error message and returns
  * -1 on error.
  */
-int rc_fifobuf_pop(rc_fifobuf_t* buf, FIFOBUF_TYPE * value)
+static inline int RC_FIFOBUF_FN(pop)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE * value)
 {
-    int return_index;
     // sanity checks
     if(unlikely(buf==NULL)){
         fprintf(stderr,"ERROR in rc_fifobuf_get_value, received NULL pointer\n");
@@ -238,33 +843,28 @@ int rc_fifobuf_pop(rc_fifobuf_t* buf, FIFOBUF_TYPE * value)
 
     // check for empty. fail silently as the user may run into this as an
     // intentional check for the buffer being empty
-    if(buf->available == 0) return -1;
-
-    // write out value
-    *value = buf->d[buf->tail];
+    if(RC_FIFOBUF_PRIV(count)(buf) == 0) return -1;
 
-    // update counters
-    buf->available--;
-    buf->tail = (buf->tail + 1) % buf->size;
+    *value = RC_FIFOBUF_FN(pop_unchecked)(buf);
+    if(buf->shrink_after) RC_FIFOBUF_PRIV(shrink)(buf);
     return 0;
 }
 
 /**
- * @brief      Fetches the float which is 'position' steps behind the last value
- * added to the buffer.
+ * @brief      Pops the oldest entry out of the fifo buffer and returns a
+ * pointer to it in the buffer's memory instead of copying it out.
  *
- * If 'position' is given as 0 then the most recent value is returned. The
- * position obviously can't be larger than (buffer size - 1).
+ * The entry is removed immediately so its slot may be overwritten by the next
+ * push while the caller still holds the pointer. Use rc_fifobuf_peek and
+ * rc_fifobuf_release to read entries in place safely.
  *
- * @param      buf       Pointer to user's buffer
- * @param[in]  position  steps back in the buffer to fetch the value from
+ * @param      buf        Pointer to user's buffer
+ * @param[out] value_ptr  set to point at the popped entry
  *
- * @return     Returns the requested float. Prints an error message and returns
- * -1 on error.
+ * @return     Returns 0 on success or -1 on failure or if empty.
  */
-int rc_fifobuf_pop_ptr(rc_fifobuf_t* buf, FIFOBUF_TYPE ** value_ptr)
+static inline int RC_FIFOBUF_FN(pop_ptr)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE ** value_ptr)
 {
-    int return_index;
     // sanity checks
     if(unlikely(buf==NULL)){
         fprintf(stderr,"ERROR in rc_fifobuf_get_value_ptr, received NULL pointer\n");
@@ -277,14 +877,288 @@ int rc_fifobuf_pop_ptr(rc_fifobuf_t* buf, FIFOBUF_TYPE ** value_ptr)
 
     // check for empty. fail silently as the user may run into this as an
     // intentional check for the buffer being empty
-    if(buf->available == 0) return -1;
+    if(RC_FIFOBUF_PRIV(count)(buf) == 0) return -1;
 
     // write out value
-    *value_ptr = &buf->d[buf->tail];
+    *value_ptr = &buf->d[RC_FIFOBUF_PRIV(read_index)(buf)];
 
     // update counters
-    buf->available--;
-    buf->tail = (buf->tail + 1) % buf->size;
+    RC_FIFOBUF_PRIV(popped)(buf, 1);
+    __RC_BUF_COUNT(buf->counters, pops, 1);
+    return 0;
+}
+
+/**
+ * @brief      Puts up to n entries from a contiguous array into the fifo
+ * buffer.
+ *
+ * Checks the buffer state once for the whole block and copies it in with at
+ * most two memcpy calls, one up to the end of the backing memory and one for
+ * the part that wraps back around to the start. If there isn't room for all
+ * n entries then only as many as fit are pushed, oldest first. In overwrite
+ * mode all n are pushed, discarding as many of the oldest entries as needed,
+ * and if n exceeds the size of the buffer only the last size entries of src
+ * are kept.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  src   array of values to push, src[0] is pushed first
+ * @param[in]  n     number of values in src
+ *
+ * @return     Returns the number of entries pushed, or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(push_n)(RC_FIFOBUF_T* buf, const FIFOBUF_TYPE* src, int n)
+{
+    int w, first, space, skip = 0;
+    // sanity checks
+    if(unlikely(buf==NULL || src==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_push_n, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_push_n, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_push_n, n must be >=0\n");
+        return -1;
+    }
+
+    // only push as many as there is space for, or make space
+    space = buf->size - RC_FIFOBUF_PRIV(count)(buf);
+    if(n>space) space = RC_FIFOBUF_PRIV(grow)(buf, n);
+    if(n>space){
+        if(!buf->overwrite){
+            __RC_BUF_COUNT(buf->counters, rejected, n-space);
+            n=space;
+        }
+        else{
+            // the start of src would be overwritten by its own end
+            if(n>buf->size){
+                skip = n-buf->size;
+                src += skip;
+                n = buf->size;
+            }
+            // then drop the oldest entries to make room for the rest
+            if(n>space) RC_FIFOBUF_PRIV(drop)(buf, n-space);
+            buf->dropped += skip;
+            __RC_BUF_COUNT(buf->counters, overwrites, skip);
+        }
+    }
+    if(n==0) return 0;
+
+    // copy up to the end of memory, then wrap around to the start
+    w = RC_FIFOBUF_PRIV(write_index)(buf);
+    first = RC_FIFOBUF_PRIV(len)(buf) - w;
+    if(first>n) first=n;
+    memcpy(&buf->d[w], src, first*sizeof(FIFOBUF_TYPE));
+    if(n>first) memcpy(buf->d, &src[first], (n-first)*sizeof(FIFOBUF_TYPE));
+
+    RC_FIFOBUF_PRIV(pushed)(buf, n);
+    __RC_BUF_COUNT(buf->counters, pushes, n+skip);
+    __RC_BUF_PEAK(buf->counters, RC_FIFOBUF_PRIV(count)(buf));
+    return n+skip;
+}
+
+/**
+ * @brief      Pops up to n entries out of the fifo buffer into a contiguous
+ * array.
+ *
+ * Checks the buffer state once for the whole block and copies it out with at
+ * most two memcpy calls. If fewer than n entries are available then only
+ * those are popped.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] dst   array to write the values to, dst[0] is the oldest
+ * @param[in]  n     maximum number of values to pop, size of dst
+ *
+ * @return     Returns the number of entries popped, or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(pop_n)(RC_FIFOBUF_T* buf, FIFOBUF_TYPE* dst, int n)
+{
+    int r, first, count;
+    // sanity checks
+    if(unlikely(buf==NULL || dst==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_pop_n, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_pop_n, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_pop_n, n must be >=0\n");
+        return -1;
+    }
+
+    // only pop as many as are waiting
+    count = RC_FIFOBUF_PRIV(count)(buf);
+    if(n>count) n=count;
+    if(n==0) return 0;
+
+    // copy up to the end of memory, then wrap around to the start
+    r = RC_FIFOBUF_PRIV(read_index)(buf);
+    first = RC_FIFOBUF_PRIV(len)(buf) - r;
+    if(first>n) first=n;
+    memcpy(dst, &buf->d[r], first*sizeof(FIFOBUF_TYPE));
+    if(n>first) memcpy(&dst[first], buf->d, (n-first)*sizeof(FIFOBUF_TYPE));
+
+    RC_FIFOBUF_PRIV(popped)(buf, n);
+    __RC_BUF_COUNT(buf->counters, pops, n);
+    if(buf->shrink_after) RC_FIFOBUF_PRIV(shrink)(buf);
+    return n;
+}
+
+/**
+ * @brief      Reserves space for up to n new entries to be written directly
+ * into the buffer's memory, e.g. by DMA.
+ *
+ * Nothing is pushed until rc_fifobuf_commit is called, so the caller may take
+ * as long as it likes filling in the reserved segments. Calling reserve again
+ * before committing returns the same space.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  n     maximum number of entries to reserve
+ * @param[out] span  set to the one or two writable segments reserved
+ *
+ * @return     Returns the number of entries reserved, which may be less than n
+ * if the buffer is nearly full, or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(reserve)(RC_FIFOBUF_T* buf, int n, RC_FIFOBUF_SPAN_T* span)
+{
+    int space;
+    // sanity checks
+    if(unlikely(buf==NULL || span==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_reserve, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_reserve, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_reserve, n must be >=0\n");
+        return -1;
+    }
+    space = buf->size - RC_FIFOBUF_PRIV(count)(buf);
+    if(n>space) space = RC_FIFOBUF_PRIV(grow)(buf, n);
+    if(n>space) n=space;
+    RC_FIFOBUF_PRIV(span)(buf, RC_FIFOBUF_PRIV(write_index)(buf), n, span);
+    return n;
+}
+
+/**
+ * @brief      Publishes n entries previously written into space returned by
+ * rc_fifobuf_reserve.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  n     number of entries written, may be less than was reserved
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(commit)(RC_FIFOBUF_T* buf, int n)
+{
+    // sanity checks
+    if(unlikely(buf==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_commit, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_commit, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0 || n>buf->size-RC_FIFOBUF_PRIV(count)(buf))){
+        fprintf(stderr,"ERROR in rc_fifobuf_commit, n larger than free space\n");
+        return -1;
+    }
+    RC_FIFOBUF_PRIV(pushed)(buf, n);
+    __RC_BUF_COUNT(buf->counters, pushes, n);
+    __RC_BUF_PEAK(buf->counters, RC_FIFOBUF_PRIV(count)(buf));
+    return 0;
+}
+
+/**
+ * @brief      Returns up to n of the oldest entries in place without removing
+ * them from the buffer.
+ *
+ * The entries stay in the buffer until the caller is done with them and
+ * calls rc_fifobuf_release. A push which would have to overwrite them fails,
+ * except in overwrite mode where the oldest are still dropped to make room
+ * and their slots reused. Those count towards rc_fifobuf_dropped as usual and
+ * the release only removes the peeked entries which are still there, so none
+ * of the newer entries are lost with them. Only one peek is tracked at a time,
+ * peeking again starts over.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  n     maximum number of entries to peek at
+ * @param[out] span  set to the one or two readable segments, oldest first
+ *
+ * @return     Returns the number of entries in span, which may be less than n,
+ * or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(peek)(RC_FIFOBUF_T* buf, int n, RC_FIFOBUF_SPAN_T* span)
+{
+    int count;
+    // sanity checks
+    if(unlikely(buf==NULL || span==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_peek, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_peek, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_peek, n must be >=0\n");
+        return -1;
+    }
+    count = RC_FIFOBUF_PRIV(count)(buf);
+    if(n>count) n=count;
+    RC_FIFOBUF_PRIV(span)(buf, RC_FIFOBUF_PRIV(read_index)(buf), n, span);
+    buf->peeked = n;
+    buf->peek_lost = 0;
+    return n;
+}
+
+/**
+ * @brief      Removes the n oldest entries, typically after reading them in
+ * place with rc_fifobuf_peek.
+ *
+ * Peeked entries already dropped by overwriting pushes since the peek are
+ * counted off n first, see rc_fifobuf_peek.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  n     number of entries to remove
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_FN(release)(RC_FIFOBUF_T* buf, int n)
+{
+    int lost;
+    // sanity checks
+    if(unlikely(buf==NULL)){
+        fprintf(stderr,"ERROR in rc_fifobuf_release, received NULL pointer\n");
+        return -1;
+    }
+    if(unlikely(!buf->initialized)){
+        fprintf(stderr,"ERROR in rc_fifobuf_release, fifobuf uninitialized\n");
+        return -1;
+    }
+    if(unlikely(n<0)){
+        fprintf(stderr,"ERROR in rc_fifobuf_release, n must be >=0\n");
+        return -1;
+    }
+    // peeked entries an overwriting push dropped are already gone
+    lost = n<buf->peek_lost ? n : buf->peek_lost;
+    n -= lost;
+    if(unlikely(n>RC_FIFOBUF_PRIV(count)(buf))){
+        fprintf(stderr,"ERROR in rc_fifobuf_release, n larger than available\n");
+        return -1;
+    }
+    buf->peeked = 0;
+    buf->peek_lost = 0;
+    RC_FIFOBUF_PRIV(popped)(buf, n);
+    __RC_BUF_COUNT(buf->counters, pops, n);
+    if(buf->shrink_after) RC_FIFOBUF_PRIV(shrink)(buf);
     return 0;
 }
 
@@ -0,0 +1,749 @@
+/**
+ * "fifo_buf_mpmc.h"
+ *
+ * @brief      lock-free multi-producer/multi-consumer bounded fifo buffer
+ *
+ * This is a variant of the fifo buffer in fifo_buf.h which may be shared by
+ * any number of producer and consumer threads without a mutex. It follows
+ * the well known sequence-number-per-slot design. Every slot carries an
+ * atomic sequence number which says whether it is free for the producer
+ * claiming position pos (seq==pos) or holds an entry ready for the consumer
+ * claiming position pos (seq==pos+1). Producers claim positions by CAS on the
+ * head counter and consumers by CAS on the tail counter, so a producer and a
+ * consumer never contend with each other and each thread only touches the
+ * slot it claimed, never a lock shared by everyone.
+ *
+ * head and tail are free-running unsigned counters on separate cache lines.
+ * The backing memory is rounded up to a power of two so indices wrap with a
+ * mask, but the buffer still only accepts up to the number of entries
+ * requested in rc_fifobuf_mpmc_alloc.
+ *
+ * rc_fifobuf_mpmc_push and rc_fifobuf_mpmc_pop retry when they lose a race
+ * to another thread and only fail if the buffer is full or empty.
+ * rc_fifobuf_mpmc_try_push and rc_fifobuf_mpmc_try_pop make a single attempt
+ * and also fail if another thread got in first, for callers which must never
+ * spin.
+ *
+ * rc_fifobuf_mpmc_set_overwrite(buf, 1) makes push discard the oldest entry
+ * instead of failing when the buffer is full. The producer does this by
+ * popping the entry itself, exactly as a consumer would, so it is safe
+ * against any number of racing consumers and producers.
+ *
+ * Uses the same FIFOBUF_TYPE and FIFOBUF_NAME as fifo_buf.h and can be
+ * included alongside it. With FIFOBUF_NAME f32 the type is
+ * rc_fifobuf_mpmc_f32_t and the functions are rc_fifobuf_mpmc_f32_push etc.
+ * Since this relies on <stdatomic.h> it is C only.
+ *
+ * With RC_FIFOBUF_WAIT defined before including, rc_fifobuf_mpmc_pop_wait and
+ * rc_fifobuf_mpmc_push_wait block until an entry or a free slot turns up or a
+ * timeout passes, spinning briefly before parking on a futex, see
+ * fifo_buf_wait.h. Every push and pop then checks for parked waiters with one
+ * fence and a load and only enters the kernel to wake one if it is there.
+ * This changes the struct layout so define it the same way everywhere.
+ *
+ * The slots are always allocated on a cache line boundary and padded out to
+ * a whole number of lines, so the first and last slots don't share a line
+ * with whatever malloc put next to them. RC_FIFOBUF_ALIGN raises this
+ * further, see fifo_buf.h.
+ *
+ * With RC_BUF_COUNTERS defined the buffer counts pushes, pops, rejections,
+ * overwrites, lost compare and swaps and parks on a cache line of their own,
+ * read with rc_fifobuf_mpmc_counters, see buf_counters.h.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+
+#ifndef FIFOBUF_TYPE
+#error "ERROR user must #define FIFOBUF_TYPE before including fifo_buf_mpmc.h"
+#endif
+
+#include <stdatomic.h>
+#ifdef RC_FIFOBUF_WAIT
+#include "fifo_buf_wait.h"
+#endif
+#include "buf_alloc.h"
+#include "buf_counters.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifndef unlikely
+#define unlikely(x)	__builtin_expect (!!(x), 0)
+#endif
+
+#ifndef likely
+#define likely(x)	__builtin_expect (!!(x), 1)
+#endif
+
+// name mangling for this instantiation, see fifo_buf.h
+#define __RC_FIFOBUF_CAT_(a,b,c)	a##b##c
+#define __RC_FIFOBUF_CAT(a,b,c)	__RC_FIFOBUF_CAT_(a,b,c)
+#undef RC_FIFOBUF_MPMC_T
+#undef RC_FIFOBUF_MPMC_SLOT_T
+#undef RC_FIFOBUF_MPMC_FN
+#undef RC_FIFOBUF_MPMC_PRIV
+#ifdef FIFOBUF_NAME
+#define RC_FIFOBUF_MPMC_T	__RC_FIFOBUF_CAT(rc_fifobuf_mpmc_, FIFOBUF_NAME, _t)
+#define RC_FIFOBUF_MPMC_SLOT_T	__RC_FIFOBUF_CAT(rc_fifobuf_mpmc_, FIFOBUF_NAME, _slot_t)
+#define RC_FIFOBUF_MPMC_FN(f)	__RC_FIFOBUF_CAT(rc_fifobuf_mpmc_, FIFOBUF_NAME, _##f)
+#define RC_FIFOBUF_MPMC_PRIV(f)	__RC_FIFOBUF_CAT(__rc_fifobuf_mpmc_, FIFOBUF_NAME, _##f)
+#else
+#define RC_FIFOBUF_MPMC_T	rc_fifobuf_mpmc_t
+#define RC_FIFOBUF_MPMC_SLOT_T	rc_fifobuf_mpmc_slot_t
+#define RC_FIFOBUF_MPMC_FN(f)	rc_fifobuf_mpmc_##f
+#define RC_FIFOBUF_MPMC_PRIV(f)	__rc_fifobuf_mpmc_##f
+#endif
+
+#ifndef RC_FIFOBUF_CACHELINE
+#define RC_FIFOBUF_CACHELINE 64
+#endif
+
+#ifndef RC_FIFOBUF_ALIGN
+#define RC_FIFOBUF_ALIGN 0
+#endif
+
+// alignment of the slots from rc_fifobuf_mpmc_alloc, at least a cache line
+#ifndef RC_FIFOBUF_LINE_ALIGN
+#define RC_FIFOBUF_LINE_ALIGN\
+	(RC_FIFOBUF_ALIGN>RC_FIFOBUF_CACHELINE ? RC_FIFOBUF_ALIGN : RC_FIFOBUF_CACHELINE)
+#endif
+
+
+/**
+ * One slot of an mpmc fifo buffer, the entry along with its sequence number.
+ */
+typedef struct RC_FIFOBUF_MPMC_SLOT_T {
+	atomic_uint seq;	///< position this slot is ready for, see top of file
+	FIFOBUF_TYPE val;	///< the entry itself
+} RC_FIFOBUF_MPMC_SLOT_T;
+
+/**
+ * @brief      Struct containing state of a multi-producer/multi-consumer fifo
+ * buffer and pointer to dynamically allocated memory.
+ *
+ * head and tail are each aligned to their own cache line. Since this makes the
+ * struct itself cache-line aligned, declare it statically or on the stack
+ * rather than with malloc.
+ */
+typedef struct RC_FIFOBUF_MPMC_T {
+	RC_FIFOBUF_MPMC_SLOT_T* d;	///< pointer to dynamically allocated slots
+	int size;		///< number of elements the buffer can hold
+	unsigned int mask;	///< length of d minus 1, d is a power of two long
+	int initialized;	///< flag indicating if memory has been allocated for the buffer
+	int overwrite;		///< flag indicating push discards the oldest entry when full
+	_Alignas(RC_FIFOBUF_CACHELINE) atomic_uint head; ///< next position to be claimed by a producer
+	atomic_ulong dropped;	///< number of entries discarded by overwriting pushes
+#ifdef RC_FIFOBUF_WAIT
+	atomic_uint data_seq;		///< futex word bumped to wake consumers waiting for data
+	atomic_uint data_waiters;	///< number of consumers in pop_wait
+#endif
+	_Alignas(RC_FIFOBUF_CACHELINE) atomic_uint tail; ///< next position to be claimed by a consumer
+#ifdef RC_FIFOBUF_WAIT
+	atomic_uint space_seq;		///< futex word bumped to wake producers waiting for space
+	atomic_uint space_waiters;	///< number of producers in push_wait
+#endif
+#ifdef RC_BUF_COUNTERS
+	_Alignas(RC_FIFOBUF_CACHELINE) rc_buf_atomic_counters_t counters; ///< written by every thread, see buf_counters.h
+#endif
+} RC_FIFOBUF_MPMC_T;
+
+
+#define RC_FIFOBUF_MPMC_INITIALIZER {\
+	.d = NULL,\
+	.size = 0,\
+	.mask = 0,\
+	.initialized = 0,\
+	.head = 0,\
+	.tail = 0}
+
+
+/**
+ * @brief      Allocates memory for an mpmc fifo buffer and initializes an
+ * rc_fifobuf_mpmc_t struct.
+ *
+ * If buf is already the right size then it is left untouched. Otherwise any
+ * existing memory allocated for buf is freed to avoid memory leaks and new
+ * memory is allocated, and overwrite mode and the dropped count go back to
+ * their defaults. This is not thread safe, allocate the buffer before
+ * starting the producer and consumer threads.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  size  Number of elements to allocate space for
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(alloc)(RC_FIFOBUF_MPMC_T* buf, int size)
+{
+	unsigned int i, len;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2 || size>(1<<30))){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_alloc, size must be >=2 and <=2^30\n");
+		return -1;
+	}
+	// if it's already allocated, nothing to do
+	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+	// round the backing memory up to a power of two
+	len = 2;
+	while(len<(unsigned int)size) len<<=1;
+	// make sure it's zero'd out
+	buf->size = 0;
+	buf->mask = 0;
+	buf->initialized = 0;
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+	buf->overwrite = 0;
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->counters);
+#endif
+	// free memory and allocate fresh
+	free(buf->d);
+	buf->d = (RC_FIFOBUF_MPMC_SLOT_T*)__rc_buf_alloc(len,sizeof(RC_FIFOBUF_MPMC_SLOT_T),RC_FIFOBUF_LINE_ALIGN);
+	if(buf->d==NULL){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_alloc, failed to allocate memory\n");
+		return -1;
+	}
+	// every slot starts out free for the producer claiming its position
+	for(i=0;i<len;i++) atomic_store_explicit(&buf->d[i].seq, i, memory_order_relaxed);
+	// write out other details
+	buf->size = size;
+	buf->mask = len-1;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Frees the memory allocated for buffer buf.
+ *
+ * Also set the initialized flag to 0 so other functions don't try to access
+ * unallocated memory. Make sure no thread is still using the buffer.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(free)(RC_FIFOBUF_MPMC_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_free, received NULL pointer\n");
+		return -1;
+	}
+	if(buf->initialized) free(buf->d);
+	buf->d = NULL;
+	buf->size = 0;
+	buf->mask = 0;
+	buf->initialized = 0;
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+	buf->overwrite = 0;
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->counters);
+#endif
+	return 0;
+}
+
+/**
+ * @brief      memsets the buffer to 0 and discards all waiting entries.
+ *
+ * This is not thread safe, only call it while no producer or consumer is
+ * using the buffer.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(reset)(RC_FIFOBUF_MPMC_T* buf)
+{
+	unsigned int i;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_mpmc_reset, fifobuf uninitialized\n");
+		return -1;
+	}
+	// wipe the data, sequence numbers and counters
+	memset(buf->d,0,(buf->mask+1)*sizeof(RC_FIFOBUF_MPMC_SLOT_T));
+	for(i=0;i<=buf->mask;i++) atomic_store_explicit(&buf->d[i].seq, i, memory_order_relaxed);
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->counters);
+#endif
+	return 0;
+}
+
+/**
+ * @brief      Chooses what rc_fifobuf_mpmc_push does when the buffer is full.
+ *
+ * With enable 0 (the default) it rejects new entries. Otherwise it discards
+ * the oldest entry to make room, see top of file. rc_fifobuf_mpmc_try_push
+ * never overwrites. Only call this while no thread is using the buffer.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  enable  nonzero to overwrite the oldest entries when full
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(set_overwrite)(RC_FIFOBUF_MPMC_T* buf, int enable)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_set_overwrite, received NULL pointer\n");
+		return -1;
+	}
+	buf->overwrite = (enable!=0);
+	return 0;
+}
+
+/**
+ * @brief      Returns the number of entries discarded by pushes to a full
+ * buffer in overwrite mode. May be called from any thread.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of entries dropped, or -1 on error.
+ */
+static inline long RC_FIFOBUF_MPMC_FN(dropped)(RC_FIFOBUF_MPMC_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_dropped, received NULL pointer\n");
+		return -1;
+	}
+	return (long)atomic_load_explicit(&buf->dropped, memory_order_relaxed);
+}
+
+/**
+ * @brief      Returns the number of entries waiting to be read.
+ *
+ * May be called from any thread. The result is a snapshot, other threads may
+ * have pushed or popped by the time it is used. Entries which have been
+ * claimed by a producer but not yet written are counted.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of entries waiting, or -1 on error.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(available)(RC_FIFOBUF_MPMC_T* buf)
+{
+	unsigned int h, t;
+	int n;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_available, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_mpmc_available, fifobuf uninitialized\n");
+		return -1;
+	}
+	// read tail first so head-tail is never negative, but with several
+	// consumers it can still move past the head we read, so clamp
+	t = atomic_load_explicit(&buf->tail, memory_order_acquire);
+	h = atomic_load_explicit(&buf->head, memory_order_acquire);
+	n = (int)(h-t);
+	if(n<0) return 0;
+	if(n>buf->size) return buf->size;
+	return n;
+}
+
+#ifdef RC_BUF_COUNTERS
+/**
+ * @brief      Takes a snapshot of the buffer's counters, see buf_counters.h.
+ * May be called from any thread while the buffer is in use.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the current counters
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(counters)(RC_FIFOBUF_MPMC_T* buf, rc_buf_counters_t* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_mpmc_counters, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_mpmc_counters, fifobuf uninitialized\n");
+		return -1;
+	}
+	memset(out, 0, sizeof(*out));
+	__rc_buf_counters_add(out, &buf->counters);
+	return 0;
+}
+#endif
+
+/**
+ * Claims a position for a producer and writes val into it. With retry set,
+ * losing the race for a position to another producer just means trying the
+ * next one. Otherwise that is reported as a failure.
+ */
+static inline int RC_FIFOBUF_MPMC_PRIV(push)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE val, int retry)
+{
+	RC_FIFOBUF_MPMC_SLOT_T* slot;
+	unsigned int pos, seq;
+	int diff;
+
+	pos = atomic_load_explicit(&buf->head, memory_order_relaxed);
+	for(;;){
+		slot = &buf->d[pos & buf->mask];
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		diff = (int)(seq-pos);
+		if(diff==0){
+			// slot is free, but the buffer may hold fewer entries than
+			// there are slots so check against the requested size. pos
+			// may be stale and behind tail, then the CAS below fails.
+			if((unsigned int)buf->size!=buf->mask+1 &&
+				(int)(pos-atomic_load_explicit(&buf->tail, memory_order_relaxed))
+							>= buf->size) return -1;
+			if(atomic_compare_exchange_weak_explicit(&buf->head, &pos, pos+1,
+					memory_order_relaxed, memory_order_relaxed)) break;
+			// pos now holds the current head
+			__RC_BUF_COUNT_SHARED(buf->counters, retries, 1);
+			if(!retry) return -1;
+		}
+		// a consumer has not finished with this slot yet, so it's full
+		else if(diff<0) return -1;
+		// another producer claimed pos already
+		else{
+			__RC_BUF_COUNT_SHARED(buf->counters, retries, 1);
+			if(!retry) return -1;
+			pos = atomic_load_explicit(&buf->head, memory_order_relaxed);
+		}
+	}
+	slot->val = val;
+	// publish the entry to the consumer which claims pos
+	atomic_store_explicit(&slot->seq, pos+1, memory_order_release);
+	__RC_BUF_COUNT_SHARED(buf->counters, pushes, 1);
+#ifdef RC_BUF_COUNTERS
+	// consumers may already be past pos by now
+	diff = (int)(pos+1-atomic_load_explicit(&buf->tail, memory_order_relaxed));
+	if(diff>0) __RC_BUF_PEAK_SHARED(buf->counters, diff);
+#endif
+#ifdef RC_FIFOBUF_WAIT
+	__rc_fifobuf_wake(&buf->data_seq, &buf->data_waiters, 0);
+#endif
+	return 0;
+}
+
+/**
+ * Claims a position for a consumer and reads the entry out of it, see
+ * RC_FIFOBUF_MPMC_PRIV(push). Neither counts a pop nor wakes producers so
+ * push_overwrite can drop entries with it, pop does both.
+ */
+static inline int RC_FIFOBUF_MPMC_PRIV(take)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE* value, int retry)
+{
+	RC_FIFOBUF_MPMC_SLOT_T* slot;
+	unsigned int pos, seq;
+	int diff;
+
+	pos = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+	for(;;){
+		slot = &buf->d[pos & buf->mask];
+		seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		diff = (int)(seq-(pos+1));
+		if(diff==0){
+			if(atomic_compare_exchange_weak_explicit(&buf->tail, &pos, pos+1,
+					memory_order_relaxed, memory_order_relaxed)) break;
+			// pos now holds the current tail
+			__RC_BUF_COUNT_SHARED(buf->counters, retries, 1);
+			if(!retry) return -1;
+		}
+		// no producer has finished writing this slot, so it's empty
+		else if(diff<0) return -1;
+		// another consumer claimed pos already
+		else{
+			__RC_BUF_COUNT_SHARED(buf->counters, retries, 1);
+			if(!retry) return -1;
+			pos = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+		}
+	}
+	*value = slot->val;
+	// free the slot for the producer which claims it on the next lap
+	atomic_store_explicit(&slot->seq, pos+buf->mask+1, memory_order_release);
+	return 0;
+}
+
+/**
+ * Takes the oldest entry for a consumer, counts it and wakes a producer
+ * waiting for space.
+ */
+static inline int RC_FIFOBUF_MPMC_PRIV(pop)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE* value, int retry)
+{
+	if(RC_FIFOBUF_MPMC_PRIV(take)(buf, value, retry)) return -1;
+	__RC_BUF_COUNT_SHARED(buf->counters, pops, 1);
+#ifdef RC_FIFOBUF_WAIT
+	__rc_fifobuf_wake(&buf->space_seq, &buf->space_waiters, 0);
+#endif
+	return 0;
+}
+
+/**
+ * Push for overwrite mode, drops the oldest entry whenever the buffer is
+ * full until there is room.
+ */
+static inline int RC_FIFOBUF_MPMC_PRIV(push_overwrite)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE val)
+{
+	FIFOBUF_TYPE old;
+	while(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)){
+		// the slot may also be busy because a consumer is still copying
+		// out of it, only drop entries if the buffer is really full
+		if((int)(atomic_load_explicit(&buf->head, memory_order_relaxed)
+			- atomic_load_explicit(&buf->tail, memory_order_relaxed)) < buf->size){
+			continue;
+		}
+		// a dropped entry is not a pop, and the slot it frees is taken
+		// straight back by this producer so there is no one to wake
+		if(RC_FIFOBUF_MPMC_PRIV(take)(buf, &old, 1)==0){
+			atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+			__RC_BUF_COUNT_SHARED(buf->counters, overwrites, 1);
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief      Puts a new entry into the fifo buffer. May be called from any
+ * number of threads at once.
+ *
+ * If the buffer is full this fails, unless overwrite mode is on in which case
+ * the oldest entry is discarded to make room.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be inserted
+ *
+ * @return     Returns 0 on success or -1 on failure or if full.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(push)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE val)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_push, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_push, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(buf->overwrite) return RC_FIFOBUF_MPMC_PRIV(push_overwrite)(buf, val);
+	// fail silently when full as the user may run into this as an
+	// intentional check for the buffer being full
+	if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)){
+		__RC_BUF_COUNT_SHARED(buf->counters, rejected, 1);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Like rc_fifobuf_mpmc_push but never retries, so it also fails
+ * if another producer claimed the same position at the same moment.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be inserted
+ *
+ * @return     Returns 0 on success or -1 on failure, if full or contended.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(try_push)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE val)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_try_push, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_try_push, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 0)){
+		__RC_BUF_COUNT_SHARED(buf->counters, rejected, 1);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Pops the oldest entry out of the fifo buffer. May be called
+ * from any number of threads at once.
+ *
+ * With several producers, "oldest" means oldest claimed position. An entry
+ * whose producer claimed its position but was preempted before writing it
+ * holds back the entries behind it until that producer finishes.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[out] value  pointer to write the popped value to
+ *
+ * @return     Returns 0 on success or -1 on failure or if empty.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(pop)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE* value)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || value==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_pop, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_pop, fifobuf uninitialized\n");
+		return -1;
+	}
+	// fail silently when empty as the user may run into this as an
+	// intentional check for the buffer being empty
+	return RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 1);
+}
+
+/**
+ * @brief      Like rc_fifobuf_mpmc_pop but never retries, so it also fails
+ * if another consumer claimed the same entry at the same moment.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[out] value  pointer to write the popped value to
+ *
+ * @return     Returns 0 on success or -1 on failure, if empty or contended.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(try_pop)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE* value)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || value==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_try_pop, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_try_pop, fifobuf uninitialized\n");
+		return -1;
+	}
+	return RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 0);
+}
+
+
+#ifdef RC_FIFOBUF_WAIT
+/**
+ * @brief      Like rc_fifobuf_mpmc_pop but waits for an entry if the buffer
+ * is empty. Only call this from any consumer thread.
+ *
+ * Retries RC_FIFOBUF_SPIN times and then parks the thread until a producer
+ * pushes. A timeout of 0 makes a single attempt and a negative timeout waits
+ * forever.
+ *
+ * @param      buf         Pointer to user's buffer
+ * @param[out] value       pointer to write the popped value to
+ * @param[in]  timeout_us  longest time to wait in microseconds
+ *
+ * @return     Returns 0 on success or -1 on failure or if still empty when
+ * the timeout passes.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(pop_wait)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE* value, long timeout_us)
+{
+	int i, ret;
+	unsigned int seq;
+	uint64_t deadline;
+	// sanity checks
+	if(unlikely(buf==NULL || value==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_pop_wait, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_pop_wait, fifobuf uninitialized\n");
+		return -1;
+	}
+	// spin first, most waits are short
+	if(RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 1)==0) return 0;
+	if(timeout_us==0) return -1;
+	for(i=0;i<RC_FIFOBUF_SPIN;i++){
+		__rc_fifobuf_relax();
+		if(RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 1)==0) return 0;
+	}
+	deadline = __rc_fifobuf_deadline(timeout_us);
+	for(;;){
+		// register before the last check so a push after it must wake us
+		seq = __rc_fifobuf_enter_wait(&buf->data_seq, &buf->data_waiters);
+		if(RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 1)==0){
+			__rc_fifobuf_leave_wait(&buf->data_waiters);
+			return 0;
+		}
+		__RC_BUF_COUNT_SHARED(buf->counters, waits, 1);
+		ret = __rc_fifobuf_park(&buf->data_seq, seq, deadline, 0);
+		__rc_fifobuf_leave_wait(&buf->data_waiters);
+		if(RC_FIFOBUF_MPMC_PRIV(pop)(buf, value, 1)==0) return 0;
+		if(ret) return -1;
+	}
+}
+
+/**
+ * @brief      Like rc_fifobuf_mpmc_push but waits for a free slot if the
+ * buffer is full. Only call this from any producer thread.
+ *
+ * Retries RC_FIFOBUF_SPIN times and then parks the thread until a consumer
+ * pops. A timeout of 0 makes a single attempt and a negative timeout waits
+ * forever.
+ *
+ * @param      buf         Pointer to user's buffer
+ * @param[in]  val         The value to be inserted
+ * @param[in]  timeout_us  longest time to wait in microseconds
+ *
+ * @return     Returns 0 on success or -1 on failure or if still full when
+ * the timeout passes.
+ */
+static inline int RC_FIFOBUF_MPMC_FN(push_wait)(RC_FIFOBUF_MPMC_T* buf, FIFOBUF_TYPE val, long timeout_us)
+{
+	int i, ret;
+	unsigned int seq;
+	uint64_t deadline;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_push_wait, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_mpmc_push_wait, fifobuf uninitialized\n");
+		return -1;
+	}
+	// never full in overwrite mode
+	if(buf->overwrite) return RC_FIFOBUF_MPMC_PRIV(push_overwrite)(buf, val);
+	// spin first, most waits are short
+	if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)==0) return 0;
+	if(timeout_us==0){
+		__RC_BUF_COUNT_SHARED(buf->counters, rejected, 1);
+		return -1;
+	}
+	for(i=0;i<RC_FIFOBUF_SPIN;i++){
+		__rc_fifobuf_relax();
+		if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)==0) return 0;
+	}
+	deadline = __rc_fifobuf_deadline(timeout_us);
+	for(;;){
+		// register before the last check so a pop after it must wake us
+		seq = __rc_fifobuf_enter_wait(&buf->space_seq, &buf->space_waiters);
+		if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)==0){
+			__rc_fifobuf_leave_wait(&buf->space_waiters);
+			return 0;
+		}
+		__RC_BUF_COUNT_SHARED(buf->counters, waits, 1);
+		ret = __rc_fifobuf_park(&buf->space_seq, seq, deadline, 0);
+		__rc_fifobuf_leave_wait(&buf->space_waiters);
+		if(RC_FIFOBUF_MPMC_PRIV(push)(buf, val, 1)==0) return 0;
+		if(ret){
+			__RC_BUF_COUNT_SHARED(buf->counters, rejected, 1);
+			return -1;
+		}
+	}
+}
+#endif // RC_FIFOBUF_WAIT
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
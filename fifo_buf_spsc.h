@@ -0,0 +1,1177 @@
+/**
+ * "fifo_buf_spsc.h"
+ *
+ * @brief      lock-free single-producer/single-consumer fifo buffer
+ *
+ * This is a variant of the fifo buffer in fifo_buf.h which may be shared
+ * between exactly one producer thread (or ISR-style callback) and exactly one
+ * consumer thread without a mutex. Unlike rc_fifobuf_t, the producer and
+ * consumer never write the same variable. The producer only writes the head
+ * counter and the consumer only writes the tail counter. These are C11 atomics
+ * published with release ordering and read with acquire ordering, and they sit
+ * on separate cache lines so the two cores don't bounce a line back and forth
+ * on every operation.
+ *
+ * head and tail are free-running unsigned counters, the number of entries
+ * waiting is simply head-tail. The backing memory is rounded up to a power of
+ * two so indices wrap with a mask, but the buffer still only accepts up to
+ * the number of entries requested in rc_fifobuf_spsc_alloc.
+ *
+ * Uses the same FIFOBUF_TYPE and FIFOBUF_NAME as fifo_buf.h and can be
+ * included alongside it. With FIFOBUF_NAME f32 the type is
+ * rc_fifobuf_spsc_f32_t and the functions are rc_fifobuf_spsc_f32_push etc.
+ * Since this relies on <stdatomic.h> it is C only.
+ *
+ * rc_fifobuf_spsc_set_overwrite(buf, 1) makes the producer discard the oldest
+ * entry instead of failing when the buffer is full. The producer then has to
+ * move tail too, so in this mode both sides advance tail with a CAS and the
+ * consumer re-reads the entry if the producer dropped it first. Since the
+ * producer may then be rewriting the slot the consumer is copying, both sides
+ * copy entries in this mode as a series of relaxed atomic words rather than
+ * a plain assignment. That keeps the overlap free of data races, the torn
+ * copy is simply discarded when the consumer's CAS fails.
+ *
+ * Each side keeps a private copy of its own counter and of the last value it
+ * read of the other side's, on its own cache line. A push only reloads tail,
+ * pulling the consumer's line across, when the cached copy says the buffer
+ * is full, and a pop only reloads head when its copy says empty, so in a
+ * steady stream most operations touch no shared line but the slot itself.
+ * rc_fifobuf_spsc_set_batch(buf, k) goes further and has each side publish
+ * its counter only every k entries instead of on every push and pop. That
+ * cuts the line transfers between the cores by about k times, in exchange
+ * for entries waiting to be seen until their batch is published. The
+ * producer calls rc_fifobuf_spsc_flush and the consumer
+ * rc_fifobuf_spsc_flush_pop to publish a partial batch, e.g. before going
+ * idle. Either side publishes by itself when it finds the buffer full or
+ * empty, so neither can stall waiting on the other's unpublished batch.
+ *
+ * With RC_FIFOBUF_WAIT defined before including, rc_fifobuf_spsc_pop_wait and
+ * rc_fifobuf_spsc_push_wait block until an entry or a free slot turns up or a
+ * timeout passes, spinning briefly before parking on a futex, see
+ * fifo_buf_wait.h. Every push and pop then checks for parked waiters with one
+ * fence and a load and only enters the kernel to wake one if it is there.
+ * This changes the struct layout so define it the same way everywhere.
+ *
+ * The data is always allocated on a cache line boundary and padded out to a
+ * whole number of lines, so the first and last entries don't share a line
+ * with whatever malloc put next to them. RC_FIFOBUF_ALIGN raises this
+ * further, see fifo_buf.h.
+ *
+ * To pass entries between processes rather than threads, one process creates
+ * the buffer in a named POSIX shared memory segment with
+ * rc_fifobuf_spsc_shm_create and the other maps it with
+ * rc_fifobuf_spsc_shm_attach. The struct sits at the start of the segment
+ * with the data right after it, found through an offset from the struct
+ * rather than the d pointer since each process maps the segment at its own
+ * address. Both processes must use the same FIFOBUF_TYPE and RC_FIFOBUF_WAIT
+ * setting. Pushes and pops then move entries through the shared pages with
+ * no system calls or copies beyond the entry itself.
+ * rc_fifobuf_spsc_init_shared does the same for memory the user mapped
+ * themselves, e.g. MAP_SHARED|MAP_ANONYMOUS before a fork. Older glibc needs
+ * -lrt for shm_open, and strict ISO modes such as -std=c11 need
+ * _POSIX_C_SOURCE defined to 200112L or later for the named segments.
+ *
+ * With RC_BUF_COUNTERS defined the producer and consumer each keep counters
+ * on their own cache line, read with rc_fifobuf_spsc_counters. The peak is
+ * the number waiting as seen by the producer when it pushed. See
+ * buf_counters.h.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+
+#ifndef FIFOBUF_TYPE
+#error "ERROR user must #define FIFOBUF_TYPE before including fifo_buf_spsc.h"
+#endif
+
+#include <stdatomic.h>
+#include <stdint.h>
+#ifdef RC_FIFOBUF_WAIT
+#include "fifo_buf_wait.h"
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "buf_alloc.h"
+#include "buf_counters.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifndef unlikely
+#define unlikely(x)	__builtin_expect (!!(x), 0)
+#endif
+
+#ifndef likely
+#define likely(x)	__builtin_expect (!!(x), 1)
+#endif
+
+// name mangling for this instantiation, see fifo_buf.h
+#define __RC_FIFOBUF_CAT_(a,b,c)	a##b##c
+#define __RC_FIFOBUF_CAT(a,b,c)	__RC_FIFOBUF_CAT_(a,b,c)
+#undef RC_FIFOBUF_SPSC_T
+#undef RC_FIFOBUF_SPSC_FN
+#undef RC_FIFOBUF_SPSC_PRIV
+#ifdef FIFOBUF_NAME
+#define RC_FIFOBUF_SPSC_T	__RC_FIFOBUF_CAT(rc_fifobuf_spsc_, FIFOBUF_NAME, _t)
+#define RC_FIFOBUF_SPSC_FN(f)	__RC_FIFOBUF_CAT(rc_fifobuf_spsc_, FIFOBUF_NAME, _##f)
+#define RC_FIFOBUF_SPSC_PRIV(f)	__RC_FIFOBUF_CAT(__rc_fifobuf_spsc_, FIFOBUF_NAME, _##f)
+#else
+#define RC_FIFOBUF_SPSC_T	rc_fifobuf_spsc_t
+#define RC_FIFOBUF_SPSC_FN(f)	rc_fifobuf_spsc_##f
+#define RC_FIFOBUF_SPSC_PRIV(f)	__rc_fifobuf_spsc_##f
+#endif
+
+#ifndef RC_FIFOBUF_CACHELINE
+#define RC_FIFOBUF_CACHELINE 64
+#endif
+
+#ifndef RC_FIFOBUF_ALIGN
+#define RC_FIFOBUF_ALIGN 0
+#endif
+
+// alignment of the data from rc_fifobuf_spsc_alloc, at least a cache line
+#ifndef RC_FIFOBUF_LINE_ALIGN
+#define RC_FIFOBUF_LINE_ALIGN\
+	(RC_FIFOBUF_ALIGN>RC_FIFOBUF_CACHELINE ? RC_FIFOBUF_ALIGN : RC_FIFOBUF_CACHELINE)
+#endif
+
+
+/**
+ * @brief      Struct containing state of a single-producer/single-consumer
+ * fifo buffer and pointer to dynamically allocated memory.
+ *
+ * head and tail are each aligned to their own cache line. Since this makes the
+ * struct itself cache-line aligned, declare it statically or on the stack
+ * rather than with malloc.
+ */
+typedef struct RC_FIFOBUF_SPSC_T {
+	FIFOBUF_TYPE* d;	///< pointer to dynamically allocated data, NULL in shared memory
+	int size;		///< number of elements the buffer can hold
+	unsigned int mask;	///< length of d minus 1, d is a power of two long
+	int initialized;	///< flag indicating if memory has been allocated for the buffer
+	int user_mem;		///< flag indicating d was provided by the user and must not be freed
+	int overwrite;		///< flag indicating push discards the oldest entry when full
+	int batch;		///< entries between index publications, 0 or 1 for every entry
+	long shm_off;		///< offset of the data from the struct in shared memory, 0 otherwise
+	size_t shm_len;		///< bytes of shared memory holding the struct and data
+	_Alignas(RC_FIFOBUF_CACHELINE) atomic_uint head; ///< number of entries pushed and published, only written by producer
+	unsigned int head_local;	///< number of entries pushed including an unpublished batch
+	unsigned int tail_cache;	///< producer's last reading of tail
+	atomic_ulong dropped;	///< number of entries discarded by overwriting pushes
+#ifdef RC_FIFOBUF_WAIT
+	atomic_uint data_seq;		///< futex word bumped to wake a consumer waiting for data
+	atomic_uint data_waiters;	///< number of consumers in pop_wait
+#endif
+#ifdef RC_BUF_COUNTERS
+	rc_buf_atomic_counters_t push_counters;	///< only written by the producer, see buf_counters.h
+#endif
+	_Alignas(RC_FIFOBUF_CACHELINE) atomic_uint tail; ///< number of entries popped and published, also written by producer in overwrite mode
+	unsigned int tail_local;	///< number of entries popped including an unpublished batch
+	unsigned int head_cache;	///< consumer's last reading of head
+#ifdef RC_FIFOBUF_WAIT
+	atomic_uint space_seq;		///< futex word bumped to wake a producer waiting for space
+	atomic_uint space_waiters;	///< number of producers in push_wait
+#endif
+#ifdef RC_BUF_COUNTERS
+	rc_buf_atomic_counters_t pop_counters;	///< only written by the consumer
+#endif
+} RC_FIFOBUF_SPSC_T;
+
+
+#define RC_FIFOBUF_SPSC_INITIALIZER {\
+	.d = NULL,\
+	.size = 0,\
+	.mask = 0,\
+	.initialized = 0,\
+	.user_mem = 0,\
+	.head = 0,\
+	.tail = 0}
+
+/**
+ * Smallest power of two >= n for n>=2, as a constant expression.
+ */
+#ifndef RC_FIFOBUF_NEXT_POW2
+#define __RC_FIFOBUF_SMEAR1(x)	((x)|((x)>>1))
+#define __RC_FIFOBUF_SMEAR2(x)	(__RC_FIFOBUF_SMEAR1(x)|(__RC_FIFOBUF_SMEAR1(x)>>2))
+#define __RC_FIFOBUF_SMEAR4(x)	(__RC_FIFOBUF_SMEAR2(x)|(__RC_FIFOBUF_SMEAR2(x)>>4))
+#define __RC_FIFOBUF_SMEAR8(x)	(__RC_FIFOBUF_SMEAR4(x)|(__RC_FIFOBUF_SMEAR4(x)>>8))
+#define __RC_FIFOBUF_SMEAR16(x)	(__RC_FIFOBUF_SMEAR8(x)|(__RC_FIFOBUF_SMEAR8(x)>>16))
+#define RC_FIFOBUF_NEXT_POW2(n)	(__RC_FIFOBUF_SMEAR16((unsigned int)(n)-1)+1)
+#endif
+
+/**
+ * Number of FIFOBUF_TYPE elements of storage needed for an spsc buffer of
+ * size n, and an initializer for a buffer using the user's own storage array
+ * which must be at least that long and zero'd out.
+ */
+#define RC_FIFOBUF_SPSC_STORAGE_LEN(n)	RC_FIFOBUF_NEXT_POW2(n)
+#define RC_FIFOBUF_SPSC_STATIC_INITIALIZER(storage, n) {\
+	.d = (storage),\
+	.size = (n),\
+	.mask = RC_FIFOBUF_SPSC_STORAGE_LEN(n)-1,\
+	.initialized = 1,\
+	.user_mem = 1,\
+	.head = 0,\
+	.tail = 0}
+
+/**
+ * Declares a static spsc buffer called name of size n along with its
+ * storage, using the current FIFOBUF_TYPE. Use at file scope right after
+ * including the header.
+ */
+#define RC_FIFOBUF_SPSC_DECLARE_STATIC(name, n)\
+	static FIFOBUF_TYPE name##_storage[RC_FIFOBUF_SPSC_STORAGE_LEN(n)];\
+	static RC_FIFOBUF_SPSC_T name = RC_FIFOBUF_SPSC_STATIC_INITIALIZER(name##_storage, n)
+
+
+// the data as seen from this process, see top of file for shared memory
+static inline FIFOBUF_TYPE* RC_FIFOBUF_SPSC_PRIV(data)(RC_FIFOBUF_SPSC_T* buf)
+{
+	if(unlikely(buf->shm_off)) return (FIFOBUF_TYPE*)((char*)buf + buf->shm_off);
+	return buf->d;
+}
+
+// both sides' private copies of the counters, for when head and tail are set
+static inline void RC_FIFOBUF_SPSC_PRIV(clear_local)(RC_FIFOBUF_SPSC_T* buf)
+{
+	buf->head_local = atomic_load_explicit(&buf->head, memory_order_relaxed);
+	buf->tail_cache = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+	buf->tail_local = buf->tail_cache;
+	buf->head_cache = buf->head_local;
+}
+
+// make the producer's pushes visible to the consumer
+static inline void RC_FIFOBUF_SPSC_PRIV(publish_head)(RC_FIFOBUF_SPSC_T* buf, unsigned int h)
+{
+	atomic_store_explicit(&buf->head, h, memory_order_release);
+#ifdef RC_FIFOBUF_WAIT
+	__rc_fifobuf_wake(&buf->data_seq, &buf->data_waiters, buf->shm_off!=0);
+#endif
+}
+
+// hand the consumer's popped slots back to the producer
+static inline void RC_FIFOBUF_SPSC_PRIV(publish_tail)(RC_FIFOBUF_SPSC_T* buf, unsigned int t)
+{
+	atomic_store_explicit(&buf->tail, t, memory_order_release);
+#ifdef RC_FIFOBUF_WAIT
+	__rc_fifobuf_wake(&buf->space_seq, &buf->space_waiters, buf->shm_off!=0);
+#endif
+}
+
+// In overwrite mode the producer may rewrite a slot while the consumer is
+// still copying it out, the consumer then finds the CAS on tail failing and
+// throws the copy away. Both sides move the entry through the slot as relaxed
+// atomic words so that overlap is well defined, in the widest word the size
+// and alignment of FIFOBUF_TYPE allow. These are plain moves on every common
+// target. The branches are on constants so only one copy loop is left.
+#define __RC_FIFOBUF_SPSC_COPY(word, from, to, load)\
+	do{\
+		size_t __i;\
+		for(__i=0; __i*sizeof(word)<sizeof(FIFOBUF_TYPE); __i++){\
+			if(load) ((word*)(to))[__i] = atomic_load_explicit(\
+				&((_Atomic word*)(from))[__i], memory_order_relaxed);\
+			else atomic_store_explicit(&((_Atomic word*)(to))[__i],\
+				((const word*)(from))[__i], memory_order_relaxed);\
+		}\
+	}while(0)
+
+#define __RC_FIFOBUF_SPSC_FITS(word)\
+	(sizeof(FIFOBUF_TYPE)%sizeof(word)==0 && _Alignof(FIFOBUF_TYPE)>=_Alignof(word))
+
+static inline void RC_FIFOBUF_SPSC_PRIV(copy_slot)(void* to, const void* from, int load)
+{
+	if(__RC_FIFOBUF_SPSC_FITS(uint64_t)) __RC_FIFOBUF_SPSC_COPY(uint64_t, from, to, load);
+	else if(__RC_FIFOBUF_SPSC_FITS(uint32_t)) __RC_FIFOBUF_SPSC_COPY(uint32_t, from, to, load);
+	else if(__RC_FIFOBUF_SPSC_FITS(uint16_t)) __RC_FIFOBUF_SPSC_COPY(uint16_t, from, to, load);
+	else __RC_FIFOBUF_SPSC_COPY(uint8_t, from, to, load);
+}
+
+/**
+ * @brief      Allocates memory for a spsc fifo buffer and initializes an
+ * rc_fifobuf_spsc_t struct.
+ *
+ * If buf is already the right size then it is left untouched. Otherwise any
+ * existing memory allocated for buf is freed to avoid memory leaks and new
+ * memory is allocated, and overwrite mode, batching and the dropped count go
+ * back to their defaults. This is not thread safe, allocate the buffer
+ * before starting the producer and consumer threads.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  size  Number of elements to allocate space for
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(alloc)(RC_FIFOBUF_SPSC_T* buf, int size)
+{
+	unsigned int len;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2 || size>(1<<30))){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_alloc, size must be >=2 and <=2^30\n");
+		return -1;
+	}
+	if(unlikely(buf->shm_off)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_alloc, buffer is in shared memory\n");
+		return -1;
+	}
+	// if it's already allocated, nothing to do
+	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+	// round the backing memory up to a power of two
+	len = 2;
+	while(len<(unsigned int)size) len<<=1;
+	// make sure it's zero'd out
+	buf->size = 0;
+	buf->mask = 0;
+	buf->initialized = 0;
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+	buf->overwrite = 0;
+	buf->batch = 0;
+	RC_FIFOBUF_SPSC_PRIV(clear_local)(buf);
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->push_counters);
+	__rc_buf_counters_clear(&buf->pop_counters);
+#endif
+	// free memory and allocate fresh
+	if(!buf->user_mem) free(buf->d);
+	buf->user_mem = 0;
+	buf->d = (FIFOBUF_TYPE*)__rc_buf_alloc(len,sizeof(FIFOBUF_TYPE),RC_FIFOBUF_LINE_ALIGN);
+	if(buf->d==NULL){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_alloc, failed to allocate memory\n");
+		return -1;
+	}
+	// write out other details
+	buf->size = size;
+	buf->mask = len-1;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Frees the memory allocated for buffer buf.
+ *
+ * Also set the initialized flag to 0 so other functions don't try to access
+ * unallocated memory. Make sure neither thread is still using the buffer.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(free)(RC_FIFOBUF_SPSC_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_free, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(buf->shm_off)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_free, use rc_fifobuf_spsc_shm_detach for shared memory\n");
+		return -1;
+	}
+	if(buf->initialized && !buf->user_mem) free(buf->d);
+	buf->d = NULL;
+	buf->size = 0;
+	buf->mask = 0;
+	buf->initialized = 0;
+	buf->user_mem = 0;
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+	buf->overwrite = 0;
+	buf->batch = 0;
+	RC_FIFOBUF_SPSC_PRIV(clear_local)(buf);
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->push_counters);
+	__rc_buf_counters_clear(&buf->pop_counters);
+#endif
+	return 0;
+}
+
+/**
+ * @brief      Initializes an spsc fifo buffer to use memory provided by the
+ * user instead of allocating it.
+ *
+ * storage must be at least RC_FIFOBUF_SPSC_STORAGE_LEN(size) elements long.
+ * It is zero'd out here and is never freed by rc_fifobuf_spsc_free or
+ * rc_fifobuf_spsc_alloc. Overwrite mode, batching and the dropped count go
+ * back to their defaults. This is not thread safe, call it before starting
+ * the producer and consumer threads.
+ *
+ * @param      buf      Pointer to user's buffer
+ * @param      storage  memory for the buffer's contents
+ * @param[in]  size     Number of elements the buffer should hold
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(init_static)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE* storage, int size)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || storage==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_init_static, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2 || size>(1<<30))){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_init_static, size must be >=2 and <=2^30\n");
+		return -1;
+	}
+	// release anything allocated previously
+	if(buf->initialized && !buf->user_mem && buf->d!=storage) free(buf->d);
+	memset(storage,0,RC_FIFOBUF_SPSC_STORAGE_LEN(size)*sizeof(FIFOBUF_TYPE));
+	buf->d = storage;
+	buf->size = size;
+	buf->mask = RC_FIFOBUF_SPSC_STORAGE_LEN(size)-1;
+	buf->user_mem = 1;
+	buf->shm_off = 0;
+	buf->shm_len = 0;
+	buf->initialized = 1;
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	atomic_store(&buf->dropped, 0);
+	buf->overwrite = 0;
+	buf->batch = 0;
+	RC_FIFOBUF_SPSC_PRIV(clear_local)(buf);
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->push_counters);
+	__rc_buf_counters_clear(&buf->pop_counters);
+#endif
+	return 0;
+}
+
+/**
+ * @brief      Touches every page of the buffer's memory so it is resident
+ * before the first entry arrives, and optionally locks it in RAM.
+ *
+ * Call this at startup before starting the producer and consumer threads.
+ * Locking requires permission to mlock, e.g. CAP_IPC_LOCK or a large enough
+ * RLIMIT_MEMLOCK.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  lock  nonzero to also mlock the memory
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(prefault)(RC_FIFOBUF_SPSC_T* buf, int lock)
+{
+	size_t i, bytes;
+	volatile char* p;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_prefault, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_prefault, fifobuf uninitialized\n");
+		return -1;
+	}
+	bytes = ((size_t)buf->mask+1)*sizeof(FIFOBUF_TYPE);
+	// write to each page so copy-on-write and zero pages get a real frame
+	p = (volatile char*)RC_FIFOBUF_SPSC_PRIV(data)(buf);
+	for(i=0;i<bytes;i+=4096) p[i] = p[i];
+	if(lock && mlock((const void*)p, bytes)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_prefault, mlock failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Number of bytes of shared memory needed for an spsc buffer of
+ * the given size, the struct followed by its data.
+ *
+ * @param[in]  size  Number of elements the buffer should hold
+ *
+ * @return     bytes needed, or 0 if size is out of range
+ */
+static inline size_t RC_FIFOBUF_SPSC_FN(shm_bytes)(int size)
+{
+	size_t hdr = (sizeof(RC_FIFOBUF_SPSC_T)+RC_FIFOBUF_LINE_ALIGN-1) & ~((size_t)RC_FIFOBUF_LINE_ALIGN-1);
+	if(size<2 || size>(1<<30)) return 0;
+	return hdr + (size_t)RC_FIFOBUF_SPSC_STORAGE_LEN(size)*sizeof(FIFOBUF_TYPE);
+}
+
+/**
+ * @brief      Initializes an spsc fifo buffer at the start of a block of
+ * memory shared between processes, with its data right after it.
+ *
+ * mem must be at least rc_fifobuf_spsc_shm_bytes(size) long, cache line
+ * aligned, and mapped MAP_SHARED in every process using it, e.g. a mapping
+ * made before fork. Only one process initializes the buffer, the others just
+ * use the pointer to their own mapping. rc_fifobuf_spsc_shm_create does this
+ * for a named segment.
+ *
+ * @param      mem   start of the shared memory
+ * @param[in]  size  Number of elements the buffer should hold
+ *
+ * @return     pointer to the buffer, which is mem, or NULL on failure.
+ */
+static inline RC_FIFOBUF_SPSC_T* RC_FIFOBUF_SPSC_FN(init_shared)(void* mem, int size)
+{
+	RC_FIFOBUF_SPSC_T* buf = (RC_FIFOBUF_SPSC_T*)mem;
+	size_t bytes = RC_FIFOBUF_SPSC_FN(shm_bytes)(size);
+	// sanity checks
+	if(unlikely(mem==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_init_shared, received NULL pointer\n");
+		return NULL;
+	}
+	if(unlikely(bytes==0)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_init_shared, size must be >=2 and <=2^30\n");
+		return NULL;
+	}
+	if(unlikely((size_t)mem % RC_FIFOBUF_CACHELINE)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_init_shared, memory must be cache line aligned\n");
+		return NULL;
+	}
+	memset(mem, 0, bytes);
+	buf->d = NULL;
+	buf->size = size;
+	buf->mask = RC_FIFOBUF_SPSC_STORAGE_LEN(size)-1;
+	buf->user_mem = 1;
+	buf->shm_off = (long)(bytes - (size_t)RC_FIFOBUF_SPSC_STORAGE_LEN(size)*sizeof(FIFOBUF_TYPE));
+	buf->shm_len = bytes;
+	// everything above must be visible before another process sees this
+	atomic_thread_fence(memory_order_release);
+	buf->initialized = 1;
+	return buf;
+}
+
+// named segments need POSIX.1-2001, which strict ISO C modes like -std=c11
+// hide unless _POSIX_C_SOURCE is defined
+#if !defined(__STRICT_ANSI__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE>=200112L)
+/**
+ * @brief      Creates a named POSIX shared memory segment holding a new spsc
+ * fifo buffer and maps it into this process.
+ *
+ * name follows shm_open's rules, e.g. "/imu_samples". An existing segment of
+ * the same name is reused and reinitialized, so create it before starting
+ * the process which attaches. Remove the name with shm_unlink when done.
+ *
+ * @param[in]  name  name of the segment
+ * @param[in]  size  Number of elements the buffer should hold
+ *
+ * @return     pointer to the buffer or NULL on failure.
+ */
+static inline RC_FIFOBUF_SPSC_T* RC_FIFOBUF_SPSC_FN(shm_create)(const char* name, int size)
+{
+	int fd;
+	void* mem;
+	size_t bytes = RC_FIFOBUF_SPSC_FN(shm_bytes)(size);
+	// sanity checks
+	if(unlikely(name==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_create, received NULL pointer\n");
+		return NULL;
+	}
+	if(unlikely(bytes==0)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_create, size must be >=2 and <=2^30\n");
+		return NULL;
+	}
+	fd = shm_open(name, O_CREAT|O_RDWR, 0600);
+	if(fd<0){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_create, shm_open failed\n");
+		return NULL;
+	}
+	if(ftruncate(fd, (off_t)bytes)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_create, ftruncate failed\n");
+		close(fd);
+		return NULL;
+	}
+	mem = mmap(NULL, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mem==MAP_FAILED){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_create, mmap failed\n");
+		return NULL;
+	}
+	return RC_FIFOBUF_SPSC_FN(init_shared)(mem, size);
+}
+
+/**
+ * @brief      Maps an spsc fifo buffer made by rc_fifobuf_spsc_shm_create in
+ * another process into this one.
+ *
+ * Fails if the segment doesn't exist yet, isn't initialized, or doesn't match
+ * the size of this instantiation's FIFOBUF_TYPE.
+ *
+ * @param[in]  name  name of the segment
+ *
+ * @return     pointer to the buffer or NULL on failure.
+ */
+static inline RC_FIFOBUF_SPSC_T* RC_FIFOBUF_SPSC_FN(shm_attach)(const char* name)
+{
+	int fd;
+	struct stat st;
+	void* mem;
+	RC_FIFOBUF_SPSC_T* buf;
+	// sanity checks
+	if(unlikely(name==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_attach, received NULL pointer\n");
+		return NULL;
+	}
+	fd = shm_open(name, O_RDWR, 0);
+	if(fd<0){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_attach, shm_open failed\n");
+		return NULL;
+	}
+	if(fstat(fd, &st) || (size_t)st.st_size<sizeof(RC_FIFOBUF_SPSC_T)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_attach, segment too small\n");
+		close(fd);
+		return NULL;
+	}
+	mem = mmap(NULL, (size_t)st.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mem==MAP_FAILED){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_attach, mmap failed\n");
+		return NULL;
+	}
+	buf = (RC_FIFOBUF_SPSC_T*)mem;
+	// pairs with the fence in rc_fifobuf_spsc_init_shared
+	if(buf->initialized) atomic_thread_fence(memory_order_acquire);
+	if(!buf->initialized || buf->shm_len!=(size_t)st.st_size ||
+			buf->shm_len!=RC_FIFOBUF_SPSC_FN(shm_bytes)(buf->size)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_attach, segment not initialized or made for another FIFOBUF_TYPE\n");
+		munmap(mem, (size_t)st.st_size);
+		return NULL;
+	}
+	return buf;
+}
+#endif
+
+/**
+ * @brief      Unmaps a buffer in shared memory from this process. The buffer
+ * and its contents stay in the segment for other processes.
+ *
+ * @param      buf   pointer returned by rc_fifobuf_spsc_shm_create or
+ * rc_fifobuf_spsc_shm_attach
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(shm_detach)(RC_FIFOBUF_SPSC_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_detach, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->shm_off)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_detach, buffer is not in shared memory\n");
+		return -1;
+	}
+	if(munmap((void*)buf, buf->shm_len)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_shm_detach, munmap failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      memsets the buffer to 0 and discards all waiting entries.
+ *
+ * This is not thread safe, only call it while neither the producer nor the
+ * consumer are using the buffer.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(reset)(RC_FIFOBUF_SPSC_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_spsc_reset, fifobuf uninitialized\n");
+		return -1;
+	}
+	// wipe the data and counters
+	memset(RC_FIFOBUF_SPSC_PRIV(data)(buf),0,(buf->mask+1)*sizeof(FIFOBUF_TYPE));
+	atomic_store(&buf->head, 0);
+	atomic_store(&buf->tail, 0);
+	RC_FIFOBUF_SPSC_PRIV(clear_local)(buf);
+	atomic_store(&buf->dropped, 0);
+#ifdef RC_BUF_COUNTERS
+	__rc_buf_counters_clear(&buf->push_counters);
+	__rc_buf_counters_clear(&buf->pop_counters);
+#endif
+	return 0;
+}
+
+/**
+ * @brief      Chooses what rc_fifobuf_spsc_push does when the buffer is full.
+ *
+ * With enable 0 (the default) it rejects new entries. Otherwise it discards
+ * the oldest entry to make room, see top of file. Only call this while
+ * neither the producer nor the consumer are using the buffer.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  enable  nonzero to overwrite the oldest entries when full
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(set_overwrite)(RC_FIFOBUF_SPSC_T* buf, int enable)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_set_overwrite, received NULL pointer\n");
+		return -1;
+	}
+	// publish anything batched, overwrite mode keeps no private counters
+	if(!buf->overwrite){
+		atomic_store(&buf->head, buf->head_local);
+		atomic_store(&buf->tail, buf->tail_local);
+	}
+	buf->overwrite = (enable!=0);
+	if(buf->overwrite) buf->batch = 0;
+	RC_FIFOBUF_SPSC_PRIV(clear_local)(buf);
+	return 0;
+}
+
+/**
+ * @brief      Sets how many entries each side handles before publishing its
+ * counter to the other, see top of file.
+ *
+ * With batch 0 or 1 (the default) every push and pop is published at once.
+ * Larger batches cut the traffic between the cores but leave up to batch-1
+ * entries unseen by the consumer until the producer's next publication, and
+ * rc_fifobuf_spsc_available only counts published entries. Batching does not
+ * work in overwrite mode where both sides move tail, so a batch above 1 then
+ * returns -1, and turning overwrite mode on turns batching off. Only call
+ * this while neither the producer nor the consumer are using the buffer.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[in]  batch  entries per publication, 0 to the size of the buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(set_batch)(RC_FIFOBUF_SPSC_T* buf, int batch)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_set_batch, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_set_batch, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(batch<0 || batch>buf->size)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_set_batch, batch must be between 0 and size\n");
+		return -1;
+	}
+	if(unlikely(buf->overwrite && batch>1)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_set_batch, not available in overwrite mode\n");
+		return -1;
+	}
+	buf->batch = batch;
+	return 0;
+}
+
+/**
+ * @brief      Publishes any pushes held back by batching so the consumer can
+ * see them. Only call this from the producer thread.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(flush)(RC_FIFOBUF_SPSC_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_flush, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_flush, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(buf->head_local!=atomic_load_explicit(&buf->head, memory_order_relaxed)){
+		RC_FIFOBUF_SPSC_PRIV(publish_head)(buf, buf->head_local);
+	}
+	return 0;
+}
+
+/**
+ * @brief      Publishes any pops held back by batching so the producer can
+ * reuse their slots. Only call this from the consumer thread.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(flush_pop)(RC_FIFOBUF_SPSC_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_flush_pop, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_flush_pop, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(!buf->overwrite &&
+			buf->tail_local!=atomic_load_explicit(&buf->tail, memory_order_relaxed)){
+		RC_FIFOBUF_SPSC_PRIV(publish_tail)(buf, buf->tail_local);
+	}
+	return 0;
+}
+
+/**
+ * @brief      Returns the number of entries discarded by pushes to a full
+ * buffer in overwrite mode. May be called from either thread.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of entries dropped, or -1 on error.
+ */
+static inline long RC_FIFOBUF_SPSC_FN(dropped)(RC_FIFOBUF_SPSC_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_dropped, received NULL pointer\n");
+		return -1;
+	}
+	return (long)atomic_load_explicit(&buf->dropped, memory_order_relaxed);
+}
+
+/**
+ * @brief      Returns the number of entries waiting to be read.
+ *
+ * May be called from either thread. The result is a snapshot, the other
+ * thread may have pushed or popped by the time it is used.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of entries waiting, or -1 on error.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(available)(RC_FIFOBUF_SPSC_T* buf)
+{
+	unsigned int h, t;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_available, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_spsc_available, fifobuf uninitialized\n");
+		return -1;
+	}
+	// read tail first so head-tail can never appear larger than size
+	t = atomic_load_explicit(&buf->tail, memory_order_acquire);
+	h = atomic_load_explicit(&buf->head, memory_order_acquire);
+	return (int)(h-t);
+}
+
+#ifdef RC_BUF_COUNTERS
+/**
+ * @brief      Takes a snapshot of the buffer's counters, see buf_counters.h.
+ * May be called from any thread while the buffer is in use.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the producer's and consumer's counters combined
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(counters)(RC_FIFOBUF_SPSC_T* buf, rc_buf_counters_t* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr, "ERROR in rc_fifobuf_spsc_counters, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_fifobuf_spsc_counters, fifobuf uninitialized\n");
+		return -1;
+	}
+	memset(out, 0, sizeof(*out));
+	__rc_buf_counters_add(out, &buf->push_counters);
+	__rc_buf_counters_add(out, &buf->pop_counters);
+	return 0;
+}
+#endif
+
+/**
+ * Pushes val if there is room or overwrite mode makes room, without the
+ * sanity checks so push_wait can retry it without counting every attempt as
+ * a rejection.
+ */
+static inline int RC_FIFOBUF_SPSC_PRIV(push)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE val)
+{
+	unsigned int h, t;
+	// head is ours, tail is the last we saw of the consumer. It can only
+	// have moved on since, so going by it can't overfill the buffer
+	h = buf->head_local;
+	t = buf->tail_cache;
+
+	// check for full. fail silently as the user may run into this as an
+	// intentional check for the buffer being full
+	if(h-t == (unsigned int)buf->size){
+		// acquire on tail makes sure the consumer is done reading the slot
+		// we are about to overwrite
+		t = atomic_load_explicit(&buf->tail, memory_order_acquire);
+		buf->tail_cache = t;
+	}
+	if(h-t == (unsigned int)buf->size){
+		if(!buf->overwrite){
+			// the consumer can't drain what it hasn't been shown
+			if(h!=atomic_load_explicit(&buf->head, memory_order_relaxed)){
+				RC_FIFOBUF_SPSC_PRIV(publish_head)(buf, h);
+			}
+			return -1;
+		}
+		// drop the oldest entry. If the CAS fails the consumer just
+		// popped it, so there is room now either way
+		if(atomic_compare_exchange_strong_explicit(&buf->tail, &t, t+1,
+				memory_order_acq_rel, memory_order_acquire)){
+			atomic_fetch_add_explicit(&buf->dropped, 1, memory_order_relaxed);
+			__RC_BUF_COUNT_OWNED(buf->push_counters, overwrites, 1);
+			t++;
+		}
+		else __RC_BUF_COUNT_OWNED(buf->push_counters, retries, 1);
+		buf->tail_cache = t;
+	}
+
+	if(buf->overwrite){
+		RC_FIFOBUF_SPSC_PRIV(copy_slot)(&RC_FIFOBUF_SPSC_PRIV(data)(buf)[h & buf->mask], &val, 0);
+	}
+	else RC_FIFOBUF_SPSC_PRIV(data)(buf)[h & buf->mask] = val;
+	buf->head_local = ++h;
+	// publish to the consumer once a whole batch is written
+	if(h-atomic_load_explicit(&buf->head, memory_order_relaxed) >= (unsigned int)buf->batch){
+		RC_FIFOBUF_SPSC_PRIV(publish_head)(buf, h);
+	}
+	__RC_BUF_COUNT_OWNED(buf->push_counters, pushes, 1);
+	__RC_BUF_PEAK_OWNED(buf->push_counters, h-t);
+	return 0;
+}
+
+/**
+ * @brief      Puts a new entry into the fifo buffer. Only call this from the
+ * producer thread.
+ *
+ * If the buffer is full this fails, unless overwrite mode is on in which case
+ * the oldest entry is discarded to make room.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be inserted
+ *
+ * @return     Returns 0 on success or -1 on failure or if full.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(push)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE val)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_push, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_push, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(RC_FIFOBUF_SPSC_PRIV(push)(buf, val)){
+		__RC_BUF_COUNT_OWNED(buf->push_counters, rejected, 1);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Pops the oldest entry out of the fifo buffer. Only call this
+ * from the consumer thread.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[out] value  pointer to write the popped value to
+ *
+ * @return     Returns 0 on success or -1 on failure or if empty.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(pop)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE* value)
+{
+	unsigned int h, t;
+	FIFOBUF_TYPE v;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_pop, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_pop, fifobuf uninitialized\n");
+		return -1;
+	}
+	if(buf->overwrite){
+		// tail is ours unless overwriting so relaxed is fine, acquire on
+		// head makes sure the value written by the producer is visible
+		t = atomic_load_explicit(&buf->tail, memory_order_relaxed);
+		h = atomic_load_explicit(&buf->head, memory_order_acquire);
+		if(h == t) return -1;
+		// the producer may drop this entry and reuse its slot while we
+		// copy it out. The CAS only succeeds if it didn't, otherwise start
+		// over from the new oldest entry. Release on the CAS keeps the copy
+		// from being reordered after it.
+		for(;;){
+			RC_FIFOBUF_SPSC_PRIV(copy_slot)(&v, &RC_FIFOBUF_SPSC_PRIV(data)(buf)[t & buf->mask], 1);
+			if(atomic_compare_exchange_weak_explicit(&buf->tail, &t, t+1,
+				memory_order_acq_rel, memory_order_relaxed)) break;
+			__RC_BUF_COUNT_OWNED(buf->pop_counters, retries, 1);
+			h = atomic_load_explicit(&buf->head, memory_order_acquire);
+			if(h == t) return -1;
+		}
+		*value = v;
+#ifdef RC_FIFOBUF_WAIT
+		__rc_fifobuf_wake(&buf->space_seq, &buf->space_waiters, buf->shm_off!=0);
+#endif
+	}
+	else{
+		// tail is ours, head is the last we saw of the producer and only
+		// re-read once we have caught up with it
+		t = buf->tail_local;
+		h = buf->head_cache;
+		if(h == t){
+			h = atomic_load_explicit(&buf->head, memory_order_acquire);
+			buf->head_cache = h;
+		}
+		// check for empty. fail silently as the user may run into this as
+		// an intentional check for the buffer being empty
+		if(h == t){
+			// the producer can't refill slots it hasn't been given back
+			if(t!=atomic_load_explicit(&buf->tail, memory_order_relaxed)){
+				RC_FIFOBUF_SPSC_PRIV(publish_tail)(buf, t);
+			}
+			return -1;
+		}
+		*value = RC_FIFOBUF_SPSC_PRIV(data)(buf)[t & buf->mask];
+		buf->tail_local = ++t;
+		// hand the slots back to the producer once a whole batch is read
+		if(t-atomic_load_explicit(&buf->tail, memory_order_relaxed) >= (unsigned int)buf->batch){
+			RC_FIFOBUF_SPSC_PRIV(publish_tail)(buf, t);
+		}
+	}
+	__RC_BUF_COUNT_OWNED(buf->pop_counters, pops, 1);
+	return 0;
+}
+
+
+#ifdef RC_FIFOBUF_WAIT
+/**
+ * @brief      Like rc_fifobuf_spsc_pop but waits for an entry if the buffer
+ * is empty. Only call this from the consumer thread.
+ *
+ * Retries RC_FIFOBUF_SPIN times and then parks the thread until a producer
+ * pushes. A timeout of 0 makes a single attempt and a negative timeout waits
+ * forever.
+ *
+ * @param      buf         Pointer to user's buffer
+ * @param[out] value       pointer to write the popped value to
+ * @param[in]  timeout_us  longest time to wait in microseconds
+ *
+ * @return     Returns 0 on success or -1 on failure or if still empty when
+ * the timeout passes.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(pop_wait)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE* value, long timeout_us)
+{
+	int i, ret;
+	unsigned int seq;
+	uint64_t deadline;
+	// sanity checks
+	if(unlikely(buf==NULL || value==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_pop_wait, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_pop_wait, fifobuf uninitialized\n");
+		return -1;
+	}
+	// spin first, most waits are short
+	if(RC_FIFOBUF_SPSC_FN(pop)(buf, value)==0) return 0;
+	if(timeout_us==0) return -1;
+	for(i=0;i<RC_FIFOBUF_SPIN;i++){
+		__rc_fifobuf_relax();
+		if(RC_FIFOBUF_SPSC_FN(pop)(buf, value)==0) return 0;
+	}
+	deadline = __rc_fifobuf_deadline(timeout_us);
+	for(;;){
+		// register before the last check so a push after it must wake us
+		seq = __rc_fifobuf_enter_wait(&buf->data_seq, &buf->data_waiters);
+		if(RC_FIFOBUF_SPSC_FN(pop)(buf, value)==0){
+			__rc_fifobuf_leave_wait(&buf->data_waiters);
+			return 0;
+		}
+		__RC_BUF_COUNT_OWNED(buf->pop_counters, waits, 1);
+		ret = __rc_fifobuf_park(&buf->data_seq, seq, deadline, buf->shm_off!=0);
+		__rc_fifobuf_leave_wait(&buf->data_waiters);
+		if(RC_FIFOBUF_SPSC_FN(pop)(buf, value)==0) return 0;
+		if(ret) return -1;
+	}
+}
+
+/**
+ * @brief      Like rc_fifobuf_spsc_push but waits for a free slot if the
+ * buffer is full. Only call this from the producer thread.
+ *
+ * Retries RC_FIFOBUF_SPIN times and then parks the thread until a consumer
+ * pops. A timeout of 0 makes a single attempt and a negative timeout waits
+ * forever.
+ *
+ * @param      buf         Pointer to user's buffer
+ * @param[in]  val         The value to be inserted
+ * @param[in]  timeout_us  longest time to wait in microseconds
+ *
+ * @return     Returns 0 on success or -1 on failure or if still full when
+ * the timeout passes.
+ */
+static inline int RC_FIFOBUF_SPSC_FN(push_wait)(RC_FIFOBUF_SPSC_T* buf, FIFOBUF_TYPE val, long timeout_us)
+{
+	int i, ret;
+	unsigned int seq;
+	uint64_t deadline;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_push_wait, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_fifobuf_spsc_push_wait, fifobuf uninitialized\n");
+		return -1;
+	}
+	// never full in overwrite mode
+	if(buf->overwrite) return RC_FIFOBUF_SPSC_FN(push)(buf, val);
+	// spin first, most waits are short
+	if(RC_FIFOBUF_SPSC_PRIV(push)(buf, val)==0) return 0;
+	if(timeout_us==0){
+		__RC_BUF_COUNT_OWNED(buf->push_counters, rejected, 1);
+		return -1;
+	}
+	for(i=0;i<RC_FIFOBUF_SPIN;i++){
+		__rc_fifobuf_relax();
+		if(RC_FIFOBUF_SPSC_PRIV(push)(buf, val)==0) return 0;
+	}
+	deadline = __rc_fifobuf_deadline(timeout_us);
+	for(;;){
+		// register before the last check so a pop after it must wake us
+		seq = __rc_fifobuf_enter_wait(&buf->space_seq, &buf->space_waiters);
+		if(RC_FIFOBUF_SPSC_PRIV(push)(buf, val)==0){
+			__rc_fifobuf_leave_wait(&buf->space_waiters);
+			return 0;
+		}
+		__RC_BUF_COUNT_OWNED(buf->push_counters, waits, 1);
+		ret = __rc_fifobuf_park(&buf->space_seq, seq, deadline, buf->shm_off!=0);
+		__rc_fifobuf_leave_wait(&buf->space_waiters);
+		if(RC_FIFOBUF_SPSC_PRIV(push)(buf, val)==0) return 0;
+		if(ret){
+			__RC_BUF_COUNT_OWNED(buf->push_counters, rejected, 1);
+			return -1;
+		}
+	}
+}
+#endif // RC_FIFOBUF_WAIT
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
@@ -0,0 +1,154 @@
+/**
+ * "fifo_buf_wait.h"
+ *
+ * @brief      parking and waking helpers shared by the thread safe fifo
+ *             buffers when RC_FIFOBUF_WAIT is defined
+ *
+ * A thread which finds a buffer empty (or full) spins for RC_FIFOBUF_SPIN
+ * attempts and then parks on a 32-bit sequence word with a futex on Linux.
+ * The other side bumps the word and issues the wake system call only if the
+ * matching waiter count is nonzero, so pushes and pops never enter the
+ * kernel while nobody is parked. Elsewhere parking falls back to sleeping
+ * for RC_FIFOBUF_PARK_US at a time. Buffers in memory shared between
+ * processes pass shared so the futex is keyed on the page rather than the
+ * address space.
+ *
+ * This header is included by fifo_buf_spsc.h and fifo_buf_mpmc.h and does
+ * not need to be included directly. Unlike those it does not depend on
+ * FIFOBUF_TYPE and is only expanded once.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_FIFOBUF_WAIT_H
+#define RC_FIFOBUF_WAIT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// attempts made before parking
+#ifndef RC_FIFOBUF_SPIN
+#define RC_FIFOBUF_SPIN 256
+#endif
+
+// sleep between checks where futexes are unavailable
+#ifndef RC_FIFOBUF_PARK_US
+#define RC_FIFOBUF_PARK_US 50
+#endif
+
+
+/**
+ * Tells the CPU we are spinning so it can back off the pipeline and give
+ * a hyperthread sibling the core.
+ */
+static inline void __rc_fifobuf_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+static inline uint64_t __rc_fifobuf_now_ns(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Converts a timeout in microseconds to an absolute CLOCK_MONOTONIC deadline
+ * in ns. Negative timeouts mean wait forever and give a deadline of 0.
+ */
+static inline uint64_t __rc_fifobuf_deadline(long timeout_us)
+{
+	if(timeout_us<0) return 0;
+	return __rc_fifobuf_now_ns() + (uint64_t)timeout_us*1000ull;
+}
+
+/**
+ * Blocks until word no longer holds val, a wake arrives, or the deadline
+ * passes. Spurious returns are allowed, the caller re-checks the buffer.
+ *
+ * @return     0 if woken or the word changed, -1 if the deadline has passed
+ */
+static inline int __rc_fifobuf_park(atomic_uint* word, unsigned int val, uint64_t deadline, int shared)
+{
+	uint64_t now = 0;
+	if(deadline){
+		now = __rc_fifobuf_now_ns();
+		if(now>=deadline) return -1;
+	}
+#ifdef __linux__
+	struct timespec rel, *relp = NULL;
+	if(deadline){
+		rel.tv_sec = (time_t)((deadline-now)/1000000000ull);
+		rel.tv_nsec = (long)((deadline-now)%1000000000ull);
+		relp = &rel;
+	}
+	if(syscall(SYS_futex, (void*)word, shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+					val, relp, NULL, 0) && errno==ETIMEDOUT) return -1;
+#else
+	struct timespec nap = {0, RC_FIFOBUF_PARK_US*1000L};
+	(void)shared;
+	if(atomic_load_explicit(word, memory_order_relaxed)==val) nanosleep(&nap, NULL);
+#endif
+	return 0;
+}
+
+/**
+ * Called after a push or pop made progress. Wakes one parked thread if and
+ * only if the waiter count says one may be parked on word. The fence pairs
+ * with the one in __rc_fifobuf_enter_wait so that either the waiter sees the
+ * progress or we see the waiter.
+ */
+static inline void __rc_fifobuf_wake(atomic_uint* word, atomic_uint* waiters, int shared)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	if(__builtin_expect(atomic_load_explicit(waiters, memory_order_relaxed)==0, 1)) return;
+	atomic_fetch_add_explicit(word, 1, memory_order_release);
+#ifdef __linux__
+	syscall(SYS_futex, (void*)word, shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+	(void)shared;
+#endif
+}
+
+/**
+ * Registers the calling thread as a waiter on word and returns the value to
+ * pass to __rc_fifobuf_park. The caller must re-check the buffer after this
+ * and before parking, then call __rc_fifobuf_leave_wait.
+ */
+static inline unsigned int __rc_fifobuf_enter_wait(atomic_uint* word, atomic_uint* waiters)
+{
+	unsigned int val = atomic_load_explicit(word, memory_order_acquire);
+	atomic_fetch_add_explicit(waiters, 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	return val;
+}
+
+static inline void __rc_fifobuf_leave_wait(atomic_uint* waiters)
+{
+	atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_FIFOBUF_WAIT_H
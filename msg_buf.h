@@ -0,0 +1,524 @@
+/**
+ * "msg_buf.h"
+ *
+ * @brief      fifo buffer of variable length records
+ *
+ * Where fifo_buf.h holds entries of one fixed FIFOBUF_TYPE, this holds
+ * records of any length in one block of bytes, e.g. MAVLink frames or log
+ * lines, so mixed traffic doesn't need every slot sized for the largest
+ * message. Each record is stored as a 32-bit length header followed by its
+ * bytes, padded to a multiple of 4 so the next header stays aligned.
+ *
+ * A record never wraps around the end of memory. If it doesn't fit in the
+ * space left before the end then that space is marked as padding and the
+ * record goes at the start instead, so rc_msgbuf_peek and rc_msgbuf_reserve
+ * can always hand out one contiguous pointer to a whole record for zero-copy
+ * reads and writes. When the buffer empties it starts again from the
+ * beginning to keep the most contiguous room.
+ *
+ * Like rc_fifobuf_t this is not thread safe. It doesn't depend on any type
+ * #define so, unlike the other buffers, it is only expanded once. Memory
+ * comes from the same allocator as the fifo buffers and honors
+ * RC_FIFOBUF_ALIGN, see buf_alloc.h.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_MSGBUF_H
+#define RC_MSGBUF_H
+
+#include <stdint.h>
+#include "buf_alloc.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifndef unlikely
+#define unlikely(x)	__builtin_expect (!!(x), 0)
+#endif
+
+#ifndef likely
+#define likely(x)	__builtin_expect (!!(x), 1)
+#endif
+
+#ifndef RC_FIFOBUF_ALIGN
+#define RC_FIFOBUF_ALIGN 0
+#endif
+
+// length header marking the rest of memory as padding
+#define RC_MSGBUF_PAD	0xFFFFFFFFu
+
+// bytes taken by a record of len bytes including its header
+#define RC_MSGBUF_RECORD_BYTES(len)	(4+(((len)+3)&~3))
+
+
+/**
+ * @brief      Struct containing state of a record fifo buffer and pointer to
+ * dynamically allocated memory.
+ */
+typedef struct rc_msgbuf_t {
+	uint8_t* d;	///< pointer to dynamically allocated data
+	int size;	///< number of bytes of memory, a multiple of 4
+	int head;	///< offset where the next record's header goes
+	int tail;	///< offset of the oldest record's header
+	int used;	///< bytes taken by records, headers and padding
+	int count;	///< number of records waiting to be read
+	int res_off;	///< offset of the reserved record's header
+	int res_len;	///< length reserved by rc_msgbuf_reserve, -1 if none
+	int initialized;///< flag indicating if memory has been allocated for the buffer
+	int user_mem;	///< flag indicating d was provided by the user and must not be freed
+} rc_msgbuf_t;
+
+
+#define RC_MSGBUF_INITIALIZER {\
+	.d = NULL,\
+	.size = 0,\
+	.head = 0,\
+	.tail = 0,\
+	.used = 0,\
+	.count = 0,\
+	.res_off = 0,\
+	.res_len = -1,\
+	.initialized = 0,\
+	.user_mem = 0}
+
+/**
+ * Declares a static record buffer called name of n bytes along with its
+ * storage. Use at file scope.
+ */
+#define RC_MSGBUF_DECLARE_STATIC(name, n)\
+	static uint32_t name##_storage[((n)+3)/4];\
+	static rc_msgbuf_t name = {\
+		.d = (uint8_t*)name##_storage,\
+		.size = (((n)+3)/4)*4,\
+		.res_len = -1,\
+		.initialized = 1,\
+		.user_mem = 1}
+
+
+static inline uint32_t __rc_msgbuf_header(rc_msgbuf_t* buf, int off)
+{
+	uint32_t h;
+	memcpy(&h, &buf->d[off], 4);
+	return h;
+}
+
+static inline void __rc_msgbuf_set_header(rc_msgbuf_t* buf, int off, uint32_t h)
+{
+	memcpy(&buf->d[off], &h, 4);
+}
+
+// offset where a record of len bytes would go, or -1 if there is no room
+static inline int __rc_msgbuf_place(rc_msgbuf_t* buf, int len)
+{
+	int need = RC_MSGBUF_RECORD_BYTES(len);
+	int space = buf->size - buf->used;
+	if(buf->head+need<=buf->size) return need<=space ? buf->head : -1;
+	// skip the space up to the end and start again at 0
+	return (buf->size-buf->head)+need<=space ? 0 : -1;
+}
+
+// steps tail over padding left at the end of memory
+static inline void __rc_msgbuf_skip_pad(rc_msgbuf_t* buf)
+{
+	if(buf->count && __rc_msgbuf_header(buf, buf->tail)==RC_MSGBUF_PAD){
+		buf->used -= buf->size-buf->tail;
+		buf->tail = 0;
+	}
+}
+
+/**
+ * @brief      Returns an rc_msgbuf_t struct which is completely zero'd out
+ * with no memory allocated for it.
+ *
+ * @return     empty and ready-to-allocate rc_msgbuf_t
+ */
+static inline rc_msgbuf_t rc_msgbuf_empty(void)
+{
+	rc_msgbuf_t out = RC_MSGBUF_INITIALIZER;
+	return out;
+}
+
+/**
+ * @brief      Allocates memory for a record buffer and initializes an
+ * rc_msgbuf_t struct.
+ *
+ * size is rounded up to a multiple of 4. The largest record that can ever fit
+ * is 4 bytes less than that. If buf is already the right size then it is left
+ * untouched. Otherwise any existing memory allocated for buf is freed.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  size  Number of bytes to allocate
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int rc_msgbuf_alloc(rc_msgbuf_t* buf, int size)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<8 || size>(1<<30))){
+		fprintf(stderr,"ERROR in rc_msgbuf_alloc, size must be >=8 and <=2^30\n");
+		return -1;
+	}
+	size = (size+3)&~3;
+	// if it's already allocated, nothing to do
+	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+	// make sure it's zero'd out
+	buf->size = 0;
+	buf->head = 0;
+	buf->tail = 0;
+	buf->used = 0;
+	buf->count = 0;
+	buf->res_len = -1;
+	buf->initialized = 0;
+	// free memory and allocate fresh
+	if(!buf->user_mem) free(buf->d);
+	buf->user_mem = 0;
+	buf->d = (uint8_t*)__rc_buf_alloc(size, 1, RC_FIFOBUF_ALIGN);
+	if(buf->d==NULL){
+		fprintf(stderr,"ERROR in rc_msgbuf_alloc, failed to allocate memory\n");
+		return -1;
+	}
+	// write out other details
+	buf->size = size;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Frees the memory allocated for buffer buf.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int rc_msgbuf_free(rc_msgbuf_t* buf)
+{
+	rc_msgbuf_t fresh = RC_MSGBUF_INITIALIZER;
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_msgbuf_free, received NULL pointer\n");
+		return -1;
+	}
+	if(buf->initialized && !buf->user_mem) free(buf->d);
+	*buf = fresh;
+	return 0;
+}
+
+/**
+ * @brief      Initializes a record buffer to use memory provided by the user
+ * instead of allocating it.
+ *
+ * storage must be 4 byte aligned and is never freed by rc_msgbuf_free or
+ * rc_msgbuf_alloc. Only a multiple of 4 bytes of it is used.
+ *
+ * @param      buf      Pointer to user's buffer
+ * @param      storage  memory for the buffer's contents
+ * @param[in]  size     Number of bytes of storage
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int rc_msgbuf_init_static(rc_msgbuf_t* buf, void* storage, int size)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || storage==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_init_static, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<8 || size>(1<<30))){
+		fprintf(stderr,"ERROR in rc_msgbuf_init_static, size must be >=8 and <=2^30\n");
+		return -1;
+	}
+	if(unlikely((uintptr_t)storage & 3)){
+		fprintf(stderr,"ERROR in rc_msgbuf_init_static, storage must be 4 byte aligned\n");
+		return -1;
+	}
+	// release anything allocated previously
+	if(buf->initialized && !buf->user_mem && (void*)buf->d!=storage) free(buf->d);
+	buf->d = (uint8_t*)storage;
+	buf->size = size&~3;
+	buf->head = 0;
+	buf->tail = 0;
+	buf->used = 0;
+	buf->count = 0;
+	buf->res_len = -1;
+	buf->user_mem = 1;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Discards all records. O(1), the memory is not wiped.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int rc_msgbuf_reset(rc_msgbuf_t* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_msgbuf_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_msgbuf_reset, msgbuf uninitialized\n");
+		return -1;
+	}
+	buf->head = 0;
+	buf->tail = 0;
+	buf->used = 0;
+	buf->count = 0;
+	buf->res_len = -1;
+	return 0;
+}
+
+/**
+ * @brief      Returns the number of records waiting to be read.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     number of records, or -1 on error.
+ */
+static inline int rc_msgbuf_available(rc_msgbuf_t* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_msgbuf_available, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_msgbuf_available, msgbuf uninitialized\n");
+		return -1;
+	}
+	return buf->count;
+}
+
+/**
+ * @brief      Returns the number of bytes of memory in use, including the
+ * length headers, alignment and any padding at the end of memory.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     bytes used, or -1 on error.
+ */
+static inline int rc_msgbuf_used(rc_msgbuf_t* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_msgbuf_used, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_msgbuf_used, msgbuf uninitialized\n");
+		return -1;
+	}
+	return buf->used;
+}
+
+/**
+ * @brief      Reserves contiguous space for a record of up to len bytes to be
+ * written directly into the buffer's memory.
+ *
+ * Nothing is pushed until rc_msgbuf_commit is called. Calling reserve again
+ * before committing replaces the reservation, and no other record may be
+ * pushed in between. Fails silently if there is no room right now.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  len   maximum length of the record in bytes
+ * @param[out] ptr   set to where the record's bytes go
+ *
+ * @return     Returns 0 on success or -1 on failure or if full.
+ */
+static inline int rc_msgbuf_reserve(rc_msgbuf_t* buf, int len, void** ptr)
+{
+	int off;
+	// sanity checks
+	if(unlikely(buf==NULL || ptr==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_reserve, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_msgbuf_reserve, msgbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(len<0 || len>buf->size-4)){
+		fprintf(stderr,"ERROR in rc_msgbuf_reserve, record can never fit in buffer\n");
+		return -1;
+	}
+	off = __rc_msgbuf_place(buf, len);
+	if(off<0) return -1;
+	buf->res_off = off;
+	buf->res_len = len;
+	*ptr = &buf->d[off+4];
+	return 0;
+}
+
+/**
+ * @brief      Publishes a record of len bytes previously written into space
+ * returned by rc_msgbuf_reserve.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  len   length of the record, may be less than was reserved
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int rc_msgbuf_commit(rc_msgbuf_t* buf, int len)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_commit, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_msgbuf_commit, msgbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(len<0 || len>buf->res_len)){
+		fprintf(stderr,"ERROR in rc_msgbuf_commit, len larger than reserved\n");
+		return -1;
+	}
+	// the record went back at the start, pad out the end of memory
+	if(buf->res_off!=buf->head){
+		__rc_msgbuf_set_header(buf, buf->head, RC_MSGBUF_PAD);
+		buf->used += buf->size-buf->head;
+	}
+	__rc_msgbuf_set_header(buf, buf->res_off, (uint32_t)len);
+	buf->head = buf->res_off+RC_MSGBUF_RECORD_BYTES(len);
+	if(buf->head>=buf->size) buf->head = 0;
+	buf->used += RC_MSGBUF_RECORD_BYTES(len);
+	buf->count++;
+	buf->res_len = -1;
+	return 0;
+}
+
+/**
+ * @brief      Copies a record of len bytes into the buffer.
+ *
+ * Fails silently if there is no room right now, as the user may run into this
+ * as an intentional check for the buffer being full.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  data  the record's bytes
+ * @param[in]  len   length of the record, up to the buffer size minus 4
+ *
+ * @return     Returns 0 on success or -1 on failure or if full.
+ */
+static inline int rc_msgbuf_push(rc_msgbuf_t* buf, const void* data, int len)
+{
+	void* ptr;
+	if(unlikely(data==NULL && len>0)){
+		fprintf(stderr,"ERROR in rc_msgbuf_push, received NULL pointer\n");
+		return -1;
+	}
+	if(rc_msgbuf_reserve(buf, len, &ptr)) return -1;
+	if(len) memcpy(ptr, data, len);
+	return rc_msgbuf_commit(buf, len);
+}
+
+/**
+ * @brief      Returns the oldest record in place without removing it from the
+ * buffer.
+ *
+ * The record is always one contiguous run of bytes. It stays valid, and can't
+ * be overwritten by a push, until the caller calls rc_msgbuf_release.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] ptr   set to point at the record's bytes
+ *
+ * @return     Returns the length of the record or -1 on failure or if empty.
+ */
+static inline int rc_msgbuf_peek(rc_msgbuf_t* buf, const void** ptr)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || ptr==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_peek, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_msgbuf_peek, msgbuf uninitialized\n");
+		return -1;
+	}
+	if(buf->count==0) return -1;
+	__rc_msgbuf_skip_pad(buf);
+	*ptr = &buf->d[buf->tail+4];
+	return (int)__rc_msgbuf_header(buf, buf->tail);
+}
+
+/**
+ * @brief      Removes the oldest record, typically after reading it in place
+ * with rc_msgbuf_peek.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure or if empty.
+ */
+static inline int rc_msgbuf_release(rc_msgbuf_t* buf)
+{
+	int bytes;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_msgbuf_release, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_msgbuf_release, msgbuf uninitialized\n");
+		return -1;
+	}
+	if(buf->count==0) return -1;
+	__rc_msgbuf_skip_pad(buf);
+	bytes = RC_MSGBUF_RECORD_BYTES((int)__rc_msgbuf_header(buf, buf->tail));
+	buf->tail += bytes;
+	if(buf->tail>=buf->size) buf->tail = 0;
+	buf->used -= bytes;
+	buf->count--;
+	// start over from the beginning for the most contiguous room, unless
+	// the caller is in the middle of writing a reserved record
+	if(buf->count==0 && buf->res_len<0){
+		buf->head = 0;
+		buf->tail = 0;
+		buf->used = 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Copies the oldest record out of the buffer and removes it.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] dst   where to copy the record's bytes
+ * @param[in]  max   size of dst, the record is left in the buffer if it is
+ * longer than this
+ *
+ * @return     Returns the length of the record or -1 on failure or if empty.
+ */
+static inline int rc_msgbuf_pop(rc_msgbuf_t* buf, void* dst, int max)
+{
+	const void* ptr;
+	int len;
+	if(unlikely(dst==NULL && max>0)){
+		fprintf(stderr,"ERROR in rc_msgbuf_pop, received NULL pointer\n");
+		return -1;
+	}
+	len = rc_msgbuf_peek(buf, &ptr);
+	if(len<0) return -1;
+	if(unlikely(len>max)){
+		fprintf(stderr,"ERROR in rc_msgbuf_pop, record longer than max\n");
+		return -1;
+	}
+	if(len) memcpy(dst, ptr, len);
+	rc_msgbuf_release(buf);
+	return len;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_MSGBUF_H
@@ -0,0 +1,381 @@
+/**
+ * "rc_buf.hpp"
+ *
+ * @brief      C++20 ring and fifo buffers with compile time capacity
+ *
+ * rc::ring_buf<T, N> and rc::fifo_buf<T, N> behave like the buffers in
+ * ring_buf.h and fifo_buf.h, but as templates any number of element types
+ * can be used in one translation unit and the capacity N is a constant. The
+ * N elements of storage live inside the object, so there is no heap, and the
+ * wraparound arithmetic folds to a mask when N is a power of two.
+ *
+ * Elements are constructed in place with placement new when they are
+ * inserted and destroyed when they leave, never assigned over, so move-only
+ * and non-trivial types work and nothing is default constructed up front.
+ * Unlike rc_ringbuf_t a new ring_buf is empty rather than full of zeros, only
+ * the count() most recent values may be read.
+ *
+ * Both have random access iterators running oldest to newest, and
+ * segments() returns the contents as two std::span views, the part up to
+ * the end of storage and the part wrapped around to the start, for bulk
+ * copies or SIMD loops without per-element wrap checks.
+ *
+ * Neither is thread safe, same as their C counterparts.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_BUF_HPP
+#define RC_BUF_HPP
+
+#include <array>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace rc {
+
+namespace detail {
+
+// i+N-1 at most, so one subtraction covers the wrap otherwise
+template<std::size_t N>
+constexpr std::size_t wrap(std::size_t i) noexcept
+{
+	if constexpr ((N & (N-1)) == 0) return i & (N-1);
+	else return i>=N ? i-N : i;
+}
+
+template<class Buf, class V>
+class circ_iter {
+public:
+	using iterator_concept = std::random_access_iterator_tag;
+	using iterator_category = std::random_access_iterator_tag;
+	using value_type = std::remove_cv_t<V>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = V*;
+	using reference = V&;
+
+	circ_iter() = default;
+	circ_iter(Buf* b, std::size_t i) noexcept : b_(b), i_(i) {}
+	// iterator to const_iterator
+	template<class B2, class V2> requires std::is_convertible_v<V2*, V*>
+	circ_iter(const circ_iter<B2, V2>& o) noexcept : b_(o.b_), i_(o.i_) {}
+
+	reference operator*() const noexcept { return b_->logical(i_); }
+	pointer operator->() const noexcept { return &b_->logical(i_); }
+	reference operator[](difference_type n) const noexcept { return b_->logical(i_+n); }
+
+	circ_iter& operator++() noexcept { ++i_; return *this; }
+	circ_iter operator++(int) noexcept { circ_iter t = *this; ++i_; return t; }
+	circ_iter& operator--() noexcept { --i_; return *this; }
+	circ_iter operator--(int) noexcept { circ_iter t = *this; --i_; return t; }
+	circ_iter& operator+=(difference_type n) noexcept { i_ += n; return *this; }
+	circ_iter& operator-=(difference_type n) noexcept { i_ -= n; return *this; }
+	friend circ_iter operator+(circ_iter it, difference_type n) noexcept { return it += n; }
+	friend circ_iter operator+(difference_type n, circ_iter it) noexcept { return it += n; }
+	friend circ_iter operator-(circ_iter it, difference_type n) noexcept { return it -= n; }
+	friend difference_type operator-(const circ_iter& a, const circ_iter& b) noexcept
+	{
+		return (difference_type)a.i_ - (difference_type)b.i_;
+	}
+
+	bool operator==(const circ_iter& o) const noexcept { return i_==o.i_; }
+	std::strong_ordering operator<=>(const circ_iter& o) const noexcept { return i_<=>o.i_; }
+
+private:
+	template<class, class> friend class circ_iter;
+	Buf* b_ = nullptr;
+	std::size_t i_ = 0;	// steps forward from the oldest element
+};
+
+/**
+ * Storage and bookkeeping shared by ring_buf and fifo_buf, N slots of which
+ * the count_ before head_ hold live elements.
+ */
+template<class T, std::size_t N>
+class circular {
+	static_assert(N>=1, "capacity must be at least 1");
+
+public:
+	using value_type = T;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using reference = T&;
+	using const_reference = const T&;
+	using iterator = circ_iter<circular, T>;
+	using const_iterator = circ_iter<const circular, const T>;
+
+	circular() noexcept = default;
+	circular(const circular& o) requires std::is_copy_constructible_v<T>
+	{
+		for(const T& v : o) push_back(v);
+	}
+	circular(circular&& o) noexcept(std::is_nothrow_move_constructible_v<T>)
+	{
+		for(T& v : o) push_back(std::move(v));
+		o.clear();
+	}
+	circular& operator=(const circular& o) requires std::is_copy_constructible_v<T>
+	{
+		if(this!=&o){
+			clear();
+			for(const T& v : o) push_back(v);
+		}
+		return *this;
+	}
+	circular& operator=(circular&& o) noexcept(std::is_nothrow_move_constructible_v<T>)
+	{
+		if(this!=&o){
+			clear();
+			for(T& v : o) push_back(std::move(v));
+			o.clear();
+		}
+		return *this;
+	}
+	~circular() { clear(); }
+
+	/// number of elements the buffer can hold
+	static constexpr size_type capacity() noexcept { return N; }
+	/// number of elements in the buffer
+	size_type size() const noexcept { return count_; }
+	bool empty() const noexcept { return count_==0; }
+	bool full() const noexcept { return count_==N; }
+
+	iterator begin() noexcept { return iterator(this, 0); }
+	iterator end() noexcept { return iterator(this, count_); }
+	const_iterator begin() const noexcept { return const_iterator(this, 0); }
+	const_iterator end() const noexcept { return const_iterator(this, count_); }
+	const_iterator cbegin() const noexcept { return begin(); }
+	const_iterator cend() const noexcept { return end(); }
+
+	/**
+	 * The contents oldest first as up to two contiguous views. The second
+	 * is empty unless the contents wrap around the end of storage.
+	 */
+	std::array<std::span<T>, 2> segments() noexcept
+	{
+		size_type s = start();
+		size_type first = count_<N-s ? count_ : N-s;
+		return {std::span<T>(span_at(s, first), first),
+			std::span<T>(span_at(0, count_-first), count_-first)};
+	}
+	std::array<std::span<const T>, 2> segments() const noexcept
+	{
+		size_type s = start();
+		size_type first = count_<N-s ? count_ : N-s;
+		return {std::span<const T>(span_at(s, first), first),
+			std::span<const T>(span_at(0, count_-first), count_-first)};
+	}
+
+	/// destroys all elements, O(1) for trivially destructible T
+	void clear() noexcept
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>){
+			while(count_) pop_front();
+		}
+		head_ = 0;
+		count_ = 0;
+	}
+
+protected:
+	template<class, class> friend class circ_iter;
+
+	// the storage of slot i, for constructing an element in it
+	T* storage(size_type i) noexcept { return reinterpret_cast<T*>(raw_ + i*sizeof(T)); }
+	const T* storage(size_type i) const noexcept { return reinterpret_cast<const T*>(raw_ + i*sizeof(T)); }
+	// the live element in slot i, only call this on slots holding one
+	T* slot(size_type i) noexcept { return std::launder(storage(i)); }
+	const T* slot(size_type i) const noexcept { return std::launder(storage(i)); }
+	// start of a span of n elements from slot i, which may be empty
+	T* span_at(size_type i, size_type n) noexcept { return n ? slot(i) : storage(i); }
+	const T* span_at(size_type i, size_type n) const noexcept { return n ? slot(i) : storage(i); }
+	// index of the oldest element
+	size_type start() const noexcept { return wrap<N>(head_+N-count_); }
+	// i steps forward from the oldest
+	T& logical(size_type i) noexcept { return *slot(wrap<N>(head_+N-count_+i)); }
+	const T& logical(size_type i) const noexcept { return *slot(wrap<N>(head_+N-count_+i)); }
+	// position steps back from the newest
+	T& back_at(size_type position) noexcept { return *slot(wrap<N>(head_+N-1-position)); }
+	const T& back_at(size_type position) const noexcept { return *slot(wrap<N>(head_+N-1-position)); }
+
+	// caller makes sure there is room
+	template<class... Args>
+	T& emplace_back(Args&&... args)
+	{
+		T* p = std::construct_at(storage(head_), std::forward<Args>(args)...);
+		head_ = wrap<N>(head_+1);
+		count_++;
+		return *p;
+	}
+	T& push_back(const T& v) { return emplace_back(v); }
+	T& push_back(T&& v) { return emplace_back(std::move(v)); }
+
+	// caller makes sure it is full. args may refer to the oldest element,
+	// so the new one is built aside before that is destroyed and then moved
+	// into place
+	template<class... Args>
+	T& emplace_over(Args&&... args)
+	{
+		T v(std::forward<Args>(args)...);
+		pop_front();
+		return emplace_back(std::move(v));
+	}
+
+	// caller makes sure it isn't empty
+	void pop_front() noexcept
+	{
+		std::destroy_at(slot(start()));
+		count_--;
+	}
+
+	alignas(T) std::byte raw_[N*sizeof(T)];
+	size_type head_ = 0;	// slot the next element goes in
+	size_type count_ = 0;
+};
+
+} // namespace detail
+
+
+/**
+ * @brief      Ring buffer of the N most recent values, see ring_buf.h.
+ *
+ * insert always succeeds and boots out the oldest value when full. Values are
+ * read back by position, 0 being the most recent, or oldest first through
+ * the iterators.
+ */
+template<class T, std::size_t N>
+class ring_buf : public detail::circular<T, N> {
+	using base = detail::circular<T, N>;
+
+public:
+	using typename base::size_type;
+
+	/// number of values inserted since construction or reset, up to N
+	size_type count() const noexcept { return this->count_; }
+
+	/// constructs a new value in place, destroying the oldest if full
+	template<class... Args>
+	T& emplace(Args&&... args)
+	{
+		if(this->full()) return this->emplace_over(std::forward<Args>(args)...);
+		return this->emplace_back(std::forward<Args>(args)...);
+	}
+	void insert(const T& v) { emplace(v); }
+	void insert(T&& v) { emplace(std::move(v)); }
+
+	/// puts n values in order, src[n-1] ends up most recent
+	void insert_n(const T* src, size_type n)
+	{
+		if(n>N){
+			src += n-N;
+			n = N;
+		}
+		for(size_type i=0;i<n;i++) emplace(src[i]);
+	}
+
+	/// value position steps behind the newest, position < count()
+	T& operator[](size_type position) noexcept { return this->back_at(position); }
+	const T& operator[](size_type position) const noexcept { return this->back_at(position); }
+
+	/// checked version of operator[]
+	T& get_value(size_type position)
+	{
+		if(position>=this->count_) throw std::out_of_range("rc::ring_buf::get_value");
+		return this->back_at(position);
+	}
+	const T& get_value(size_type position) const
+	{
+		if(position>=this->count_) throw std::out_of_range("rc::ring_buf::get_value");
+		return this->back_at(position);
+	}
+
+	T& newest() noexcept { return this->back_at(0); }
+	const T& newest() const noexcept { return this->back_at(0); }
+	T& oldest() noexcept { return this->logical(0); }
+	const T& oldest() const noexcept { return this->logical(0); }
+
+	void reset() noexcept { this->clear(); }
+};
+
+
+/**
+ * @brief      Fifo buffer of up to N entries, see fifo_buf.h.
+ *
+ * push fails when full unless overwrite mode is on, in which case the oldest
+ * entry is dropped to make room. Entries are read oldest first with pop, or
+ * in place with front, the iterators or segments followed by release.
+ */
+template<class T, std::size_t N>
+class fifo_buf : public detail::circular<T, N> {
+	using base = detail::circular<T, N>;
+
+public:
+	using typename base::size_type;
+
+	/// number of entries waiting to be read
+	size_type available() const noexcept { return this->count_; }
+
+	/// constructs a new entry in place, returns false if full
+	template<class... Args>
+	bool emplace(Args&&... args)
+	{
+		if(this->full()){
+			if(!overwrite_) return false;
+			this->emplace_over(std::forward<Args>(args)...);
+			dropped_++;
+			return true;
+		}
+		this->emplace_back(std::forward<Args>(args)...);
+		return true;
+	}
+	bool push(const T& v) { return emplace(v); }
+	bool push(T&& v) { return emplace(std::move(v)); }
+
+	/// moves the oldest entry into out, returns false if empty
+	bool pop(T& out) noexcept(std::is_nothrow_move_assignable_v<T>)
+	{
+		if(this->empty()) return false;
+		out = std::move(this->logical(0));
+		this->pop_front();
+		return true;
+	}
+
+	/// oldest entry, only valid when not empty
+	T& front() noexcept { return this->logical(0); }
+	const T& front() const noexcept { return this->logical(0); }
+
+	/// destroys the n oldest entries, typically after reading them in place
+	void release(size_type n) noexcept
+	{
+		if(n>this->count_) n = this->count_;
+		if constexpr (std::is_trivially_destructible_v<T>) this->count_ -= n;
+		else while(n--) this->pop_front();
+	}
+
+	/// with enable true push drops the oldest entry instead of failing
+	void set_overwrite(bool enable) noexcept { overwrite_ = enable; }
+	/// number of entries dropped by pushes in overwrite mode
+	unsigned long dropped() const noexcept { return dropped_; }
+
+	void reset() noexcept
+	{
+		this->clear();
+		dropped_ = 0;
+	}
+
+private:
+	bool overwrite_ = false;
+	unsigned long dropped_ = 0;
+};
+
+} // namespace rc
+
+#endif // RC_BUF_HPP
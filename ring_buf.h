@@ -10,6 +10,75 @@
  * The user creates their own instance of a buffer and passes a pointer to the
  * these functions to perform normal operations.
  *
+ * All functions are static inline so this header may be included from as
+ * many .c files as needed. To use more than one RINGBUF_TYPE in a program
+ * also #define RINGBUF_NAME before each include. The buffer type and
+ * functions then take that name, e.g. with RINGBUF_NAME f32 the type is
+ * rc_ringbuf_f32_t and the functions are rc_ringbuf_f32_insert etc. Without
+ * RINGBUF_NAME they keep the plain rc_ringbuf_t and rc_ringbuf_* names.
+ * #undef RINGBUF_TYPE and RINGBUF_NAME before including the header again:
+ *
+ * #define RINGBUF_TYPE float
+ * #define RINGBUF_NAME f32
+ * #include "ring_buf.h"
+ * #undef RINGBUF_TYPE
+ * #undef RINGBUF_NAME
+ * #define RINGBUF_TYPE int16_t
+ * #define RINGBUF_NAME i16
+ * #include "ring_buf.h"
+ *
+ * If the user #defines RC_RINGBUF_MIRROR before including this header then
+ * the buffer keeps two copies of its contents back to back in memory, 2*size
+ * elements long, and every insert writes both. In exchange the last size
+ * values are always available as one contiguous array through
+ * rc_ringbuf_window so filters can run a straight loop over them with no
+ * wraparound logic.
+ *
+ * If RINGBUF_TYPE is float or double the user may also #define
+ * RC_RINGBUF_FLOAT or RC_RINGBUF_DOUBLE respectively to enable rc_ringbuf_dot,
+ * a dot product of the most recent values against an array of coefficients
+ * which uses AVX, SSE or NEON when the compiler targets them, or plain C with
+ * RC_RINGBUF_NO_SIMD. Like RINGBUF_NAME these stay defined for any later
+ * instantiation, so #undef them along with RINGBUF_TYPE before including the
+ * header again for another type. A mismatch with RINGBUF_TYPE is a compile
+ * error.
+ *
+ * Instead of rc_ringbuf_alloc a buffer may be given memory of the user's
+ * choosing, such as a static array, a pool or shared memory, with
+ * rc_ringbuf_init_static. RC_RINGBUF_DECLARE_STATIC declares a buffer and its
+ * storage at file scope so it lives in .bss and needs no allocator at all.
+ *
+ * If RINGBUF_TYPE is a plain number type the user may #define
+ * RC_RINGBUF_STATS to keep running statistics of the whole buffer up to date
+ * on every insert. rc_ringbuf_sum, rc_ringbuf_mean and rc_ringbuf_variance
+ * read a sliding sum and sum of squares kept with compensated (Neumaier)
+ * summation in double precision so they don't drift, and rc_ringbuf_min and
+ * rc_ringbuf_max read monotonic deques of the buffer's values. All of these
+ * are O(1), insert becomes O(1) amortized. The deques need their own memory
+ * so rc_ringbuf_init_static and the static initializers are not available in
+ * this mode.
+ *
+ * Similarly #define RC_RINGBUF_MEDIAN for a sliding median filter.
+ * rc_ringbuf_median and rc_ringbuf_percentile read an indexable skiplist of
+ * the whole buffer kept sorted as values come and go, so reads and inserts
+ * are O(log N) instead of sorting a copy of the window every cycle. Values
+ * must compare with < and ==, so no NaNs. This mode has the same memory
+ * requirements as RC_RINGBUF_STATS and may be combined with it.
+ *
+ * The buffer also counts how many values have been inserted since it was
+ * allocated or reset, saturating at size, so filters can tell real samples
+ * from the startup history with rc_ringbuf_count. Positions at or beyond the
+ * count hold zeros after alloc or stale values after a reset.
+ *
+ * #define RC_RINGBUF_ALIGN to a power of two such as 64 or 128 before including
+ * to have rc_ringbuf_alloc start the data on that boundary, or to
+ * RC_BUF_HUGEPAGE for big buffers to back them with huge pages where the
+ * system allows it, see buf_alloc.h.
+ *
+ * With RC_BUF_COUNTERS defined the buffer also counts every value inserted,
+ * and rc_ringbuf_counters reports that along with how many were overwritten,
+ * see buf_counters.h.
+ *
  * @author     James Strawson
  * @date       2019
  *
@@ -20,6 +89,22 @@
 #error "ERROR user must #define RINGBUF_TYPE before including ring_buf.h"
 #endif
 
+#include <sys/mman.h>
+#include "buf_alloc.h"
+#include "buf_counters.h"
+
+#if defined(RC_RINGBUF_FLOAT) && defined(RC_RINGBUF_DOUBLE)
+#error "ERROR only one of RC_RINGBUF_FLOAT and RC_RINGBUF_DOUBLE may be defined"
+#endif
+
+#if (defined(RC_RINGBUF_FLOAT) || defined(RC_RINGBUF_DOUBLE)) && !defined(RC_RINGBUF_NO_SIMD)
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#endif
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -32,24 +117,319 @@ extern "C" {
 #define likely(x)	__builtin_expect (!!(x), 1)
 #endif
 
+// alignment of the memory from rc_ringbuf_alloc in bytes, 0 for malloc's
+#ifndef RC_RINGBUF_ALIGN
+#define RC_RINGBUF_ALIGN 0
+#endif
+
+// name mangling for this instantiation, these stay defined until the header
+// is included again and always refer to the most recent RINGBUF_TYPE
+#define __RC_RINGBUF_CAT_(a,b,c)	a##b##c
+#define __RC_RINGBUF_CAT(a,b,c)	__RC_RINGBUF_CAT_(a,b,c)
+#undef RC_RINGBUF_T
+#undef RC_RINGBUF_FN
+#undef RC_RINGBUF_PRIV
+#ifdef RINGBUF_NAME
+#define RC_RINGBUF_T		__RC_RINGBUF_CAT(rc_ringbuf_, RINGBUF_NAME, _t)
+#define RC_RINGBUF_FN(f)	__RC_RINGBUF_CAT(rc_ringbuf_, RINGBUF_NAME, _##f)
+#define RC_RINGBUF_PRIV(f)	__RC_RINGBUF_CAT(__rc_ringbuf_, RINGBUF_NAME, _##f)
+#else
+#define RC_RINGBUF_T		rc_ringbuf_t
+#define RC_RINGBUF_FN(f)	rc_ringbuf_##f
+#define RC_RINGBUF_PRIV(f)	__rc_ringbuf_##f
+#endif
+
 
 /**
  * @brief      Struct containing state of a ringbuffer and pointer to
  * dynamically allocated memory.
  */
-typedef struct rc_ringbuf_t {
-	RINGBUF_TYPE* d;	///< pointer to dynamically allocated data
+typedef struct RC_RINGBUF_T {
+	RINGBUF_TYPE* d;	///< pointer to dynamically allocated data, 2*size long with RC_RINGBUF_MIRROR
 	int size;	///< number of elements the buffer can hold
 	int index;	///< index of the most recently added value
+	int count;	///< number of values inserted since alloc or reset, saturates at size
 	int initialized;///< flag indicating if memory has been allocated for the buffer
-} rc_ringbuf_t;
+	int user_mem;	///< flag indicating d was provided by the user and must not be freed
+#ifdef RC_RINGBUF_STATS
+	double sum;	///< sum of the values in the buffer
+	double sum_c;	///< running compensation for lost low-order bits of sum
+	double sumsq;	///< sum of the squares of the values in the buffer
+	double sumsq_c;	///< running compensation for lost low-order bits of sumsq
+	int* minq;	///< deque of indices into d with increasing values, oldest first
+	int* maxq;	///< deque of indices into d with decreasing values, oldest first
+	int min_head;	///< position of the front of minq
+	int min_len;	///< number of entries in minq
+	int max_head;	///< position of the front of maxq
+	int max_len;	///< number of entries in maxq
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	int* sl_next;	///< skiplist links, sl_levels per node, node size is the head
+	int* sl_width;	///< number of values each link in sl_next steps over
+	int* sl_height;	///< number of levels each node is linked into
+	int sl_levels;	///< number of levels of the head node
+#endif
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters;	///< instrumentation, see buf_counters.h
+#endif
+} RC_RINGBUF_T;
 
 
 #define RC_RINGBUF_INITIALIZER {\
 	.d = NULL,\
 	.size = 0,\
 	.index = 0,\
-	.initialized = 0}
+	.count = 0,\
+	.initialized = 0,\
+	.user_mem = 0}
+
+/**
+ * Number of RINGBUF_TYPE elements of storage needed for a buffer of size n,
+ * for use with rc_ringbuf_init_static. Refers to the most recent
+ * instantiation.
+ */
+#undef RC_RINGBUF_STORAGE_LEN
+#ifdef RC_RINGBUF_MIRROR
+#define RC_RINGBUF_STORAGE_LEN(n)	(2*(n))
+#else
+#define RC_RINGBUF_STORAGE_LEN(n)	(n)
+#endif
+
+/**
+ * Initializer for a buffer using the user's own storage array, which must be
+ * at least RC_RINGBUF_STORAGE_LEN(n) elements long and zero'd out, e.g.
+ *
+ * static float hist_mem[RC_RINGBUF_STORAGE_LEN(256)];
+ * static rc_ringbuf_f32_t hist = RC_RINGBUF_STATIC_INITIALIZER(hist_mem, 256);
+ */
+#undef RC_RINGBUF_STATIC_INITIALIZER
+#undef RC_RINGBUF_DECLARE_STATIC
+#if !defined(RC_RINGBUF_STATS) && !defined(RC_RINGBUF_MEDIAN)
+#define RC_RINGBUF_STATIC_INITIALIZER(storage, n) {\
+	.d = (storage),\
+	.size = (n),\
+	.index = 0,\
+	.count = 0,\
+	.initialized = 1,\
+	.user_mem = 1}
+
+/**
+ * Declares a static buffer called name of size n along with its storage,
+ * using the current RINGBUF_TYPE. Use at file scope right after including
+ * the header.
+ */
+#define RC_RINGBUF_DECLARE_STATIC(name, n)\
+	static RINGBUF_TYPE name##_storage[RC_RINGBUF_STORAGE_LEN(n)];\
+	static RC_RINGBUF_T name = RC_RINGBUF_STATIC_INITIALIZER(name##_storage, n)
+#endif
+
+
+#ifdef RC_RINGBUF_STATS
+/*
+ * Bookkeeping for RC_RINGBUF_STATS. The buffer always holds size values,
+ * zeros until it has been filled, so after a reset the sums are 0 and each
+ * deque holds just the most recent zero at index 0. The deques store indices
+ * into d rather than values. Every index in them is a value still in the
+ * buffer, so the one about to be overwritten can only be at the front.
+ */
+static inline void RC_RINGBUF_PRIV(stats_clear)(RC_RINGBUF_T* buf)
+{
+	buf->sum = 0.0;
+	buf->sum_c = 0.0;
+	buf->sumsq = 0.0;
+	buf->sumsq_c = 0.0;
+	buf->minq[0] = 0;
+	buf->maxq[0] = 0;
+	buf->min_head = 0;
+	buf->min_len = 1;
+	buf->max_head = 0;
+	buf->max_len = 1;
+}
+
+// Neumaier's variant of Kahan summation, s += x with compensation c
+static inline void RC_RINGBUF_PRIV(stats_add)(double* s, double* c, double x)
+{
+	double t = *s + x;
+	if((*s>=0 ? *s : -*s) >= (x>=0 ? x : -x)) *c += (*s - t) + x;
+	else *c += (x - t) + *s;
+	*s = t;
+}
+
+// called by every insert before val is written to d[i], replacing d[i]
+static inline void RC_RINGBUF_PRIV(on_insert)(RC_RINGBUF_T* buf, int i, RINGBUF_TYPE val)
+{
+	double old = (double)buf->d[i];
+	double x = (double)val;
+	int back;
+
+	RC_RINGBUF_PRIV(stats_add)(&buf->sum, &buf->sum_c, x-old);
+	RC_RINGBUF_PRIV(stats_add)(&buf->sumsq, &buf->sumsq_c, x*x-old*old);
+
+	// evict the value being overwritten
+	if(buf->minq[buf->min_head]==i){
+		buf->min_head++;
+		if(buf->min_head>=buf->size) buf->min_head=0;
+		buf->min_len--;
+	}
+	if(buf->maxq[buf->max_head]==i){
+		buf->max_head++;
+		if(buf->max_head>=buf->size) buf->max_head=0;
+		buf->max_len--;
+	}
+	// older values which can never be the min/max again leave from the back
+	while(buf->min_len){
+		back = buf->min_head+buf->min_len-1;
+		if(back>=buf->size) back-=buf->size;
+		if(buf->d[buf->minq[back]]<val) break;
+		buf->min_len--;
+	}
+	back = buf->min_head+buf->min_len;
+	if(back>=buf->size) back-=buf->size;
+	buf->minq[back] = i;
+	buf->min_len++;
+	while(buf->max_len){
+		back = buf->max_head+buf->max_len-1;
+		if(back>=buf->size) back-=buf->size;
+		if(buf->d[buf->maxq[back]]>val) break;
+		buf->max_len--;
+	}
+	back = buf->max_head+buf->max_len;
+	if(back>=buf->size) back-=buf->size;
+	buf->maxq[back] = i;
+	buf->max_len++;
+}
+#endif
+
+#ifdef RC_RINGBUF_MEDIAN
+/*
+ * Bookkeeping for RC_RINGBUF_MEDIAN, an indexable skiplist with one node per
+ * slot of d kept in order of value, ties broken by slot so every node has a
+ * place of its own. Node size is the head and is linked into every level, -1
+ * ends a level. Each link also stores how many values it steps over, a link
+ * ending a level counting one more than the values left after it, so the k-th
+ * smallest value is found in O(log N) by adding up widths on the way down.
+ * The height of each node is drawn once at alloc so inserts need no random
+ * numbers. Like the statistics this covers the whole buffer, zeros until it
+ * has been filled.
+ */
+#ifndef RC_RINGBUF_MEDIAN_MAX_LEVELS
+#define RC_RINGBUF_MEDIAN_MAX_LEVELS 32
+#endif
+
+// order of the nodes, by value then by slot
+static inline int RC_RINGBUF_PRIV(median_before)(RC_RINGBUF_T* buf, int a, int b)
+{
+	return buf->d[a]<buf->d[b] || (buf->d[a]==buf->d[b] && a<b);
+}
+
+// unlinks node i, d[i] must still hold the value it was linked in with
+static inline void RC_RINGBUF_PRIV(median_unlink)(RC_RINGBUF_T* buf, int i)
+{
+	int l, n;
+	int cur = buf->size;
+	int levels = buf->sl_levels;
+	int* next = buf->sl_next;
+	int* width = buf->sl_width;
+
+	for(l=levels-1;l>=0;l--){
+		while((n=next[cur*levels+l])!=-1 && RC_RINGBUF_PRIV(median_before)(buf, n, i)) cur=n;
+		// levels i isn't linked into just step over one value less
+		if(n==i){
+			width[cur*levels+l] += width[i*levels+l]-1;
+			next[cur*levels+l] = next[i*levels+l];
+		}
+		else width[cur*levels+l]--;
+	}
+}
+
+// links node i in at the place of the value now in d[i]
+static inline void RC_RINGBUF_PRIV(median_link)(RC_RINGBUF_T* buf, int i)
+{
+	int l, n;
+	int cur = buf->size;
+	int pos = 0;	// values stepped over to reach cur
+	int levels = buf->sl_levels;
+	int height = buf->sl_height[i];
+	int* next = buf->sl_next;
+	int* width = buf->sl_width;
+	int prev[RC_RINGBUF_MEDIAN_MAX_LEVELS];
+	int prev_pos[RC_RINGBUF_MEDIAN_MAX_LEVELS];
+
+	for(l=levels-1;l>=0;l--){
+		while((n=next[cur*levels+l])!=-1 && RC_RINGBUF_PRIV(median_before)(buf, n, i)){
+			pos += width[cur*levels+l];
+			cur = n;
+		}
+		if(l>=height) width[cur*levels+l]++;
+		else{
+			prev[l] = cur;
+			prev_pos[l] = pos;
+		}
+	}
+	// node i ends up pos+1 steps from the head, split the links it lands in
+	for(l=0;l<height;l++){
+		cur = prev[l];
+		next[i*levels+l] = next[cur*levels+l];
+		next[cur*levels+l] = i;
+		width[i*levels+l] = width[cur*levels+l]-(pos-prev_pos[l]);
+		width[cur*levels+l] = pos-prev_pos[l]+1;
+	}
+}
+
+// empties the skiplist and links in every slot, d must be zero'd
+static inline void RC_RINGBUF_PRIV(median_clear)(RC_RINGBUF_T* buf)
+{
+	int i;
+	int head = buf->size*buf->sl_levels;
+	for(i=0;i<buf->sl_levels;i++){
+		buf->sl_next[head+i] = -1;
+		buf->sl_width[head+i] = 1;
+	}
+	for(i=0;i<buf->size;i++) RC_RINGBUF_PRIV(median_link)(buf, i);
+}
+
+// draws the node heights, each level holding about half the nodes of the one
+// below, from a fixed xorshift seed so runs are repeatable
+static inline void RC_RINGBUF_PRIV(median_heights)(RC_RINGBUF_T* buf)
+{
+	int i, h;
+	uint32_t x = 2463534242u;
+	for(i=0;i<buf->size;i++){
+		x ^= x<<13;
+		x ^= x>>17;
+		x ^= x<<5;
+		h = 1;
+		while(h<buf->sl_levels && ((x>>(h-1))&1)) h++;
+		buf->sl_height[i] = h;
+	}
+	buf->sl_height[buf->size] = buf->sl_levels;
+}
+
+// called by every insert before val is written to d[i], moves node i from
+// the place of the value being overwritten to the place of val
+static inline void RC_RINGBUF_PRIV(median_replace)(RC_RINGBUF_T* buf, int i, RINGBUF_TYPE val)
+{
+	RC_RINGBUF_PRIV(median_unlink)(buf, i);
+	buf->d[i] = val;
+	RC_RINGBUF_PRIV(median_link)(buf, i);
+}
+
+// node holding the k-th smallest value, k from 0 to size-1
+static inline int RC_RINGBUF_PRIV(median_select)(RC_RINGBUF_T* buf, int k)
+{
+	int l, n;
+	int cur = buf->size;
+	int levels = buf->sl_levels;
+	k++;	// steps from the head
+	for(l=levels-1;l>=0;l--){
+		while((n=buf->sl_next[cur*levels+l])!=-1 && buf->sl_width[cur*levels+l]<=k){
+			k -= buf->sl_width[cur*levels+l];
+			cur = n;
+		}
+	}
+	return cur;
+}
+#endif
 
 /**
  * @brief      Returns an rc_ringbuf_t struct which is completely zero'd out
@@ -62,9 +442,9 @@ typedef struct rc_ringbuf_t {
  *
  * @return     empty and ready-to-allocate rc_ringbuf_t
  */
-rc_ringbuf_t rc_ringbuf_empty(void)
+static inline RC_RINGBUF_T RC_RINGBUF_FN(empty)(void)
 {
-	rc_ringbuf_t out = RC_RINGBUF_INITIALIZER;
+	RC_RINGBUF_T out = RC_RINGBUF_INITIALIZER;
 	return out;
 }
 
@@ -74,15 +454,19 @@ rc_ringbuf_t rc_ringbuf_empty(void)
  *
  * If buf is already the right size then it is left untouched. Otherwise any
  * existing memory allocated for buf is freed to avoid memory leaks and new
- * memory is allocated.
+ * memory is allocated. Memory provided by the user is never freed.
  *
  * @param      buf   Pointer to user's buffer
  * @param[in]  size  Number of elements to allocate space for
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_ringbuf_alloc(rc_ringbuf_t* buf, int size)
+static inline int RC_RINGBUF_FN(alloc)(RC_RINGBUF_T* buf, int size)
 {
+	int len;
+#ifdef RC_RINGBUF_MEDIAN
+	int levels;
+#endif
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_alloc, received NULL pointer\n");
@@ -94,19 +478,66 @@ int rc_ringbuf_alloc(rc_ringbuf_t* buf, int size)
 	}
 	// if it's already allocated, nothing to do
 	if(buf->initialized && buf->size==size && buf->d!=NULL) return 0;
+	// room for the second copy of the contents with RC_RINGBUF_MIRROR
+	len = RC_RINGBUF_STORAGE_LEN(size);
 	// make sure it's zero'd out
 	buf->size = 0;
 	buf->index = 0;
+	buf->count = 0;
 	buf->initialized = 0;
+#ifdef RC_BUF_COUNTERS
+	memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
 	// free memory and allocate fresh
-	free(buf->d);
-	buf->d = (RINGBUF_TYPE*)calloc(size,sizeof(RINGBUF_TYPE));
+	if(!buf->user_mem) free(buf->d);
+	buf->user_mem = 0;
+	buf->d = (RINGBUF_TYPE*)__rc_buf_alloc(len,sizeof(RINGBUF_TYPE),RC_RINGBUF_ALIGN);
 	if(buf->d==NULL){
 		fprintf(stderr,"ERROR in rc_ringbuf_alloc, failed to allocate memory\n");
 		return -1;
 	}
+#ifdef RC_RINGBUF_STATS
+	// both deques share one block
+	free(buf->minq);
+	buf->minq = (int*)malloc(2*size*sizeof(int));
+	if(buf->minq==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_alloc, failed to allocate memory\n");
+		free(buf->d);
+		buf->d = NULL;
+		return -1;
+	}
+	buf->maxq = buf->minq+size;
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	// enough levels for about one node on the top one, the links, widths and
+	// heights of the size+1 nodes share one block
+	levels = 1;
+	while(levels<RC_RINGBUF_MEDIAN_MAX_LEVELS && (1u<<(levels-1))<(unsigned)size) levels++;
+	free(buf->sl_next);
+	buf->sl_next = (int*)malloc((2*(size_t)levels+1)*(size+1)*sizeof(int));
+	if(buf->sl_next==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_alloc, failed to allocate memory\n");
+		free(buf->d);
+		buf->d = NULL;
+#ifdef RC_RINGBUF_STATS
+		free(buf->minq);
+		buf->minq = NULL;
+#endif
+		return -1;
+	}
+	buf->sl_width = buf->sl_next+(size_t)levels*(size+1);
+	buf->sl_height = buf->sl_width+(size_t)levels*(size+1);
+	buf->sl_levels = levels;
+#endif
 	// write out other details
 	buf->size = size;
+#ifdef RC_RINGBUF_STATS
+	RC_RINGBUF_PRIV(stats_clear)(buf);
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	RC_RINGBUF_PRIV(median_heights)(buf);
+	RC_RINGBUF_PRIV(median_clear)(buf);
+#endif
 	buf->initialized = 1;
 	return 0;
 }
@@ -121,27 +552,124 @@ int rc_ringbuf_alloc(rc_ringbuf_t* buf, int size)
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_ringbuf_free(rc_ringbuf_t* buf)
+static inline int RC_RINGBUF_FN(free)(RC_RINGBUF_T* buf)
 {
-	rc_ringbuf_t new = RC_RINGBUF_INITIALIZER;
+	RC_RINGBUF_T new = RC_RINGBUF_INITIALIZER;
 	if(unlikely(buf==NULL)){
 		fprintf(stderr, "ERROR in rc_ringbuf_free, received NULL pointer\n");
 		return -1;
 	}
-	if(buf->initialized) free(buf->d);
+	if(buf->initialized && !buf->user_mem) free(buf->d);
+#ifdef RC_RINGBUF_STATS
+	free(buf->minq);
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	free(buf->sl_next);
+#endif
 	*buf = new;
 	return 0;
 }
 
 /**
- * @brief      Sets all values in the buffer to 0.0f and sets the buffer index
- * back to 0.
+ * @brief      Initializes a ring buffer to use memory provided by the user
+ * instead of allocating it.
+ *
+ * storage may be a static array, part of a pool or shared memory and must be
+ * at least RC_RINGBUF_STORAGE_LEN(size) elements long. It is zero'd out here
+ * and is never freed by rc_ringbuf_free or rc_ringbuf_alloc. Not available
+ * with RC_RINGBUF_STATS or RC_RINGBUF_MEDIAN and returns -1.
+ *
+ * @param      buf      Pointer to user's buffer
+ * @param      storage  memory for the buffer's contents
+ * @param[in]  size     Number of elements the buffer should hold
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(init_static)(RC_RINGBUF_T* buf, RINGBUF_TYPE* storage, int size)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || storage==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_init_static, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2)){
+		fprintf(stderr,"ERROR in rc_ringbuf_init_static, size must be >=2\n");
+		return -1;
+	}
+#ifdef RC_RINGBUF_STATS
+	fprintf(stderr,"ERROR in rc_ringbuf_init_static, not available with RC_RINGBUF_STATS\n");
+	return -1;
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	fprintf(stderr,"ERROR in rc_ringbuf_init_static, not available with RC_RINGBUF_MEDIAN\n");
+	return -1;
+#endif
+	// release anything allocated previously
+	if(buf->initialized && !buf->user_mem && buf->d!=storage) free(buf->d);
+	memset(storage,0,RC_RINGBUF_STORAGE_LEN(size)*sizeof(RINGBUF_TYPE));
+	buf->d = storage;
+	buf->size = size;
+	buf->index = 0;
+	buf->count = 0;
+#ifdef RC_BUF_COUNTERS
+	memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
+	buf->user_mem = 1;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Touches every page of the buffer's memory so it is resident
+ * before the first sample arrives, and optionally locks it in RAM.
+ *
+ * Call this at startup, not while the buffer is in use. Locking requires
+ * permission to mlock, e.g. CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  lock  nonzero to also mlock the memory
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(prefault)(RC_RINGBUF_T* buf, int lock)
+{
+	size_t i, bytes;
+	volatile char* p;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_prefault, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_prefault, ringbuf uninitialized\n");
+		return -1;
+	}
+	bytes = RC_RINGBUF_STORAGE_LEN((size_t)buf->size)*sizeof(RINGBUF_TYPE);
+	// write to each page so copy-on-write and zero pages get a real frame
+	p = (volatile char*)buf->d;
+	for(i=0;i<bytes;i+=4096) p[i] = p[i];
+	if(lock && mlock((const void*)buf->d, bytes)){
+		fprintf(stderr,"ERROR in rc_ringbuf_prefault, mlock failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Empties the buffer by setting the index and count back to 0.
+ *
+ * This is O(1), the old contents are left in memory and are only overwritten
+ * by subsequent inserts, so use rc_ringbuf_count to know how many positions
+ * hold values inserted since the reset. With RC_RINGBUF_STATS the running
+ * statistics cover the whole buffer and assume it starts out zero'd, so in
+ * that mode the data is still wiped. The same goes for the sorted order kept
+ * by RC_RINGBUF_MEDIAN, which is rebuilt in O(N log N).
  *
  * @param      buf   Pointer to user's buffer
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_ringbuf_reset(rc_ringbuf_t* buf)
+static inline int RC_RINGBUF_FN(reset)(RC_RINGBUF_T* buf)
 {
 	// sanity checks
 	if(unlikely(buf==NULL)){
@@ -152,12 +680,52 @@ int rc_ringbuf_reset(rc_ringbuf_t* buf)
 		fprintf(stderr,"ERROR rc_ringbuf_reset, ringbuf uninitialized\n");
 		return -1;
 	}
-	// wipe the data and index
-	memset(buf->d,0,buf->size*sizeof(RINGBUF_TYPE));
 	buf->index=0;
+	buf->count=0;
+#ifdef RC_BUF_COUNTERS
+	memset(&buf->counters, 0, sizeof(buf->counters));
+#endif
+#ifdef RC_RINGBUF_STATS
+	memset(buf->d,0,RC_RINGBUF_STORAGE_LEN(buf->size)*sizeof(RINGBUF_TYPE));
+	RC_RINGBUF_PRIV(stats_clear)(buf);
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	memset(buf->d,0,RC_RINGBUF_STORAGE_LEN(buf->size)*sizeof(RINGBUF_TYPE));
+	RC_RINGBUF_PRIV(median_clear)(buf);
+#endif
 	return 0;
 }
 
+/**
+ * @brief      Same as rc_ringbuf_insert but without any sanity checks.
+ *
+ * For inner loops where the caller already knows buf is valid and
+ * allocated. Compiles down to a few instructions with no calls.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be inserted
+ */
+static inline void RC_RINGBUF_FN(insert_unchecked)(RC_RINGBUF_T* buf, RINGBUF_TYPE val)
+{
+	// increment index and check for loop-around
+	int new_index=buf->index+1;
+	if(new_index>=buf->size) new_index=0;
+#ifdef RC_RINGBUF_STATS
+	RC_RINGBUF_PRIV(on_insert)(buf, new_index, val);
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	RC_RINGBUF_PRIV(median_replace)(buf, new_index, val);
+#endif
+	// write out new value
+	buf->d[new_index]=val;
+#ifdef RC_RINGBUF_MIRROR
+	buf->d[new_index+buf->size]=val;
+#endif
+	buf->index=new_index;
+	if(buf->count<buf->size) buf->count++;
+	__RC_BUF_COUNT(buf->counters, pushes, 1);
+}
+
 /**
  * @brief      Puts a new float into the ring buffer and updates the index
  * accordingly.
@@ -170,9 +738,8 @@ int rc_ringbuf_reset(rc_ringbuf_t* buf)
  *
  * @return     Returns 0 on success or -1 on failure.
  */
-int rc_ringbuf_insert(rc_ringbuf_t* buf, RINGBUF_TYPE val)
+static inline int RC_RINGBUF_FN(insert)(RC_RINGBUF_T* buf, RINGBUF_TYPE val)
 {
-	int new_index;
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_insert, received NULL pointer\n");
@@ -182,15 +749,168 @@ int rc_ringbuf_insert(rc_ringbuf_t* buf, RINGBUF_TYPE val)
 		fprintf(stderr,"ERROR in rc_ringbuf_insert, ringbuf uninitialized\n");
 		return -1;
 	}
-	// increment index and check for loop-around
-	new_index=buf->index+1;
-	if(new_index>=buf->size) new_index=0;
-	// write out new value
-	buf->d[new_index]=val;
-	buf->index=new_index;
+	RC_RINGBUF_FN(insert_unchecked)(buf, val);
+	return 0;
+}
+
+/**
+ * @brief      Puts n values from a contiguous array into the ring buffer,
+ * src[0] first, as if rc_ringbuf_insert was called for each of them.
+ *
+ * Checks the buffer state once for the whole block and copies it in with at
+ * most two memcpy calls, one up to the end of the backing memory and one for
+ * the part that wraps back around to the start. If n is at least the size of
+ * the buffer then only the last size values of src are copied, in one go, and
+ * the index is set directly. With RC_RINGBUF_STATS or RC_RINGBUF_MEDIAN the
+ * values still have to go through the bookkeeping one at a time.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  src   array of values to insert, src[n-1] ends up most recent
+ * @param[in]  n     number of values in src
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(insert_n)(RC_RINGBUF_T* buf, const RINGBUF_TYPE* src, int n)
+{
+#if defined(RC_RINGBUF_STATS) || defined(RC_RINGBUF_MEDIAN)
+	int i;
+#else
+	int w, first;
+#endif
+	// sanity checks
+	if(unlikely(buf==NULL || src==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_insert_n, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_insert_n, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(n<0)){
+		fprintf(stderr,"ERROR in rc_ringbuf_insert_n, n must be >=0\n");
+		return -1;
+	}
+	// anything older than the last size values would be overwritten anyway
+	if(n>=buf->size){
+		__RC_BUF_COUNT(buf->counters, pushes, n-buf->size);
+		src += n-buf->size;
+		n = buf->size;
+#if !defined(RC_RINGBUF_STATS) && !defined(RC_RINGBUF_MEDIAN)
+		memcpy(buf->d, src, n*sizeof(RINGBUF_TYPE));
+#ifdef RC_RINGBUF_MIRROR
+		memcpy(&buf->d[buf->size], src, n*sizeof(RINGBUF_TYPE));
+#endif
+		buf->index = buf->size-1;
+		buf->count = buf->size;
+		__RC_BUF_COUNT(buf->counters, pushes, n);
+		return 0;
+#endif
+	}
+#if defined(RC_RINGBUF_STATS) || defined(RC_RINGBUF_MEDIAN)
+	for(i=0;i<n;i++) RC_RINGBUF_FN(insert_unchecked)(buf, src[i]);
+#else
+	// copy up to the end of memory, then wrap around to the start
+	w = buf->index+1;
+	if(w>=buf->size) w=0;
+	first = buf->size-w;
+	if(first>n) first=n;
+	memcpy(&buf->d[w], src, first*sizeof(RINGBUF_TYPE));
+	if(n>first) memcpy(buf->d, &src[first], (n-first)*sizeof(RINGBUF_TYPE));
+#ifdef RC_RINGBUF_MIRROR
+	memcpy(&buf->d[w+buf->size], src, first*sizeof(RINGBUF_TYPE));
+	if(n>first) memcpy(&buf->d[buf->size], &src[first], (n-first)*sizeof(RINGBUF_TYPE));
+#endif
+	// n<size here so one subtraction is enough
+	w = buf->index+n;
+	if(w>=buf->size) w-=buf->size;
+	buf->index = w;
+	buf->count += n;
+	if(buf->count>buf->size) buf->count=buf->size;
+	__RC_BUF_COUNT(buf->counters, pushes, n);
+#endif
 	return 0;
 }
 
+/**
+ * @brief      Fetches the number of values inserted since the buffer was
+ * allocated or last reset, up to its size.
+ *
+ * Positions 0 through count-1 passed to rc_ringbuf_get_value are real
+ * samples, anything further back is startup history.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns the count or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(count)(RC_RINGBUF_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_count, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_count, ringbuf uninitialized\n");
+		return -1;
+	}
+	return buf->count;
+}
+
+#ifdef RC_BUF_COUNTERS
+/**
+ * @brief      Takes a snapshot of the buffer's counters, see buf_counters.h.
+ *
+ * Only the inserts are counted as they happen. Since the count saturates at
+ * size, the values overwritten are the inserts beyond the count and the peak
+ * is the count itself.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the current counters
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(counters)(RC_RINGBUF_T* buf, rc_buf_counters_t* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_counters, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_counters, ringbuf uninitialized\n");
+		return -1;
+	}
+	*out = buf->counters;
+	out->overwrites = out->pushes-(uint64_t)buf->count;
+	out->peak = (uint64_t)buf->count;
+	return 0;
+}
+#endif
+
+/**
+ * @brief      Same as rc_ringbuf_get_value but without any sanity checks,
+ * returns the value directly.
+ *
+ * The caller is responsible for buf being allocated and position being
+ * between 0 and size-1.
+ *
+ * @param      buf       Pointer to user's buffer
+ * @param[in]  position  steps back in the buffer to fetch the value from
+ *
+ * @return     the requested value
+ */
+static inline RINGBUF_TYPE RC_RINGBUF_FN(get_value_unchecked)(RC_RINGBUF_T* buf, int position)
+{
+#ifdef RC_RINGBUF_MIRROR
+	// the mirror copy covers the looparound so no branch is needed
+	return buf->d[buf->index+buf->size-position];
+#else
+	int return_index=buf->index-position;
+	if(return_index<0) return_index+=buf->size;
+	return buf->d[return_index];
+#endif
+}
+
 /**
  * @brief      Fetches the float which is 'position' steps behind the last value
  * added to the buffer.
@@ -204,9 +924,8 @@ int rc_ringbuf_insert(rc_ringbuf_t* buf, RINGBUF_TYPE val)
  * @return     Returns the requested float. Prints an error message and returns
  * -1 on error.
  */
-int rc_ringbuf_get_value(rc_ringbuf_t* buf, int position, RINGBUF_TYPE * value)
+static inline int RC_RINGBUF_FN(get_value)(RC_RINGBUF_T* buf, int position, RINGBUF_TYPE * value)
 {
-	int return_index;
 	// sanity checks
 	if(unlikely(buf==NULL)){
 		fprintf(stderr,"ERROR in rc_ringbuf_get_value, received NULL pointer\n");
@@ -220,10 +939,7 @@ int rc_ringbuf_get_value(rc_ringbuf_t* buf, int position, RINGBUF_TYPE * value)
 		fprintf(stderr,"ERROR in rc_ringbuf_get_value, ringbuf uninitialized\n");
 		return -1.0f;
 	}
-	// check for looparound
-	return_index=buf->index-position;
-	if(return_index<0) return_index+=buf->size;
-	*value = buf->d[return_index];
+	*value = RC_RINGBUF_FN(get_value_unchecked)(buf, position);
 	return 0;
 }
 
@@ -240,7 +956,7 @@ int rc_ringbuf_get_value(rc_ringbuf_t* buf, int position, RINGBUF_TYPE * value)
  * @return     Returns the requested float. Prints an error message and returns
  * -1 on error.
  */
-int rc_ringbuf_get_value_ptr(rc_ringbuf_t* buf, int position, RINGBUF_TYPE ** value_ptr)
+static inline int RC_RINGBUF_FN(get_value_ptr)(RC_RINGBUF_T* buf, int position, RINGBUF_TYPE ** value_ptr)
 {
 	int return_index;
 	// sanity checks
@@ -264,6 +980,528 @@ int rc_ringbuf_get_value_ptr(rc_ringbuf_t* buf, int position, RINGBUF_TYPE ** va
 }
 
 
+#ifdef RC_RINGBUF_STATS
+/**
+ * @brief      Fetches the sum of all values in the buffer. O(1).
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the sum
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(sum)(RC_RINGBUF_T* buf, double* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_sum, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_sum, ringbuf uninitialized\n");
+		return -1;
+	}
+	*out = buf->sum + buf->sum_c;
+	return 0;
+}
+
+/**
+ * @brief      Fetches the mean of all values in the buffer. O(1).
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the mean
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(mean)(RC_RINGBUF_T* buf, double* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_mean, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_mean, ringbuf uninitialized\n");
+		return -1;
+	}
+	*out = (buf->sum + buf->sum_c)/buf->size;
+	return 0;
+}
+
+/**
+ * @brief      Fetches the population variance of all values in the buffer,
+ * i.e. the mean squared deviation from the mean. O(1).
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the variance
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(variance)(RC_RINGBUF_T* buf, double* out)
+{
+	double mean, var;
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_variance, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_variance, ringbuf uninitialized\n");
+		return -1;
+	}
+	mean = (buf->sum + buf->sum_c)/buf->size;
+	var = (buf->sumsq + buf->sumsq_c)/buf->size - mean*mean;
+	// rounding can take a constant signal's variance slightly negative
+	*out = var>0.0 ? var : 0.0;
+	return 0;
+}
+
+/**
+ * @brief      Fetches the smallest value in the buffer. O(1).
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the minimum
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(min)(RC_RINGBUF_T* buf, RINGBUF_TYPE* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_min, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_min, ringbuf uninitialized\n");
+		return -1;
+	}
+	*out = buf->d[buf->minq[buf->min_head]];
+	return 0;
+}
+
+/**
+ * @brief      Fetches the largest value in the buffer. O(1).
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the maximum
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(max)(RC_RINGBUF_T* buf, RINGBUF_TYPE* out)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_max, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_max, ringbuf uninitialized\n");
+		return -1;
+	}
+	*out = buf->d[buf->maxq[buf->max_head]];
+	return 0;
+}
+#endif
+
+#ifdef RC_RINGBUF_MEDIAN
+/**
+ * @brief      Fetches the median of all values in the buffer. O(log N).
+ *
+ * For an even size this is the mean of the two middle values.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[out] out   set to the median
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(median)(RC_RINGBUF_T* buf, double* out)
+{
+	int lo, hi;
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_median, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_median, ringbuf uninitialized\n");
+		return -1;
+	}
+	lo = RC_RINGBUF_PRIV(median_select)(buf, (buf->size-1)/2);
+	if(buf->size&1){
+		*out = (double)buf->d[lo];
+		return 0;
+	}
+	// the upper middle value is the next node along
+	hi = buf->sl_next[lo*buf->sl_levels];
+	*out = ((double)buf->d[lo]+(double)buf->d[hi])/2.0;
+	return 0;
+}
+
+/**
+ * @brief      Fetches the p-th percentile of all values in the buffer.
+ * O(log N).
+ *
+ * Interpolates linearly between the two nearest values in sorted order, so p
+ * of 0 gives the minimum, 50 the median and 100 the maximum.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  p     percentile from 0 to 100
+ * @param[out] out   set to the percentile
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(percentile)(RC_RINGBUF_T* buf, double p, double* out)
+{
+	int k, lo, hi;
+	double rank;
+	// sanity checks
+	if(unlikely(buf==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_percentile, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_percentile, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(!(p>=0.0 && p<=100.0))){
+		fprintf(stderr,"ERROR in rc_ringbuf_percentile, p must be between 0 and 100\n");
+		return -1;
+	}
+	rank = p*(buf->size-1)/100.0;
+	k = (int)rank;
+	lo = RC_RINGBUF_PRIV(median_select)(buf, k);
+	*out = (double)buf->d[lo];
+	hi = buf->sl_next[lo*buf->sl_levels];
+	if(rank>k && hi!=-1) *out += (rank-k)*((double)buf->d[hi]-(double)buf->d[lo]);
+	return 0;
+}
+#endif
+
+#ifdef RC_RINGBUF_MIRROR
+/**
+ * @brief      Fetches a pointer to the last size values as one contiguous
+ * array, oldest first.
+ *
+ * Only available when RC_RINGBUF_MIRROR is defined. The most recent value is
+ * at (*window_ptr)[size-1] so (*window_ptr)[size-1-position] is the same value
+ * rc_ringbuf_get_value returns for that position. The pointer is only valid
+ * until the next insert.
+ *
+ * @param      buf         Pointer to user's buffer
+ * @param[out] window_ptr  set to point at the oldest value in the window
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(window)(RC_RINGBUF_T* buf, RINGBUF_TYPE ** window_ptr)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || window_ptr==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_window, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_window, ringbuf uninitialized\n");
+		return -1;
+	}
+	// the oldest value lives just after the newest, and the mirror copy
+	// guarantees the following size-1 values are contiguous
+	*window_ptr = &buf->d[buf->index+1];
+	return 0;
+}
+#endif
+
+/**
+ * Orders for rc_ringbuf_copy_ordered and rc_ringbuf_copy_decimated.
+ */
+#ifndef RC_RINGBUF_OLDEST_FIRST
+#define RC_RINGBUF_OLDEST_FIRST	0	///< dst[0] is the oldest value, dst[count-1] the newest
+#define RC_RINGBUF_NEWEST_FIRST	1	///< dst[0] is the newest value, same order as get_value
+#endif
+
+/**
+ * @brief      Copies the count most recent values out of the buffer into a
+ * linear array in either time order.
+ *
+ * Oldest first is a straight copy of at most two contiguous segments of the
+ * backing memory, or one with RC_RINGBUF_MIRROR, so it is done with memcpy.
+ * Newest first walks the same segments backwards with no wraparound checks.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[out] dst    array of at least count values to copy into
+ * @param[in]  count  number of values to copy, from 0 to size
+ * @param[in]  order  RC_RINGBUF_OLDEST_FIRST or RC_RINGBUF_NEWEST_FIRST
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(copy_ordered)(RC_RINGBUF_T* buf, RINGBUF_TYPE* dst, int count, int order)
+{
+	int i, start, first;
+	// sanity checks
+	if(unlikely(buf==NULL || dst==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_ordered, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_ordered, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(count<0 || count>buf->size)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_ordered, count must be between 0 and size\n");
+		return -1;
+	}
+	if(unlikely(order!=RC_RINGBUF_OLDEST_FIRST && order!=RC_RINGBUF_NEWEST_FIRST)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_ordered, invalid order\n");
+		return -1;
+	}
+	if(count==0) return 0;
+
+#ifdef RC_RINGBUF_MIRROR
+	// the mirror copy makes the whole span contiguous
+	start = buf->index+buf->size-count+1;
+	first = count;
+#else
+	// index of the oldest value wanted and how many run up to the end of d
+	start = buf->index-count+1;
+	if(start<0) start+=buf->size;
+	first = buf->size-start;
+	if(first>count) first=count;
+#endif
+	if(order==RC_RINGBUF_OLDEST_FIRST){
+		memcpy(dst, &buf->d[start], first*sizeof(RINGBUF_TYPE));
+		if(count>first) memcpy(&dst[first], buf->d, (count-first)*sizeof(RINGBUF_TYPE));
+	}
+	else{
+		for(i=0;i<first;i++) dst[count-1-i] = buf->d[start+i];
+		for(i=first;i<count;i++) dst[count-1-i] = buf->d[i-first];
+	}
+	return 0;
+}
+
+/**
+ * @brief      Copies every stride'th value out of the buffer into a linear
+ * array, starting from the most recent, for decimation or downsampling.
+ *
+ * Picks the values at positions 0, stride, 2*stride ... (count-1)*stride
+ * back from the newest, as rc_ringbuf_get_value would number them, so the
+ * result always ends on the newest sample. (count-1)*stride must be less
+ * than the size of the buffer.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[out] dst     array of at least count values to copy into
+ * @param[in]  count   number of values to copy
+ * @param[in]  stride  steps between values taken, 1 is the same as
+ * rc_ringbuf_copy_ordered
+ * @param[in]  order   RC_RINGBUF_OLDEST_FIRST or RC_RINGBUF_NEWEST_FIRST
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(copy_decimated)(RC_RINGBUF_T* buf, RINGBUF_TYPE* dst, int count, int stride, int order)
+{
+	int i, j, step;
+	// sanity checks
+	if(unlikely(buf==NULL || dst==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_decimated, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_decimated, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(stride<1 || count<0 || (count>0 && (long)(count-1)*stride>=buf->size))){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_decimated, (count-1)*stride must be less than size\n");
+		return -1;
+	}
+	if(unlikely(order!=RC_RINGBUF_OLDEST_FIRST && order!=RC_RINGBUF_NEWEST_FIRST)){
+		fprintf(stderr,"ERROR in rc_ringbuf_copy_decimated, invalid order\n");
+		return -1;
+	}
+	if(stride==1) return RC_RINGBUF_FN(copy_ordered)(buf, dst, count, order);
+
+	// walk back from the newest, stride<size so one addition handles wrap
+	if(order==RC_RINGBUF_NEWEST_FIRST){
+		j = 0;
+		step = 1;
+	}
+	else{
+		j = count-1;
+		step = -1;
+	}
+	i = buf->index;
+	while(count--){
+		dst[j] = buf->d[i];
+		j += step;
+		i -= stride;
+		if(i<0) i+=buf->size;
+	}
+	return 0;
+}
+
+
+
+
+#if defined(RC_RINGBUF_FLOAT) || defined(RC_RINGBUF_DOUBLE)
+// catch a flag left over from an earlier instantiation of another type
+#ifndef __cplusplus
+#ifdef RC_RINGBUF_FLOAT
+_Static_assert(_Generic((RINGBUF_TYPE*)0, float*: 1, default: 0),
+	"RC_RINGBUF_FLOAT needs RINGBUF_TYPE float, #undef it for other types");
+#else
+_Static_assert(_Generic((RINGBUF_TYPE*)0, double*: 1, default: 0),
+	"RC_RINGBUF_DOUBLE needs RINGBUF_TYPE double, #undef it for other types");
+#endif
+#endif
+
+// dot product of two contiguous arrays, vectorized where possible
+static inline RINGBUF_TYPE RC_RINGBUF_PRIV(dot_seg)(const RINGBUF_TYPE* x, const RINGBUF_TYPE* c, int n)
+{
+	int i = 0;
+	RINGBUF_TYPE sum;
+	RINGBUF_TYPE s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+#if defined(RC_RINGBUF_NO_SIMD)
+	// scalar loop below only
+#elif defined(RC_RINGBUF_FLOAT) && defined(__AVX__)
+	float tmp[8];
+	__m256 acc0 = _mm256_setzero_ps();
+	__m256 acc1 = _mm256_setzero_ps();
+	for(; i+16<=n; i+=16){
+#ifdef __FMA__
+		acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&c[i]), acc0);
+		acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&x[i+8]), _mm256_loadu_ps(&c[i+8]), acc1);
+#else
+		acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(&x[i]), _mm256_loadu_ps(&c[i])));
+		acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(&x[i+8]), _mm256_loadu_ps(&c[i+8])));
+#endif
+	}
+	_mm256_storeu_ps(tmp, _mm256_add_ps(acc0, acc1));
+	s0 = (tmp[0]+tmp[4]) + (tmp[1]+tmp[5]);
+	s1 = (tmp[2]+tmp[6]) + (tmp[3]+tmp[7]);
+#elif defined(RC_RINGBUF_FLOAT) && defined(__SSE2__)
+	float tmp[4];
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for(; i+8<=n; i+=8){
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&x[i]), _mm_loadu_ps(&c[i])));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&x[i+4]), _mm_loadu_ps(&c[i+4])));
+	}
+	_mm_storeu_ps(tmp, _mm_add_ps(acc0, acc1));
+	s0 = tmp[0]+tmp[2];
+	s1 = tmp[1]+tmp[3];
+#elif defined(RC_RINGBUF_FLOAT) && defined(__ARM_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.0f);
+	float32x4_t acc1 = vdupq_n_f32(0.0f);
+	for(; i+8<=n; i+=8){
+		acc0 = vmlaq_f32(acc0, vld1q_f32(&x[i]), vld1q_f32(&c[i]));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(&x[i+4]), vld1q_f32(&c[i+4]));
+	}
+	acc0 = vaddq_f32(acc0, acc1);
+	s0 = vgetq_lane_f32(acc0,0) + vgetq_lane_f32(acc0,2);
+	s1 = vgetq_lane_f32(acc0,1) + vgetq_lane_f32(acc0,3);
+#elif defined(RC_RINGBUF_DOUBLE) && defined(__AVX__)
+	double tmp[4];
+	__m256d acc0 = _mm256_setzero_pd();
+	__m256d acc1 = _mm256_setzero_pd();
+	for(; i+8<=n; i+=8){
+#ifdef __FMA__
+		acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(&x[i]), _mm256_loadu_pd(&c[i]), acc0);
+		acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(&x[i+4]), _mm256_loadu_pd(&c[i+4]), acc1);
+#else
+		acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(&x[i]), _mm256_loadu_pd(&c[i])));
+		acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(&x[i+4]), _mm256_loadu_pd(&c[i+4])));
+#endif
+	}
+	_mm256_storeu_pd(tmp, _mm256_add_pd(acc0, acc1));
+	s0 = tmp[0]+tmp[2];
+	s1 = tmp[1]+tmp[3];
+#elif defined(RC_RINGBUF_DOUBLE) && defined(__SSE2__)
+	double tmp[2];
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	for(; i+4<=n; i+=4){
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(&x[i]), _mm_loadu_pd(&c[i])));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(&x[i+2]), _mm_loadu_pd(&c[i+2])));
+	}
+	_mm_storeu_pd(tmp, _mm_add_pd(acc0, acc1));
+	s0 = tmp[0];
+	s1 = tmp[1];
+#elif defined(RC_RINGBUF_DOUBLE) && defined(__ARM_NEON) && defined(__aarch64__)
+	float64x2_t acc0 = vdupq_n_f64(0.0);
+	float64x2_t acc1 = vdupq_n_f64(0.0);
+	for(; i+4<=n; i+=4){
+		acc0 = vfmaq_f64(acc0, vld1q_f64(&x[i]), vld1q_f64(&c[i]));
+		acc1 = vfmaq_f64(acc1, vld1q_f64(&x[i+2]), vld1q_f64(&c[i+2]));
+	}
+	acc0 = vaddq_f64(acc0, acc1);
+	s0 = vgetq_lane_f64(acc0,0);
+	s1 = vgetq_lane_f64(acc0,1);
+#endif
+	// scalar fallback and leftover tail, 4 independent sums to keep the
+	// floating point pipeline full
+	for(; i+4<=n; i+=4){
+		s0 += x[i]*c[i];
+		s1 += x[i+1]*c[i+1];
+		s2 += x[i+2]*c[i+2];
+		s3 += x[i+3]*c[i+3];
+	}
+	for(; i<n; i++) s0 += x[i]*c[i];
+	sum = (s0+s1)+(s2+s3);
+	return sum;
+}
+
+/**
+ * @brief      Computes the dot product of the n most recent values in the
+ * buffer with an array of n coefficients.
+ *
+ * Only available when RC_RINGBUF_FLOAT or RC_RINGBUF_DOUBLE is defined. This
+ * is the inner loop of an FIR filter or convolution. The coefficients are in
+ * time-reversed order, the same order rc_ringbuf_window returns values in, so
+ * coeffs[n-1] multiplies the most recent value and coeffs[0] multiplies the
+ * value n-1 steps back. In terms of rc_ringbuf_get_value:
+ *
+ * out = sum over k of coeffs[n-1-k] * value at position k
+ *
+ * The wraparound at the buffer index is handled by running the kernel over at
+ * most two contiguous segments, or one with RC_RINGBUF_MIRROR.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  coeffs  array of n coefficients, time reversed
+ * @param[in]  n       number of coefficients, between 1 and the buffer size
+ * @param[out] out     the result
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_FN(dot)(RC_RINGBUF_T* buf, const RINGBUF_TYPE* coeffs, int n, RINGBUF_TYPE* out)
+{
+	int start, first;
+	// sanity checks
+	if(unlikely(buf==NULL || coeffs==NULL || out==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_dot, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_dot, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(n<1 || n>buf->size)){
+		fprintf(stderr,"ERROR in rc_ringbuf_dot, n must be between 1 and buffer size\n");
+		return -1;
+	}
+#ifdef RC_RINGBUF_MIRROR
+	start = buf->index + buf->size - n + 1;
+	(void)first;
+	*out = RC_RINGBUF_PRIV(dot_seg)(&buf->d[start], coeffs, n);
+#else
+	start = buf->index - n + 1;
+	if(start>=0){
+		*out = RC_RINGBUF_PRIV(dot_seg)(&buf->d[start], coeffs, n);
+		return 0;
+	}
+	// oldest values run to the end of memory, newest start back at d[0]
+	first = -start;
+	*out = RC_RINGBUF_PRIV(dot_seg)(&buf->d[buf->size-first], coeffs, first) +
+		RC_RINGBUF_PRIV(dot_seg)(buf->d, &coeffs[first], n-first);
+#endif
+	return 0;
+}
+#endif
 
 
 #ifdef __cplusplus
@@ -0,0 +1,297 @@
+/**
+ * "ring_buf_cascade.h"
+ *
+ * @brief      multi-rate cascade of ring buffers for long histories
+ *
+ * A cascade keeps the most recent samples at full rate in one ring buffer and
+ * progressively coarser histories in more rings behind it. Every factor[i]
+ * values arriving at level i-1 are combined into one block at level i, which
+ * stores the block's mean, minimum and maximum in three rings. For example
+ * with 1 kHz samples, sizes {1000, 600, 600} and factors {1, 10, 10} the
+ * cascade remembers the last second at 1 kHz, a minute at 100 Hz and ten
+ * minutes at 10 Hz in 4200 values, where one full rate ring with the same
+ * reach would take 600000.
+ *
+ * The blocks are built incrementally. rc_ringbuf_cascade_insert costs one
+ * ring insert plus a running sum, min and max update for each level whose
+ * block is in progress, and only pushes to a coarser level once its block
+ * completes, so it is O(1) amortized. Since blocks at each level are the same
+ * length the mean of means is the exact mean of the underlying samples. For
+ * integer RINGBUF_TYPEs the means are truncated back to the type.
+ *
+ * This builds on ring_buf.h and uses its most recent instantiation, so
+ * include ring_buf.h first with the same RINGBUF_TYPE and RINGBUF_NAME. With
+ * RINGBUF_NAME f32 the type is rc_ringbuf_cascade_f32_t and the functions are
+ * rc_ringbuf_cascade_f32_insert etc. The rings of each level are ordinary
+ * ring buffers fetched with rc_ringbuf_cascade_level and read with the usual
+ * rc_ringbuf_get_value and friends.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_RINGBUF_T
+#error "ERROR include ring_buf.h before ring_buf_cascade.h"
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// deepest cascade supported, including the full rate level
+#ifndef RC_RINGBUF_CASCADE_MAX_LEVELS
+#define RC_RINGBUF_CASCADE_MAX_LEVELS 4
+#endif
+
+// which aggregate to fetch with rc_ringbuf_cascade_level
+#ifndef RC_RINGBUF_CASCADE_MEAN
+#define RC_RINGBUF_CASCADE_MEAN	0
+#define RC_RINGBUF_CASCADE_MIN	1
+#define RC_RINGBUF_CASCADE_MAX	2
+#endif
+
+// name mangling for this instantiation, see ring_buf.h
+#undef RC_RINGBUF_CASCADE_T
+#undef RC_RINGBUF_CASCADE_FN
+#ifdef RINGBUF_NAME
+#define RC_RINGBUF_CASCADE_T	__RC_RINGBUF_CAT(rc_ringbuf_cascade_, RINGBUF_NAME, _t)
+#define RC_RINGBUF_CASCADE_FN(f)	__RC_RINGBUF_CAT(rc_ringbuf_cascade_, RINGBUF_NAME, _##f)
+#else
+#define RC_RINGBUF_CASCADE_T	rc_ringbuf_cascade_t
+#define RC_RINGBUF_CASCADE_FN(f)	rc_ringbuf_cascade_##f
+#endif
+
+
+/**
+ * @brief      Struct containing state of a ring buffer cascade.
+ *
+ * Level 0 holds the raw samples in mean[0], its min and max rings are
+ * unused. Levels 1 and up hold one value per block in each of their three
+ * rings.
+ */
+typedef struct RC_RINGBUF_CASCADE_T {
+	int levels;	///< number of levels including the full rate one
+	int factor[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< level i-1 values per level i block
+	RC_RINGBUF_T mean[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< block means, raw samples at level 0
+	RC_RINGBUF_T min[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< block minimums
+	RC_RINGBUF_T max[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< block maximums
+	double sum[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< sum of the means so far in the block in progress
+	RINGBUF_TYPE lo[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< minimum so far in the block in progress
+	RINGBUF_TYPE hi[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< maximum so far in the block in progress
+	int n[RC_RINGBUF_CASCADE_MAX_LEVELS];	///< values so far in the block in progress
+	int initialized;///< flag indicating if memory has been allocated for the cascade
+} RC_RINGBUF_CASCADE_T;
+
+
+// everything not named starts at zero, including every field of the mean,
+// min and max rings. That matches RC_RINGBUF_INITIALIZER, which only sets
+// fields to zero or NULL, so a ring given a non-zero initial value there
+// would need spelling out here.
+#define RC_RINGBUF_CASCADE_INITIALIZER {\
+	.levels = 0,\
+	.initialized = 0}
+
+
+/**
+ * @brief      Frees the memory allocated for all levels of a cascade.
+ *
+ * @param      c     Pointer to user's cascade
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_CASCADE_FN(free)(RC_RINGBUF_CASCADE_T* c)
+{
+	int i;
+	if(unlikely(c==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_cascade_free, received NULL pointer\n");
+		return -1;
+	}
+	for(i=0;i<RC_RINGBUF_CASCADE_MAX_LEVELS;i++){
+		RC_RINGBUF_FN(free)(&c->mean[i]);
+		RC_RINGBUF_FN(free)(&c->min[i]);
+		RC_RINGBUF_FN(free)(&c->max[i]);
+		c->sum[i] = 0.0;
+		c->n[i] = 0;
+		c->factor[i] = 0;
+	}
+	c->levels = 0;
+	c->initialized = 0;
+	return 0;
+}
+
+/**
+ * @brief      Allocates the rings of a cascade.
+ *
+ * Any memory previously allocated for c is freed first. sizes and factors
+ * are levels long, factors[0] is ignored since level 0 takes every sample.
+ *
+ * @param      c        Pointer to user's cascade
+ * @param[in]  levels   number of levels including full rate, from 1 to
+ * RC_RINGBUF_CASCADE_MAX_LEVELS
+ * @param[in]  sizes    ring length at each level, each >=2
+ * @param[in]  factors  number of level i-1 values combined into each level i
+ * value, each >=2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_CASCADE_FN(alloc)(RC_RINGBUF_CASCADE_T* c, int levels, const int* sizes, const int* factors)
+{
+	int i;
+	// sanity checks
+	if(unlikely(c==NULL || sizes==NULL || (levels>1 && factors==NULL))){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(levels<1 || levels>RC_RINGBUF_CASCADE_MAX_LEVELS)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_alloc, levels must be between 1 and RC_RINGBUF_CASCADE_MAX_LEVELS\n");
+		return -1;
+	}
+	for(i=1;i<levels;i++){
+		if(unlikely(factors[i]<2)){
+			fprintf(stderr,"ERROR in rc_ringbuf_cascade_alloc, factors must be >=2\n");
+			return -1;
+		}
+	}
+	if(c->initialized) RC_RINGBUF_CASCADE_FN(free)(c);
+	for(i=0;i<levels;i++){
+		if(RC_RINGBUF_FN(alloc)(&c->mean[i], sizes[i]) || (i>0 &&
+				(RC_RINGBUF_FN(alloc)(&c->min[i], sizes[i]) ||
+				 RC_RINGBUF_FN(alloc)(&c->max[i], sizes[i])))){
+			fprintf(stderr,"ERROR in rc_ringbuf_cascade_alloc, failed to allocate level %d\n", i);
+			RC_RINGBUF_CASCADE_FN(free)(c);
+			return -1;
+		}
+		c->factor[i] = i ? factors[i] : 1;
+	}
+	c->levels = levels;
+	c->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Empties every level and discards the blocks in progress.
+ *
+ * @param      c     Pointer to user's cascade
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_CASCADE_FN(reset)(RC_RINGBUF_CASCADE_T* c)
+{
+	int i;
+	// sanity checks
+	if(unlikely(c==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_cascade_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!c->initialized)){
+		fprintf(stderr,"ERROR rc_ringbuf_cascade_reset, cascade uninitialized\n");
+		return -1;
+	}
+	RC_RINGBUF_FN(reset)(&c->mean[0]);
+	for(i=1;i<c->levels;i++){
+		RC_RINGBUF_FN(reset)(&c->mean[i]);
+		RC_RINGBUF_FN(reset)(&c->min[i]);
+		RC_RINGBUF_FN(reset)(&c->max[i]);
+		c->sum[i] = 0.0;
+		c->n[i] = 0;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Puts a new full rate sample into the cascade and passes any
+ * completed blocks on to the coarser levels.
+ *
+ * @param      c     Pointer to user's cascade
+ * @param[in]  val   The value to be inserted
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_CASCADE_FN(insert)(RC_RINGBUF_CASCADE_T* c, RINGBUF_TYPE val)
+{
+	int i;
+	double mean = (double)val;
+	RINGBUF_TYPE lo = val, hi = val;
+	// sanity checks
+	if(unlikely(c==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_insert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!c->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_insert, cascade uninitialized\n");
+		return -1;
+	}
+	RC_RINGBUF_FN(insert_unchecked)(&c->mean[0], val);
+	for(i=1;i<c->levels;i++){
+		// fold this level's new value into the block in progress
+		if(c->n[i]==0){
+			c->sum[i] = mean;
+			c->lo[i] = lo;
+			c->hi[i] = hi;
+		}
+		else{
+			c->sum[i] += mean;
+			if(lo<c->lo[i]) c->lo[i] = lo;
+			if(hi>c->hi[i]) c->hi[i] = hi;
+		}
+		if(++c->n[i]<c->factor[i]) break;
+		// block complete, it becomes the next level's new value
+		mean = c->sum[i]/c->factor[i];
+		lo = c->lo[i];
+		hi = c->hi[i];
+		c->n[i] = 0;
+		RC_RINGBUF_FN(insert_unchecked)(&c->mean[i], (RINGBUF_TYPE)mean);
+		RC_RINGBUF_FN(insert_unchecked)(&c->min[i], lo);
+		RC_RINGBUF_FN(insert_unchecked)(&c->max[i], hi);
+	}
+	return 0;
+}
+
+/**
+ * @brief      Fetches one of the rings of a cascade level to read with the
+ * usual ring buffer functions.
+ *
+ * Position 0 in the ring is the most recently completed block. Level 0 is
+ * the raw samples and returns the same ring for every aggregate.
+ *
+ * @param      c      Pointer to user's cascade
+ * @param[in]  level  level to fetch, 0 is full rate
+ * @param[in]  which  RC_RINGBUF_CASCADE_MEAN, RC_RINGBUF_CASCADE_MIN or
+ * RC_RINGBUF_CASCADE_MAX
+ *
+ * @return     pointer to the ring or NULL on failure.
+ */
+static inline RC_RINGBUF_T* RC_RINGBUF_CASCADE_FN(level)(RC_RINGBUF_CASCADE_T* c, int level, int which)
+{
+	// sanity checks
+	if(unlikely(c==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_level, received NULL pointer\n");
+		return NULL;
+	}
+	if(unlikely(!c->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_level, cascade uninitialized\n");
+		return NULL;
+	}
+	if(unlikely(level<0 || level>=c->levels)){
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_level, level out of bounds\n");
+		return NULL;
+	}
+	if(level==0) return &c->mean[0];
+	switch(which){
+	case RC_RINGBUF_CASCADE_MEAN:
+		return &c->mean[level];
+	case RC_RINGBUF_CASCADE_MIN:
+		return &c->min[level];
+	case RC_RINGBUF_CASCADE_MAX:
+		return &c->max[level];
+	default:
+		fprintf(stderr,"ERROR in rc_ringbuf_cascade_level, invalid aggregate\n");
+		return NULL;
+	}
+}
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,448 @@
+/**
+ * "ring_buf_recorder.h"
+ *
+ * @brief      ring buffer kept in a memory mapped file as a flight recorder
+ *
+ * For post-crash analysis the last n samples of telemetry should outlive the
+ * process that wrote them. Rather than copy out of a ring buffer to a file
+ * writer thread, this keeps an ordinary ring buffer whose memory is a shared
+ * mapping of a file. An insert is a few stores into the mapping and never a
+ * system call. The kernel writes the pages back in its own time, and since
+ * they belong to the page cache rather than the process they survive the
+ * process crashing or being killed. To also survive a kernel crash or power
+ * loss, call rc_ringbuf_recorder_sync from a housekeeping thread every so
+ * often, or at least before a clean reboot.
+ *
+ * The file starts with an rc_ringbuf_recorder_header_t holding the size,
+ * index and count of the ring, the element size and a generation counter,
+ * followed by the samples laid out exactly as in rc_ringbuf_t. The generation
+ * is bumped before and after every insert, so it is odd if the writer died
+ * partway through one. Before the first bump the writer notes which slot it
+ * is about to write and what the count will be once it has. Recovery from an
+ * odd generation goes by those alone and drops exactly that slot, however
+ * far the insert got with the sample, index and count.
+ *
+ * rc_ringbuf_recorder_open on an existing file picks up where the last writer
+ * left off, so after a restart the history is still there to read with the
+ * ring_buf.h getters on the .ring member and new samples carry on after it.
+ * rc_ringbuf_recorder_recover reads a file back oldest first without knowing
+ * its RINGBUF_TYPE, for tools such as ring_buf_recover.c. The file is in the
+ * writer's byte order and struct layout, so read it on the same kind of
+ * machine.
+ *
+ * This builds on ring_buf.h and uses its most recent instantiation, so
+ * include ring_buf.h first with the same RINGBUF_TYPE and RINGBUF_NAME. With
+ * RINGBUF_NAME f32 the type is rc_ringbuf_recorder_f32_t and the functions
+ * are rc_ringbuf_recorder_f32_insert etc. A program which only reads files
+ * back may instead #define RC_RINGBUF_RECORDER_READER and include this header
+ * alone for the file format and rc_ringbuf_recorder_recover. Not available
+ * with RC_RINGBUF_STATS or RC_RINGBUF_MEDIAN since the statistics and sorted
+ * order can't be restored from the file, including it after either is a
+ * compile error.
+ *
+ * rc_ringbuf_recorder_open reserves the whole file on disk with
+ * posix_fallocate, so running out of space fails there rather than as a
+ * SIGBUS from an insert writing to a page the filesystem can't back. Strict
+ * ISO modes such as -std=c11 need _POSIX_C_SOURCE defined to 200112L or later
+ * for it.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_RINGBUF_RECORDER_H
+#define RC_RINGBUF_RECORDER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#define RC_RINGBUF_RECORDER_MAGIC	0x42524352u	// "RCRB"
+#define RC_RINGBUF_RECORDER_VERSION	2
+// bytes from the start of the file to the samples, the header padded to a line
+#define RC_RINGBUF_RECORDER_DATA_OFF	64
+
+/**
+ * @brief      Header at the start of a flight recorder file.
+ */
+typedef struct rc_ringbuf_recorder_header_t {
+	uint32_t magic;		///< RC_RINGBUF_RECORDER_MAGIC once the file is set up
+	uint32_t version;	///< RC_RINGBUF_RECORDER_VERSION
+	uint32_t elem_size;	///< sizeof(RINGBUF_TYPE) of the writer
+	uint32_t data_off;	///< bytes from the start of the file to the samples
+	int32_t size;		///< number of samples the ring holds
+	int32_t len;		///< elements of storage, 2*size if written with RC_RINGBUF_MIRROR
+	int32_t index;		///< index of the most recent sample
+	int32_t count;		///< number of samples recorded, saturates at size
+	uint64_t generation;	///< bumped before and after every insert, odd while one is in progress
+	int32_t writing;	///< slot the insert in progress writes, valid while generation is odd
+	int32_t writing_count;	///< count once that insert is done, valid while generation is odd
+} rc_ringbuf_recorder_header_t;
+
+
+// checks the fields an interrupted insert left behind are usable
+static inline int __rc_ringbuf_recorder_torn_ok(const rc_ringbuf_recorder_header_t* h)
+{
+	if(!(h->generation&1)) return 1;
+	return h->writing>=0 && h->writing<h->size &&
+		h->writing_count>=1 && h->writing_count<=h->size;
+}
+
+// rolls the header back to before an interrupted insert, minus the slot it
+// was writing. index and count may or may not have been published by then,
+// so they are rebuilt from writing and writing_count.
+static inline void __rc_ringbuf_recorder_settle(rc_ringbuf_recorder_header_t* h)
+{
+	if(!(h->generation&1)) return;
+	h->index = h->writing ? h->writing-1 : h->size-1;
+	h->count = h->writing_count-1;
+}
+
+
+/**
+ * @brief      Reads the samples in a flight recorder file, oldest first.
+ *
+ * Works on the file of a writer which crashed, was killed or closed it
+ * normally, with any RINGBUF_TYPE. If the generation is odd the sample which
+ * was being inserted is dropped. The samples are copied into memory from
+ * malloc which the caller must free.
+ *
+ * @param[in]  path  the file
+ * @param[out] hdr   set to the file's header, with index and count
+ *                   corrected for a dropped sample
+ * @param[out] data  set to hdr->count samples of hdr->elem_size bytes each
+ *
+ * @return     Returns the number of samples recovered or -1 on failure.
+ */
+static inline int rc_ringbuf_recorder_recover(const char* path, rc_ringbuf_recorder_header_t* hdr, void** data)
+{
+	FILE* f;
+	char* raw;
+	char* out;
+	size_t bytes;
+	int oldest, first;
+	// sanity checks
+	if(path==NULL || hdr==NULL || data==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_recover, received NULL pointer\n");
+		return -1;
+	}
+	f = fopen(path, "rb");
+	if(f==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_recover, can't open %s\n", path);
+		return -1;
+	}
+	if(fread(hdr, sizeof(*hdr), 1, f)!=1 || hdr->magic!=RC_RINGBUF_RECORDER_MAGIC ||
+			hdr->version!=RC_RINGBUF_RECORDER_VERSION || hdr->elem_size==0 ||
+			hdr->size<2 || hdr->len<hdr->size || hdr->index<0 ||
+			hdr->index>=hdr->size || hdr->count<0 || hdr->count>hdr->size ||
+			!__rc_ringbuf_recorder_torn_ok(hdr)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_recover, %s is not a recorder file\n", path);
+		fclose(f);
+		return -1;
+	}
+	// only the first size elements are needed, the mirror is a copy
+	bytes = (size_t)hdr->size*hdr->elem_size;
+	raw = (char*)malloc(bytes);
+	out = (char*)malloc(bytes);
+	if(raw==NULL || out==NULL || fseek(f, (long)hdr->data_off, SEEK_SET) ||
+			fread(raw, 1, bytes, f)!=bytes){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_recover, failed to read samples\n");
+		free(raw);
+		free(out);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	__rc_ringbuf_recorder_settle(hdr);
+	// copy out oldest first in at most two pieces
+	oldest = hdr->index-hdr->count+1;
+	if(oldest<0) oldest += hdr->size;
+	first = hdr->size-oldest;
+	if(first>hdr->count) first = hdr->count;
+	memcpy(out, &raw[(size_t)oldest*hdr->elem_size], (size_t)first*hdr->elem_size);
+	memcpy(&out[(size_t)first*hdr->elem_size], raw, (size_t)(hdr->count-first)*hdr->elem_size);
+	free(raw);
+	*data = out;
+	return hdr->count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_RINGBUF_RECORDER_H
+
+
+#ifndef RC_RINGBUF_RECORDER_READER
+
+#ifndef RC_RINGBUF_T
+#error "ERROR include ring_buf.h before ring_buf_recorder.h"
+#endif
+#ifdef RC_RINGBUF_STATS
+#error "ERROR ring_buf_recorder.h is not available with RC_RINGBUF_STATS"
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+#error "ERROR ring_buf_recorder.h is not available with RC_RINGBUF_MEDIAN"
+#endif
+
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// name mangling for this instantiation, see ring_buf.h
+#undef RC_RINGBUF_RECORDER_T
+#undef RC_RINGBUF_RECORDER_FN
+#ifdef RINGBUF_NAME
+#define RC_RINGBUF_RECORDER_T	__RC_RINGBUF_CAT(rc_ringbuf_recorder_, RINGBUF_NAME, _t)
+#define RC_RINGBUF_RECORDER_FN(f)	__RC_RINGBUF_CAT(rc_ringbuf_recorder_, RINGBUF_NAME, _##f)
+#else
+#define RC_RINGBUF_RECORDER_T	rc_ringbuf_recorder_t
+#define RC_RINGBUF_RECORDER_FN(f)	rc_ringbuf_recorder_##f
+#endif
+
+
+/**
+ * @brief      Struct containing state of a flight recorder ring buffer.
+ */
+typedef struct RC_RINGBUF_RECORDER_T {
+	RC_RINGBUF_T ring;	///< the samples, read with the ring_buf.h getters
+	rc_ringbuf_recorder_header_t* hdr;	///< header at the start of the mapping
+	size_t map_len;	///< bytes of the file mapped
+	int initialized;///< flag indicating if the file is mapped
+} RC_RINGBUF_RECORDER_T;
+
+
+#define RC_RINGBUF_RECORDER_INITIALIZER {\
+	.ring = RC_RINGBUF_INITIALIZER,\
+	.hdr = NULL,\
+	.map_len = 0,\
+	.initialized = 0}
+
+
+/**
+ * @brief      Maps a flight recorder file, creating it if it doesn't exist.
+ *
+ * An existing file must have been made with the same size, RINGBUF_TYPE and
+ * RC_RINGBUF_MIRROR setting and its samples are kept, so the buffer carries
+ * on from the last one recorded. If the last writer died partway through an
+ * insert that sample is dropped. A file of any other layout is left alone
+ * and this fails.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  path  the file
+ * @param[in]  size  Number of samples the buffer can hold, >=2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_RECORDER_FN(open)(RC_RINGBUF_RECORDER_T* buf, const char* path, int size)
+{
+	int fd, fresh;
+	struct stat st;
+	void* mem;
+	size_t bytes;
+	rc_ringbuf_recorder_header_t* h;
+	RC_RINGBUF_T ring = RC_RINGBUF_INITIALIZER;
+	// sanity checks
+	if(unlikely(buf==NULL || path==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2 || size>(1<<28))){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, size must be >=2 and <=2^28\n");
+		return -1;
+	}
+	if(unlikely(buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, buffer already open\n");
+		return -1;
+	}
+	bytes = RC_RINGBUF_RECORDER_DATA_OFF + RC_RINGBUF_STORAGE_LEN((size_t)size)*sizeof(RINGBUF_TYPE);
+	fd = open(path, O_CREAT|O_RDWR, 0644);
+	if(fd<0){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, can't open %s\n", path);
+		return -1;
+	}
+	if(fstat(fd, &st)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, fstat failed\n");
+		close(fd);
+		return -1;
+	}
+	fresh = (st.st_size==0);
+	if(!fresh && (size_t)st.st_size!=bytes){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, %s was made for another size or RINGBUF_TYPE\n", path);
+		close(fd);
+		return -1;
+	}
+	// reserve every block now, new or not. A sparse file would leave a
+	// full disk to show up as SIGBUS on some later insert instead of here.
+	// A new file comes back full of zeros.
+	if(posix_fallocate(fd, 0, (off_t)bytes)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, can't reserve %zu bytes for %s\n", bytes, path);
+		// leave no empty file behind to be taken for a recorder later
+		if(fresh) unlink(path);
+		close(fd);
+		return -1;
+	}
+	mem = mmap(NULL, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mem==MAP_FAILED){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, mmap failed\n");
+		return -1;
+	}
+	h = (rc_ringbuf_recorder_header_t*)mem;
+	if(fresh){
+		h->version = RC_RINGBUF_RECORDER_VERSION;
+		h->elem_size = sizeof(RINGBUF_TYPE);
+		h->data_off = RC_RINGBUF_RECORDER_DATA_OFF;
+		h->size = size;
+		h->len = RC_RINGBUF_STORAGE_LEN(size);
+		// last so a half made file is never taken for a real one
+		h->magic = RC_RINGBUF_RECORDER_MAGIC;
+	}
+	else if(h->magic!=RC_RINGBUF_RECORDER_MAGIC || h->version!=RC_RINGBUF_RECORDER_VERSION ||
+			h->elem_size!=sizeof(RINGBUF_TYPE) || h->data_off!=RC_RINGBUF_RECORDER_DATA_OFF ||
+			h->size!=size || h->len!=RC_RINGBUF_STORAGE_LEN(size) ||
+			h->index<0 || h->index>=size || h->count<0 || h->count>size ||
+			!__rc_ringbuf_recorder_torn_ok(h)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_open, %s was made for another size or RINGBUF_TYPE\n", path);
+		munmap(mem, bytes);
+		return -1;
+	}
+	// finish off an interrupted insert by dropping its sample, the next
+	// insert overwrites it
+	if(h->generation&1){
+		__rc_ringbuf_recorder_settle(h);
+		h->generation++;
+	}
+	ring.d = (RINGBUF_TYPE*)((char*)mem + RC_RINGBUF_RECORDER_DATA_OFF);
+	ring.size = size;
+	ring.index = h->index;
+	ring.count = h->count;
+	ring.user_mem = 1;
+	ring.initialized = 1;
+	buf->ring = ring;
+	buf->hdr = h;
+	buf->map_len = bytes;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Writes the file back to storage, blocking until it is done.
+ *
+ * Only needed for the samples to survive a kernel crash or power loss, a
+ * crashing process loses nothing without it. This is a system call which can
+ * take a while, so call it from a thread other than the one inserting.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_RECORDER_FN(sync)(RC_RINGBUF_RECORDER_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_sync, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_sync, buffer not open\n");
+		return -1;
+	}
+	if(msync(buf->hdr, buf->map_len, MS_SYNC)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_sync, msync failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief      Unmaps the file. Its samples stay in the file for the next
+ * rc_ringbuf_recorder_open or rc_ringbuf_recorder_recover.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_RECORDER_FN(close)(RC_RINGBUF_RECORDER_T* buf)
+{
+	RC_RINGBUF_RECORDER_T fresh = RC_RINGBUF_RECORDER_INITIALIZER;
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_close, received NULL pointer\n");
+		return -1;
+	}
+	if(buf->initialized) munmap(buf->hdr, buf->map_len);
+	*buf = fresh;
+	return 0;
+}
+
+/**
+ * @brief      Same as rc_ringbuf_recorder_insert but without any sanity
+ * checks.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be recorded
+ */
+static inline void RC_RINGBUF_RECORDER_FN(insert_unchecked)(RC_RINGBUF_RECORDER_T* buf, RINGBUF_TYPE val)
+{
+	rc_ringbuf_recorder_header_t* h = buf->hdr;
+	int w = buf->ring.index+1;
+	if(w>=buf->ring.size) w = 0;
+	// note the slot about to be torn and the count after, then mark the
+	// insert in progress. The fences keep each step's stores from moving
+	// into the next, within a step the order doesn't matter to recovery
+	h->writing = w;
+	h->writing_count = buf->ring.count<buf->ring.size ? buf->ring.count+1 : buf->ring.size;
+	atomic_thread_fence(memory_order_release);
+	h->generation++;
+	atomic_thread_fence(memory_order_release);
+	RC_RINGBUF_FN(insert_unchecked)(&buf->ring, val);
+	atomic_thread_fence(memory_order_release);
+	h->index = buf->ring.index;
+	h->count = buf->ring.count;
+	atomic_thread_fence(memory_order_release);
+	h->generation++;
+}
+
+/**
+ * @brief      Records a new value, booting out the oldest if full.
+ *
+ * Only stores into the mapped file, never a system call.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  val   The value to be recorded
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_RECORDER_FN(insert)(RC_RINGBUF_RECORDER_T* buf, RINGBUF_TYPE val)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_insert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_recorder_insert, buffer not open\n");
+		return -1;
+	}
+	RC_RINGBUF_RECORDER_FN(insert_unchecked)(buf, val);
+	return 0;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RC_RINGBUF_RECORDER_READER
@@ -0,0 +1,105 @@
+/**
+ * @file ring_buf_recover.c
+ *
+ * @brief      reads the samples back out of a flight recorder file
+ *
+ *             Prints the header of a file written through ring_buf_recorder.h
+ *             to stderr, then the samples oldest first to stdout. Works on
+ *             the file of a writer which crashed. Given a type the samples
+ *             are printed one per line as text, otherwise they are written
+ *             out as raw bytes for another program to parse.
+ *
+ *             gcc -O2 ring_buf_recover.c -o ring_buf_recover
+ *             ./ring_buf_recover <file> [double|float|int|int16|uint8]
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define RC_RINGBUF_RECORDER_READER
+#include "ring_buf_recorder.h"
+
+
+// element sizes of the types which can be printed as text
+static int type_size(const char* type)
+{
+	if(!strcmp(type, "double")) return sizeof(double);
+	if(!strcmp(type, "float")) return sizeof(float);
+	if(!strcmp(type, "int")) return sizeof(int);
+	if(!strcmp(type, "int16")) return sizeof(int16_t);
+	if(!strcmp(type, "uint8")) return sizeof(uint8_t);
+	return -1;
+}
+
+static void print_sample(const char* type, const char* p)
+{
+	double d;
+	float f;
+	int i;
+	int16_t s;
+	switch(type[0]){
+	case 'd':
+		memcpy(&d, p, sizeof(d));
+		printf("%.17g\n", d);
+		break;
+	case 'f':
+		memcpy(&f, p, sizeof(f));
+		printf("%.9g\n", f);
+		break;
+	case 'u':
+		printf("%u\n", (unsigned int)*(const uint8_t*)p);
+		break;
+	default:
+		if(!strcmp(type, "int16")){
+			memcpy(&s, p, sizeof(s));
+			printf("%d\n", s);
+		}
+		else{
+			memcpy(&i, p, sizeof(i));
+			printf("%d\n", i);
+		}
+	}
+	return;
+}
+
+int main(int argc, char* argv[])
+{
+	int i, n;
+	char* data;
+	const char* type = NULL;
+	rc_ringbuf_recorder_header_t hdr;
+
+	if(argc<2 || argc>3){
+		fprintf(stderr, "usage: %s <file> [double|float|int|int16|uint8]\n", argv[0]);
+		return 1;
+	}
+	if(argc==3){
+		type = argv[2];
+		if(type_size(type)<0){
+			fprintf(stderr, "unknown type %s\n", type);
+			return 1;
+		}
+	}
+
+	n = rc_ringbuf_recorder_recover(argv[1], &hdr, (void**)&data);
+	if(n<0) return 1;
+	fprintf(stderr, "size: %d samples of %u bytes, %d recorded, generation: %llu%s\n",
+		hdr.size, hdr.elem_size, n, (unsigned long long)hdr.generation,
+		(hdr.generation&1) ? ", writer died during an insert" : "");
+	if(type!=NULL && (unsigned)type_size(type)!=hdr.elem_size){
+		fprintf(stderr, "file holds %u byte samples, not %s\n", hdr.elem_size, type);
+		free(data);
+		return 1;
+	}
+
+	if(type==NULL) fwrite(data, hdr.elem_size, (size_t)n, stdout);
+	else for(i=0;i<n;i++) print_sample(type, &data[(size_t)i*hdr.elem_size]);
+
+	free(data);
+	return 0;
+}
@@ -0,0 +1,302 @@
+/**
+ * "ring_buf_soa.h"
+ *
+ * @brief      multi-channel ring buffer stored as one column per channel
+ *
+ * For samples with several channels, such as the 9 axes of an IMU, storing
+ * each sample as a struct in one ring interleaves the channels so a filter
+ * running over one axis strides through memory and uses a fraction of every
+ * cache line and SIMD register it loads. This buffer instead keeps each
+ * channel in its own contiguous column, every column starting on a cache
+ * line, with one index and count shared by all of them.
+ * rc_ringbuf_soa_insert scatters one sample of all channels into the columns.
+ *
+ * rc_ringbuf_soa_channel fills in an ordinary ring buffer struct which views
+ * one column, so everything in ring_buf.h which only reads, such as
+ * rc_ringbuf_get_value, rc_ringbuf_copy_ordered, rc_ringbuf_dot and with
+ * RC_RINGBUF_MIRROR rc_ringbuf_window, runs straight over the dense column.
+ * A view is a snapshot of the shared index and is only valid until the next
+ * insert, and must not be inserted into, reset or freed. With
+ * RC_RINGBUF_STATS or RC_RINGBUF_MEDIAN the views don't carry statistics or
+ * a sorted order, don't call those getters on them.
+ *
+ * This builds on ring_buf.h and uses its most recent instantiation, so
+ * include ring_buf.h first with the same RINGBUF_TYPE and RINGBUF_NAME, which
+ * is the type of every channel. With RINGBUF_NAME f32 the type is
+ * rc_ringbuf_soa_f32_t and the functions are rc_ringbuf_soa_f32_insert etc.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_RINGBUF_T
+#error "ERROR include ring_buf.h before ring_buf_soa.h"
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// columns start on this boundary in bytes
+#ifndef RC_RINGBUF_SOA_LINE
+#define RC_RINGBUF_SOA_LINE 64
+#endif
+
+// name mangling for this instantiation, see ring_buf.h
+#undef RC_RINGBUF_SOA_T
+#undef RC_RINGBUF_SOA_FN
+#ifdef RINGBUF_NAME
+#define RC_RINGBUF_SOA_T	__RC_RINGBUF_CAT(rc_ringbuf_soa_, RINGBUF_NAME, _t)
+#define RC_RINGBUF_SOA_FN(f)	__RC_RINGBUF_CAT(rc_ringbuf_soa_, RINGBUF_NAME, _##f)
+#else
+#define RC_RINGBUF_SOA_T	rc_ringbuf_soa_t
+#define RC_RINGBUF_SOA_FN(f)	rc_ringbuf_soa_##f
+#endif
+
+
+/**
+ * @brief      Struct containing state of a multi-channel ring buffer and
+ * pointer to dynamically allocated memory.
+ */
+typedef struct RC_RINGBUF_SOA_T {
+	RINGBUF_TYPE* d;	///< channels columns, stride elements apart
+	int size;	///< number of samples the buffer can hold
+	int channels;	///< number of values in each sample
+	int stride;	///< elements from the start of one column to the next
+	int index;	///< index of the most recently added sample in each column
+	int count;	///< number of samples inserted since alloc or reset, saturates at size
+	int initialized;///< flag indicating if memory has been allocated for the buffer
+} RC_RINGBUF_SOA_T;
+
+
+#define RC_RINGBUF_SOA_INITIALIZER {\
+	.d = NULL,\
+	.size = 0,\
+	.channels = 0,\
+	.stride = 0,\
+	.index = 0,\
+	.count = 0,\
+	.initialized = 0}
+
+
+/**
+ * @brief      Allocates memory for a multi-channel ring buffer.
+ *
+ * If buf is already the right shape then it is left untouched. Otherwise any
+ * existing memory allocated for buf is freed and new zero'd memory is
+ * allocated.
+ *
+ * @param      buf       Pointer to user's buffer
+ * @param[in]  channels  number of values in each sample, >=1
+ * @param[in]  size      number of samples to hold, >=2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(alloc)(RC_RINGBUF_SOA_T* buf, int channels, int size)
+{
+	int per_line, stride;
+	size_t align;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(channels<1 || size<2)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_alloc, channels must be >=1 and size >=2\n");
+		return -1;
+	}
+	// if it's already allocated, nothing to do
+	if(buf->initialized && buf->size==size && buf->channels==channels) return 0;
+	// pad each column out to whole cache lines so the next one starts on a line
+	stride = RC_RINGBUF_STORAGE_LEN(size);
+	if(RC_RINGBUF_SOA_LINE%sizeof(RINGBUF_TYPE)==0){
+		per_line = RC_RINGBUF_SOA_LINE/sizeof(RINGBUF_TYPE);
+		stride = ((stride+per_line-1)/per_line)*per_line;
+	}
+	align = RC_RINGBUF_ALIGN>RC_RINGBUF_SOA_LINE ? RC_RINGBUF_ALIGN : RC_RINGBUF_SOA_LINE;
+	free(buf->d);
+	buf->initialized = 0;
+	buf->d = (RINGBUF_TYPE*)__rc_buf_alloc((size_t)channels*stride, sizeof(RINGBUF_TYPE), align);
+	if(buf->d==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_alloc, failed to allocate memory\n");
+		return -1;
+	}
+	buf->size = size;
+	buf->channels = channels;
+	buf->stride = stride;
+	buf->index = 0;
+	buf->count = 0;
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Frees the memory allocated for buffer buf.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(free)(RC_RINGBUF_SOA_T* buf)
+{
+	RC_RINGBUF_SOA_T fresh = RC_RINGBUF_SOA_INITIALIZER;
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_soa_free, received NULL pointer\n");
+		return -1;
+	}
+	if(buf->initialized) free(buf->d);
+	*buf = fresh;
+	return 0;
+}
+
+/**
+ * @brief      Empties the buffer by setting the index and count back to 0.
+ * O(1), the old contents are left in memory, see rc_ringbuf_reset.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(reset)(RC_RINGBUF_SOA_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_soa_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_ringbuf_soa_reset, ringbuf uninitialized\n");
+		return -1;
+	}
+	buf->index = 0;
+	buf->count = 0;
+	return 0;
+}
+
+/**
+ * @brief      Same as rc_ringbuf_soa_insert but without any sanity checks.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  sample  array of one value per channel
+ */
+static inline void RC_RINGBUF_SOA_FN(insert_unchecked)(RC_RINGBUF_SOA_T* buf, const RINGBUF_TYPE* sample)
+{
+	int ch;
+	RINGBUF_TYPE* col;
+	// increment index and check for loop-around
+	int new_index = buf->index+1;
+	if(new_index>=buf->size) new_index=0;
+	col = &buf->d[new_index];
+	for(ch=0;ch<buf->channels;ch++){
+		col[0] = sample[ch];
+#ifdef RC_RINGBUF_MIRROR
+		col[buf->size] = sample[ch];
+#endif
+		col += buf->stride;
+	}
+	buf->index = new_index;
+	if(buf->count<buf->size) buf->count++;
+}
+
+/**
+ * @brief      Puts a new sample into the buffer, one value into each
+ * channel's column, booting out the oldest sample if full.
+ *
+ * @param      buf     Pointer to user's buffer
+ * @param[in]  sample  array of one value per channel
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(insert)(RC_RINGBUF_SOA_T* buf, const RINGBUF_TYPE* sample)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || sample==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_insert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_insert, ringbuf uninitialized\n");
+		return -1;
+	}
+	RC_RINGBUF_SOA_FN(insert_unchecked)(buf, sample);
+	return 0;
+}
+
+/**
+ * @brief      Fetches one channel's value 'position' steps behind the last
+ * sample added to the buffer.
+ *
+ * @param      buf       Pointer to user's buffer
+ * @param[in]  channel   channel to read, from 0 to channels-1
+ * @param[in]  position  steps back in the buffer to fetch the value from
+ * @param[out] value     set to the requested value
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(get_value)(RC_RINGBUF_SOA_T* buf, int channel, int position, RINGBUF_TYPE* value)
+{
+	int i;
+	// sanity checks
+	if(unlikely(buf==NULL || value==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_get_value, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_get_value, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(channel<0 || channel>=buf->channels || position<0 || position>buf->size-1)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_get_value, channel or position out of bounds\n");
+		return -1;
+	}
+	i = buf->index-position;
+	if(i<0) i+=buf->size;
+	*value = buf->d[channel*buf->stride+i];
+	return 0;
+}
+
+/**
+ * @brief      Fills in a ring buffer struct viewing one channel's column, to
+ * read it with the functions in ring_buf.h.
+ *
+ * The view shares the column's memory but holds a copy of the index, so it
+ * is only valid until the next insert. See the top of this file for what may
+ * be done with it.
+ *
+ * @param      buf      Pointer to user's buffer
+ * @param[in]  channel  channel to view, from 0 to channels-1
+ * @param[out] view     ring buffer struct to fill in
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_SOA_FN(channel)(RC_RINGBUF_SOA_T* buf, int channel, RC_RINGBUF_T* view)
+{
+	RC_RINGBUF_T v = RC_RINGBUF_INITIALIZER;
+	// sanity checks
+	if(unlikely(buf==NULL || view==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_channel, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_channel, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(channel<0 || channel>=buf->channels)){
+		fprintf(stderr,"ERROR in rc_ringbuf_soa_channel, channel out of bounds\n");
+		return -1;
+	}
+	v.d = &buf->d[channel*buf->stride];
+	v.size = buf->size;
+	v.index = buf->index;
+	v.count = buf->count;
+	v.user_mem = 1;
+	v.initialized = 1;
+	*view = v;
+	return 0;
+}
+
+
+#ifdef __cplusplus
+}
+#endif
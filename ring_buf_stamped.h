@@ -0,0 +1,324 @@
+/**
+ * "ring_buf_stamped.h"
+ *
+ * @brief      ring buffer of timestamped samples with lookup by time
+ *
+ * Delay compensation in sensor fusion needs the value of a signal at some
+ * time t in the recent past rather than some number of samples ago. This
+ * keeps an ordinary ring buffer of values with a parallel array of 64 bit
+ * timestamps sharing its index. Since the timestamps must never decrease, the
+ * samples either side of t are found by a binary search over positions which
+ * takes care of the wraparound, O(log n) instead of scanning back through
+ * the buffer, and rc_ringbuf_stamped_interpolate blends linearly between
+ * them.
+ *
+ * Lookup works for any RINGBUF_TYPE but blending needs arithmetic on it, so
+ * rc_ringbuf_stamped_interpolate is opt in. If RINGBUF_TYPE is a plain number
+ * type #define RC_RINGBUF_STAMPED_INTERPOLATE before including to blend in
+ * double. For any other type #define RC_RINGBUF_STAMPED_LERP(a, b, f) instead
+ * to an expression of type RINGBUF_TYPE which blends samples a and b by the
+ * double fraction f between 0 and 1, for example a per-member blend of a
+ * struct. Either one stays defined for later instantiations, #undef it along
+ * with RINGBUF_TYPE.
+ *
+ * The units of the timestamps are up to the user, typically nanoseconds from
+ * a monotonic clock such as rc_nanos_since_boot. Values are read by position
+ * with the usual rc_ringbuf_get_value and friends on the .ring member, the
+ * positions line up with rc_ringbuf_stamped_get_stamp and
+ * rc_ringbuf_stamped_find.
+ *
+ * This builds on ring_buf.h and uses its most recent instantiation, so
+ * include ring_buf.h first with the same RINGBUF_TYPE and RINGBUF_NAME. With
+ * RINGBUF_NAME f32 the type is rc_ringbuf_stamped_f32_t and the functions are
+ * rc_ringbuf_stamped_f32_insert etc.
+ *
+ * @author     James Strawson
+ * @date       2019
+ *
+ */
+
+#ifndef RC_RINGBUF_T
+#error "ERROR include ring_buf.h before ring_buf_stamped.h"
+#endif
+
+#include <stdint.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+// name mangling for this instantiation, see ring_buf.h
+#undef RC_RINGBUF_STAMPED_T
+#undef RC_RINGBUF_STAMPED_FN
+#undef RC_RINGBUF_STAMPED_PRIV
+#ifdef RINGBUF_NAME
+#define RC_RINGBUF_STAMPED_T	__RC_RINGBUF_CAT(rc_ringbuf_stamped_, RINGBUF_NAME, _t)
+#define RC_RINGBUF_STAMPED_FN(f)	__RC_RINGBUF_CAT(rc_ringbuf_stamped_, RINGBUF_NAME, _##f)
+#define RC_RINGBUF_STAMPED_PRIV(f)	__RC_RINGBUF_CAT(__rc_ringbuf_stamped_, RINGBUF_NAME, _##f)
+#else
+#define RC_RINGBUF_STAMPED_T	rc_ringbuf_stamped_t
+#define RC_RINGBUF_STAMPED_FN(f)	rc_ringbuf_stamped_##f
+#define RC_RINGBUF_STAMPED_PRIV(f)	__rc_ringbuf_stamped_##f
+#endif
+
+
+/**
+ * @brief      Struct containing state of a timestamped ring buffer.
+ */
+typedef struct RC_RINGBUF_STAMPED_T {
+	RC_RINGBUF_T ring;	///< the values, read with the ring_buf.h getters
+	uint64_t* t;	///< timestamp of each value, indexed the same as ring.d
+	int initialized;///< flag indicating if memory has been allocated for the buffer
+} RC_RINGBUF_STAMPED_T;
+
+
+#define RC_RINGBUF_STAMPED_INITIALIZER {\
+	.ring = RC_RINGBUF_INITIALIZER,\
+	.t = NULL,\
+	.initialized = 0}
+
+
+/**
+ * @brief      Frees the memory allocated for a timestamped buffer.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(free)(RC_RINGBUF_STAMPED_T* buf)
+{
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_stamped_free, received NULL pointer\n");
+		return -1;
+	}
+	RC_RINGBUF_FN(free)(&buf->ring);
+	free(buf->t);
+	buf->t = NULL;
+	buf->initialized = 0;
+	return 0;
+}
+
+/**
+ * @brief      Allocates memory for a timestamped ring buffer.
+ *
+ * If buf is already the right size then it is left untouched. Otherwise any
+ * existing memory allocated for buf is freed and new zero'd memory is
+ * allocated.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  size  Number of samples the buffer can hold, >=2
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(alloc)(RC_RINGBUF_STAMPED_T* buf, int size)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_alloc, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(size<2)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_alloc, size must be >=2\n");
+		return -1;
+	}
+	// if it's already allocated, nothing to do
+	if(buf->initialized && buf->ring.size==size) return 0;
+	RC_RINGBUF_STAMPED_FN(free)(buf);
+	if(RC_RINGBUF_FN(alloc)(&buf->ring, size)) return -1;
+	buf->t = (uint64_t*)__rc_buf_alloc(size, sizeof(uint64_t), 0);
+	if(buf->t==NULL){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_alloc, failed to allocate memory\n");
+		RC_RINGBUF_FN(free)(&buf->ring);
+		return -1;
+	}
+	buf->initialized = 1;
+	return 0;
+}
+
+/**
+ * @brief      Empties the buffer, see rc_ringbuf_reset.
+ *
+ * @param      buf   Pointer to user's buffer
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(reset)(RC_RINGBUF_STAMPED_T* buf)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr, "ERROR in rc_ringbuf_stamped_reset, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR rc_ringbuf_stamped_reset, ringbuf uninitialized\n");
+		return -1;
+	}
+	return RC_RINGBUF_FN(reset)(&buf->ring);
+}
+
+/**
+ * @brief      Puts a new value and its timestamp into the buffer, booting out
+ * the oldest if full.
+ *
+ * Timestamps must not go backwards, an insert older than the newest sample
+ * is rejected.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[in]  t      timestamp of the new value
+ * @param[in]  val    The value to be inserted
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(insert)(RC_RINGBUF_STAMPED_T* buf, uint64_t t, RINGBUF_TYPE val)
+{
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_insert, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_insert, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(buf->ring.count>0 && t<buf->t[buf->ring.index])){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_insert, timestamp went backwards\n");
+		return -1;
+	}
+	RC_RINGBUF_FN(insert_unchecked)(&buf->ring, val);
+	buf->t[buf->ring.index] = t;
+	return 0;
+}
+
+// timestamp of the sample position steps behind the newest
+static inline uint64_t RC_RINGBUF_STAMPED_PRIV(stamp)(RC_RINGBUF_STAMPED_T* buf, int position)
+{
+	int i = buf->ring.index-position;
+	if(i<0) i+=buf->ring.size;
+	return buf->t[i];
+}
+
+/**
+ * @brief      Fetches the timestamp of the sample 'position' steps behind
+ * the newest.
+ *
+ * @param      buf       Pointer to user's buffer
+ * @param[in]  position  steps back in the buffer, less than the count
+ * @param[out] t         set to the timestamp
+ *
+ * @return     Returns 0 on success or -1 on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(get_stamp)(RC_RINGBUF_STAMPED_T* buf, int position, uint64_t* t)
+{
+	// sanity checks
+	if(unlikely(buf==NULL || t==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_get_stamp, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_get_stamp, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(unlikely(position<0 || position>=buf->ring.count)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_get_stamp, position out of bounds\n");
+		return -1;
+	}
+	*t = RC_RINGBUF_STAMPED_PRIV(stamp)(buf, position);
+	return 0;
+}
+
+/**
+ * @brief      Finds the newest sample stamped at or before time t by binary
+ * search.
+ *
+ * A t newer than every sample gives position 0. A t older than every sample,
+ * or an empty buffer, is not an error but returns -1 without printing.
+ *
+ * @param      buf   Pointer to user's buffer
+ * @param[in]  t     time to look up
+ *
+ * @return     Returns the position of the sample, steps behind the newest, or
+ * -1 if there is none or on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(find)(RC_RINGBUF_STAMPED_T* buf, uint64_t t)
+{
+	int lo, hi, mid;
+	// sanity checks
+	if(unlikely(buf==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_find, received NULL pointer\n");
+		return -1;
+	}
+	if(unlikely(!buf->initialized)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_find, ringbuf uninitialized\n");
+		return -1;
+	}
+	if(buf->ring.count==0) return -1;
+	if(RC_RINGBUF_STAMPED_PRIV(stamp)(buf, buf->ring.count-1)>t) return -1;
+	// stamps decrease with position, find the first position at or before t
+	lo = 0;
+	hi = buf->ring.count-1;
+	while(lo<hi){
+		mid = lo+(hi-lo)/2;
+		if(RC_RINGBUF_STAMPED_PRIV(stamp)(buf, mid)<=t) hi = mid;
+		else lo = mid+1;
+	}
+	return lo;
+}
+
+#if defined(RC_RINGBUF_STAMPED_INTERPOLATE) || defined(RC_RINGBUF_STAMPED_LERP)
+/**
+ * @brief      Fetches the value at time t, linearly interpolated between the
+ * samples either side of it.
+ *
+ * Only available when RC_RINGBUF_STAMPED_INTERPOLATE or
+ * RC_RINGBUF_STAMPED_LERP is defined. t must lie between the oldest and newest
+ * timestamps inclusive, the value is never extrapolated. Out of range is not
+ * an error but returns -1 without printing. Without a user
+ * RC_RINGBUF_STAMPED_LERP the interpolation is done in double, for integer
+ * RINGBUF_TYPEs the result is truncated back to the type.
+ *
+ * @param      buf    Pointer to user's buffer
+ * @param[in]  t      time to look up
+ * @param[out] value  set to the interpolated value
+ *
+ * @return     Returns 0 on success or -1 if t is out of range or on failure.
+ */
+static inline int RC_RINGBUF_STAMPED_FN(interpolate)(RC_RINGBUF_STAMPED_T* buf, uint64_t t, RINGBUF_TYPE* value)
+{
+	int p;
+	uint64_t t0, t1;
+	double f;
+#ifndef RC_RINGBUF_STAMPED_LERP
+	double v0, v1;
+#endif
+	if(unlikely(value==NULL)){
+		fprintf(stderr,"ERROR in rc_ringbuf_stamped_interpolate, received NULL pointer\n");
+		return -1;
+	}
+	p = RC_RINGBUF_STAMPED_FN(find)(buf, t);
+	if(p<0) return -1;
+	t0 = RC_RINGBUF_STAMPED_PRIV(stamp)(buf, p);
+	if(t0==t){
+		*value = RC_RINGBUF_FN(get_value_unchecked)(&buf->ring, p);
+		return 0;
+	}
+	// newer than the newest sample
+	if(p==0) return -1;
+	// find returned the first position at or before t so t0 < t < t1
+	t1 = RC_RINGBUF_STAMPED_PRIV(stamp)(buf, p-1);
+	f = (double)(t-t0)/(double)(t1-t0);
+#ifdef RC_RINGBUF_STAMPED_LERP
+	*value = RC_RINGBUF_STAMPED_LERP(RC_RINGBUF_FN(get_value_unchecked)(&buf->ring, p),
+				RC_RINGBUF_FN(get_value_unchecked)(&buf->ring, p-1), f);
+#else
+	v0 = RC_RINGBUF_FN(get_value_unchecked)(&buf->ring, p);
+	v1 = RC_RINGBUF_FN(get_value_unchecked)(&buf->ring, p-1);
+	*value = (RINGBUF_TYPE)(v0+(v1-v0)*f);
+#endif
+	return 0;
+}
+#endif
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,852 @@
+/**
+ * @file test_buf_fuzz.c
+ *
+ * @brief      randomized model check and threaded stress test of the buffers
+ *
+ *             Drives rc_fifobuf_t and rc_ringbuf_t with long random
+ *             sequences of every operation, single and bulk, on random
+ *             sizes, and after each one compares what came out against a
+ *             reference deque which is simple enough to trust. Fifo rounds
+ *             mix push, push_n, pop, pop_n, pop_ptr, reserve/commit,
+ *             peek/release, reset and the overwrite and growth modes. Ring
+ *             rounds mix insert, insert_n, the getters, copy_ordered,
+ *             copy_decimated and reset, along with window, the running
+ *             statistics, the median and the counters when those are
+ *             compiled in. A failure prints the seed, round and operation
+ *             so it can be replayed.
+ *
+ *             Then it stresses the spsc fifo with and without batching and
+ *             the mpmc fifo with several producers and consumers, checking
+ *             nothing is lost, duplicated or reordered. The spsc fifo also
+ *             runs in overwrite mode, where entries may be lost but only as
+ *             many as it counts as dropped. The run fails if any of
+ *             them moves fewer than STRESS_MIN_RATE entries per second so a
+ *             slow path shows up as a failed run rather than going unseen.
+ *             The stress runs are meant to also be clean under
+ *             -fsanitize=thread, lower STRESS_MIN_RATE for that.
+ *
+ *             Run it once per combination of compile time options of
+ *             interest, for example:
+ *
+ *             gcc -O2 -pthread test_buf_fuzz.c -o test_buf_fuzz
+ *             gcc -O2 -pthread -DRC_FIFOBUF_POW2 -DRC_RINGBUF_MIRROR \
+ *                 -DRC_RINGBUF_STATS -DRC_RINGBUF_MEDIAN -DRC_BUF_COUNTERS \
+ *                 test_buf_fuzz.c -o test_buf_fuzz
+ *             gcc -O1 -g -pthread -fsanitize=thread -DSTRESS_MIN_RATE=1000 \
+ *                 test_buf_fuzz.c -o test_buf_fuzz
+ *             ./test_buf_fuzz [rounds] [seed] [stress_entries]
+ *
+ *             rounds of 0 skips the model check and stress_entries of 0
+ *             skips the stress test.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define FIFOBUF_TYPE int
+#include "fifo_buf.h"
+#include "fifo_buf_spsc.h"
+#include "fifo_buf_mpmc.h"
+#define RINGBUF_TYPE int
+#include "ring_buf.h"
+
+
+#define ROUNDS		2000	// default number of buffers to model check
+#define OPS		300	// operations per round
+#define MAX_SIZE	40	// largest size a round starts with
+#define MAX_GROWTH	8	// growable fifos may reach MAX_SIZE*MAX_GROWTH
+#define MAX_N		(2*MAX_SIZE*MAX_GROWTH+3)	// largest bulk operation
+#define MODEL_LEN	4096	// power of two above MAX_SIZE*MAX_GROWTH
+
+#define STRESS_ENTRIES	(1<<20)	// default entries passed per stress run
+#define SPSC_SIZE	1024
+#define MPMC_SIZE	64
+#define MPMC_THREADS	4
+#ifndef STRESS_MIN_RATE
+#define STRESS_MIN_RATE	100000	// entries per second every stress run must beat
+#endif
+
+static unsigned int rng;
+static unsigned int seed;
+static int round_num, op_num;
+static int errors;
+
+#define CHECK(cond, ...) do{\
+	if(!(cond)){\
+		if(errors<10){\
+			printf("FAIL seed %u round %d op %d: ", seed, round_num, op_num);\
+			printf(__VA_ARGS__);\
+			printf("\n");\
+		}\
+		errors++;\
+	}\
+}while(0)
+
+// xorshift32, the same seed always replays the same sequence
+static unsigned int rnd(unsigned int n)
+{
+	rng ^= rng<<13;
+	rng ^= rng>>17;
+	rng ^= rng<<5;
+	return rng%n;
+}
+
+
+/*
+ * The reference deque, a plain array indexed by free-running counters. It
+ * never fills since no buffer under test holds MODEL_LEN entries.
+ */
+static int model[MODEL_LEN];
+static unsigned int m_head, m_tail;
+
+static int m_count(void)
+{
+	return (int)(m_head-m_tail);
+}
+
+static void m_push(int v)
+{
+	model[m_head++ & (MODEL_LEN-1)] = v;
+}
+
+static int m_pop(void)
+{
+	return model[m_tail++ & (MODEL_LEN-1)];
+}
+
+// i-th oldest entry
+static int m_at(int i)
+{
+	return model[(m_tail+i) & (MODEL_LEN-1)];
+}
+
+static void m_clear(void)
+{
+	m_head = 0;
+	m_tail = 0;
+}
+
+
+/*
+ * What the fifo under test should be doing besides its contents, worked out
+ * independently from the documented behavior of each call.
+ */
+static struct fifo_model_t {
+	int size;
+	int overwrite;
+	int max_size;
+	int min_size;
+	int shrink_after;
+	int low_water;
+	long dropped;
+	rc_buf_counters_t counters;
+} mf;
+
+static void mf_peak(void)
+{
+	if((uint64_t)m_count()>mf.counters.peak) mf.counters.peak = m_count();
+}
+
+// a growable fifo doubles until n more fit or it reaches max_size
+static int mf_grow(int n)
+{
+	int count = m_count();
+	int need;
+	if(mf.max_size<=mf.size) return mf.size-count;
+	need = (n > mf.max_size-count) ? mf.max_size : count+n;
+	while(mf.size<need) mf.size = (mf.size > mf.max_size/2) ? mf.max_size : mf.size*2;
+	mf.low_water = 0;
+	return mf.size-count;
+}
+
+// and halves after shrink_after pops in a row find it under a quarter full
+static void mf_shrink(void)
+{
+	int half = mf.size/2;
+	if(!mf.shrink_after) return;
+	if(half<mf.min_size) half = mf.min_size;
+	if(half==mf.size || m_count() > mf.size/4){
+		mf.low_water = 0;
+		return;
+	}
+	if(++mf.low_water < mf.shrink_after) return;
+	mf.size = half;
+	mf.low_water = 0;
+}
+
+// makes room for n entries the way a push does, returns how many it may push
+static int mf_make_room(int n, int* rejected)
+{
+	int space = mf.size-m_count();
+	*rejected = 0;
+	if(n>space) space = mf_grow(n);
+	if(n<=space) return n;
+	if(!mf.overwrite){
+		*rejected = n-space;
+		return space;
+	}
+	return n;
+}
+
+static void check_span(rc_fifobuf_span_t* span, int n, rc_fifobuf_t* buf)
+{
+	int i;
+	FIFOBUF_TYPE* end = buf->d + RC_FIFOBUF_STORAGE_LEN(buf->size);
+	CHECK(span->len[0]>=0 && span->len[1]>=0 && span->len[0]+span->len[1]==n,
+		"span lengths %d+%d for %d entries", span->len[0], span->len[1], n);
+	CHECK(span->len[1]==0 || span->d[1]==buf->d, "second segment doesn't start at d");
+	for(i=0;i<2;i++){
+		CHECK(span->len[i]==0 || (span->d[i]>=buf->d && span->d[i]+span->len[i]<=end),
+			"segment %d outside the buffer's memory", i);
+	}
+}
+
+static void fifo_round(void)
+{
+	static FIFOBUF_TYPE storage[RC_FIFOBUF_STORAGE_LEN(MAX_SIZE)];
+	static FIFOBUF_TYPE src[MAX_N], dst[MAX_N];
+	rc_fifobuf_t buf = RC_FIFOBUF_INITIALIZER;
+	rc_fifobuf_span_t span;
+	FIFOBUF_TYPE val = 0, *ptr = NULL;
+	int i, n, k, ret, rejected, skip;
+	int seq = 0;
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters = {0};
+#endif
+
+	memset(&mf, 0, sizeof(mf));
+	m_clear();
+	mf.size = 2+rnd(MAX_SIZE-1);
+	if(rnd(4)==0) ret = rc_fifobuf_init_static(&buf, storage, mf.size);
+	else ret = rc_fifobuf_alloc(&buf, mf.size);
+	CHECK(ret==0, "setting up a buffer of size %d returned %d", mf.size, ret);
+	if(rnd(2)){
+		mf.overwrite = 1;
+		rc_fifobuf_set_overwrite(&buf, 1);
+	}
+	if(rnd(3)==0){
+		mf.max_size = mf.size*(1+rnd(MAX_GROWTH));
+		mf.min_size = mf.size;
+		mf.shrink_after = rnd(2) ? 1+rnd(8) : 0;
+		rc_fifobuf_set_growth(&buf, mf.max_size, mf.shrink_after);
+	}
+
+	for(op_num=0;op_num<OPS;op_num++){
+		switch(rnd(12)){
+		case 0:
+			val = seq++;
+			if(m_count()==mf.size && mf_grow(1)==0){
+				if(!mf.overwrite){
+					mf.counters.rejected++;
+					ret = rc_fifobuf_push(&buf, val);
+					CHECK(ret==-1, "push to a full buffer returned %d", ret);
+					break;
+				}
+				m_pop();
+				mf.dropped++;
+				mf.counters.overwrites++;
+			}
+			ret = rc_fifobuf_push(&buf, val);
+			CHECK(ret==0, "push returned %d", ret);
+			m_push(val);
+			mf.counters.pushes++;
+			mf_peak();
+			break;
+		case 1:
+			if(m_count()==mf.size) break;
+			val = seq++;
+			rc_fifobuf_push_unchecked(&buf, val);
+			m_push(val);
+			mf.counters.pushes++;
+			mf_peak();
+			break;
+		case 2:
+			ret = rc_fifobuf_pop(&buf, &val);
+			if(m_count()==0){
+				CHECK(ret==-1, "pop of an empty buffer returned %d", ret);
+				break;
+			}
+			k = m_pop();
+			CHECK(ret==0 && val==k, "pop returned %d with %d, expected %d", ret, val, k);
+			mf.counters.pops++;
+			mf_shrink();
+			break;
+		case 3:
+			if(m_count()==0) break;
+			val = rc_fifobuf_pop_unchecked(&buf);
+			k = m_pop();
+			CHECK(val==k, "pop_unchecked returned %d, expected %d", val, k);
+			mf.counters.pops++;
+			break;
+		case 4:
+			ret = rc_fifobuf_pop_ptr(&buf, &ptr);
+			if(m_count()==0){
+				CHECK(ret==-1, "pop_ptr of an empty buffer returned %d", ret);
+				break;
+			}
+			k = m_pop();
+			CHECK(ret==0 && *ptr==k, "pop_ptr returned %d pointing at %d, expected %d",
+				ret, ret==0 ? *ptr : 0, k);
+			mf.counters.pops++;
+			break;
+		case 5:
+			n = rnd(rnd(4) ? 2*mf.size+2 : MAX_N);
+			for(i=0;i<n;i++) src[i] = seq+i;
+			seq += n;
+			k = mf_make_room(n, &rejected);
+			mf.counters.rejected += rejected;
+			skip = 0;
+			if(mf.overwrite && k>mf.size-m_count()){
+				// older entries of src are overwritten by its own newer ones
+				if(k>mf.size){
+					skip = k-mf.size;
+					k = mf.size;
+				}
+				i = k-(mf.size-m_count());
+				mf.dropped += i+skip;
+				mf.counters.overwrites += i+skip;
+				while(i-- > 0) m_pop();
+			}
+			ret = rc_fifobuf_push_n(&buf, src, n);
+			CHECK(ret==k+skip, "push_n of %d returned %d, expected %d", n, ret, k+skip);
+			for(i=0;i<k;i++) m_push(src[skip+i]);
+			mf.counters.pushes += k+skip;
+			if(k) mf_peak();
+			break;
+		case 6:
+			n = rnd(rnd(4) ? 2*mf.size+2 : MAX_N);
+			k = n<m_count() ? n : m_count();
+			ret = rc_fifobuf_pop_n(&buf, dst, n);
+			CHECK(ret==k, "pop_n of %d returned %d, expected %d", n, ret, k);
+			for(i=0;i<k;i++){
+				val = m_pop();
+				CHECK(dst[i]==val, "pop_n entry %d is %d, expected %d", i, dst[i], val);
+			}
+			mf.counters.pops += k;
+			if(k) mf_shrink();
+			break;
+		case 7:
+			n = rnd(rnd(4) ? 2*mf.size+2 : MAX_N);
+			k = mf_make_room(n, &rejected);
+			if(k>mf.size-m_count()) k = mf.size-m_count();
+			ret = rc_fifobuf_reserve(&buf, n, &span);
+			CHECK(ret==k, "reserve of %d returned %d, expected %d", n, ret, k);
+			if(ret!=k) break;
+			check_span(&span, k, &buf);
+			for(i=0;i<span.len[0];i++) span.d[0][i] = seq+i;
+			for(i=0;i<span.len[1];i++) span.d[1][i] = seq+span.len[0]+i;
+			n = rnd(k+1);
+			ret = rc_fifobuf_commit(&buf, n);
+			CHECK(ret==0, "commit of %d returned %d", n, ret);
+			for(i=0;i<n;i++) m_push(seq+i);
+			seq += n;
+			mf.counters.pushes += n;
+			mf_peak();
+			break;
+		case 8:
+			n = rnd(2*mf.size+2);
+			k = n<m_count() ? n : m_count();
+			ret = rc_fifobuf_peek(&buf, n, &span);
+			CHECK(ret==k, "peek of %d returned %d, expected %d", n, ret, k);
+			if(ret!=k) break;
+			check_span(&span, k, &buf);
+			for(i=0;i<k;i++){
+				val = i<span.len[0] ? span.d[0][i] : span.d[1][i-span.len[0]];
+				CHECK(val==m_at(i), "peek entry %d is %d, expected %d", i, val, m_at(i));
+			}
+			n = rnd(k+1);
+			ret = rc_fifobuf_release(&buf, n);
+			CHECK(ret==0, "release of %d returned %d", n, ret);
+			for(i=0;i<n;i++) m_pop();
+			mf.counters.pops += n;
+			mf_shrink();
+			break;
+		case 9:
+			if(rnd(10)) break;
+			rc_fifobuf_reset(&buf);
+			m_clear();
+			mf.dropped = 0;
+			mf.low_water = 0;
+			memset(&mf.counters, 0, sizeof(mf.counters));
+			break;
+		case 10:
+			if(rnd(10)) break;
+			mf.overwrite = !mf.overwrite;
+			rc_fifobuf_set_overwrite(&buf, mf.overwrite);
+			break;
+		default:
+			ret = rc_fifobuf_available(&buf);
+			CHECK(ret==m_count(), "available returned %d, expected %d", ret, m_count());
+		}
+
+		// state which every operation has to keep right
+		CHECK(buf.size==mf.size, "size is %d, expected %d", buf.size, mf.size);
+		CHECK(rc_fifobuf_available(&buf)==m_count(), "available is %d, expected %d",
+			rc_fifobuf_available(&buf), m_count());
+		CHECK(rc_fifobuf_dropped(&buf)==mf.dropped, "dropped is %ld, expected %ld",
+			rc_fifobuf_dropped(&buf), mf.dropped);
+#ifdef RC_BUF_COUNTERS
+		rc_fifobuf_counters(&buf, &counters);
+		CHECK(!memcmp(&counters, &mf.counters, sizeof(counters)),
+			"counters pushes %llu pops %llu rejected %llu overwrites %llu peak %llu,"
+			" expected %llu %llu %llu %llu %llu",
+			(unsigned long long)counters.pushes, (unsigned long long)counters.pops,
+			(unsigned long long)counters.rejected, (unsigned long long)counters.overwrites,
+			(unsigned long long)counters.peak,
+			(unsigned long long)mf.counters.pushes, (unsigned long long)mf.counters.pops,
+			(unsigned long long)mf.counters.rejected, (unsigned long long)mf.counters.overwrites,
+			(unsigned long long)mf.counters.peak);
+#endif
+		if(errors>=10) break;
+	}
+
+	// whatever is left must come out in order
+	while(m_count()){
+		k = m_pop();
+		ret = rc_fifobuf_pop(&buf, &val);
+		CHECK(ret==0 && val==k, "draining popped %d, expected %d", val, k);
+	}
+	CHECK(rc_fifobuf_pop(&buf, &val)==-1, "drained buffer not empty");
+	rc_fifobuf_free(&buf);
+}
+
+
+/*
+ * The ring's reference is the values inserted since the last reset, newest
+ * first. Positions beyond them hold zeros after alloc, or after a reset in
+ * the modes which wipe the data, otherwise they hold stale values which
+ * aren't checked.
+ */
+static int hist[MAX_SIZE];
+static int h_count;
+static int h_wiped;
+
+static void h_insert(int size, int v)
+{
+	memmove(&hist[1], &hist[0], (size-1)*sizeof(int));
+	hist[0] = v;
+	if(h_count<size) h_count++;
+}
+
+static int h_known(int pos)
+{
+	return pos<h_count || h_wiped;
+}
+
+static int ring_value(void)
+{
+	// mostly a few distinct values so the statistics see plenty of ties
+	if(rnd(2)) return (int)rnd(8)-4;
+	return (int)rnd(2000001)-1000000;
+}
+
+#ifdef RC_RINGBUF_MEDIAN
+static int cmp_int(const void* a, const void* b)
+{
+	int x = *(const int*)a, y = *(const int*)b;
+	return (x>y)-(x<y);
+}
+#endif
+
+static void ring_stats(rc_ringbuf_t* buf, int size)
+{
+#ifdef RC_RINGBUF_STATS
+	int i, lo = 0, hi = 0, min, max;
+	double sum = 0.0, sumsq = 0.0, got = 0.0, var;
+	for(i=0;i<size;i++){
+		sum += hist[i];
+		sumsq += (double)hist[i]*hist[i];
+	}
+	min = max = hist[0];
+	for(i=1;i<size;i++){
+		if(hist[i]<min) min = hist[i];
+		if(hist[i]>max) max = hist[i];
+	}
+	rc_ringbuf_sum(buf, &got);
+	CHECK(got==sum, "sum is %g, expected %g", got, sum);
+	rc_ringbuf_mean(buf, &got);
+	CHECK(got==sum/size, "mean is %g, expected %g", got, sum/size);
+	rc_ringbuf_variance(buf, &got);
+	var = sumsq/size-(sum/size)*(sum/size);
+	if(var<0.0) var = 0.0;
+	CHECK(got-var<1e-6*(1.0+var) && var-got<1e-6*(1.0+var),
+		"variance is %g, expected %g", got, var);
+	rc_ringbuf_min(buf, &lo);
+	rc_ringbuf_max(buf, &hi);
+	CHECK(lo==min && hi==max, "min/max are %d/%d, expected %d/%d", lo, hi, min, max);
+#endif
+#ifdef RC_RINGBUF_MEDIAN
+	int sorted[MAX_SIZE], k;
+	double p, rank, want, med = 0.0;
+	memcpy(sorted, hist, size*sizeof(int));
+	qsort(sorted, size, sizeof(int), cmp_int);
+	rc_ringbuf_median(buf, &med);
+	want = (size&1) ? sorted[size/2] : ((double)sorted[size/2-1]+sorted[size/2])/2.0;
+	CHECK(med==want, "median is %g, expected %g", med, want);
+	p = rnd(1001)/10.0;
+	rank = p*(size-1)/100.0;
+	k = (int)rank;
+	want = sorted[k];
+	if(rank>k) want += (rank-k)*((double)sorted[k+1]-sorted[k]);
+	rc_ringbuf_percentile(buf, p, &med);
+	CHECK(med-want<1e-6 && want-med<1e-6, "percentile %g is %g, expected %g", p, med, want);
+#endif
+	(void)buf;
+	(void)size;
+}
+
+static void ring_round(void)
+{
+	static RINGBUF_TYPE src[MAX_N], dst[MAX_SIZE];
+	rc_ringbuf_t buf = RC_RINGBUF_INITIALIZER;
+	RINGBUF_TYPE val = 0, *ptr = NULL;
+	int i, n, k, stride, order, ret;
+	int size = 2+rnd(MAX_SIZE-1);
+	uint64_t inserts = 0;
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters = {0};
+#endif
+
+	memset(hist, 0, sizeof(hist));
+	h_count = 0;
+	h_wiped = 1;
+	ret = rc_ringbuf_alloc(&buf, size);
+	CHECK(ret==0, "alloc of size %d returned %d", size, ret);
+
+	for(op_num=0;op_num<OPS;op_num++){
+		switch(rnd(10)){
+		case 0:
+			val = ring_value();
+			rc_ringbuf_insert(&buf, val);
+			h_insert(size, val);
+			inserts++;
+			break;
+		case 1:
+			val = ring_value();
+			rc_ringbuf_insert_unchecked(&buf, val);
+			h_insert(size, val);
+			inserts++;
+			break;
+		case 2:
+			n = rnd(rnd(4) ? size+2 : 3*size);
+			for(i=0;i<n;i++) src[i] = ring_value();
+			ret = rc_ringbuf_insert_n(&buf, src, n);
+			CHECK(ret==0, "insert_n of %d returned %d", n, ret);
+			for(i=0;i<n;i++) h_insert(size, src[i]);
+			inserts += n;
+			break;
+		case 3:
+			i = rnd(size);
+			if(!h_known(i)) break;
+			ret = rc_ringbuf_get_value(&buf, i, &val);
+			CHECK(ret==0 && val==hist[i], "get_value %d returned %d with %d, expected %d",
+				i, ret, val, hist[i]);
+			val = rc_ringbuf_get_value_unchecked(&buf, i);
+			CHECK(val==hist[i], "get_value_unchecked %d is %d, expected %d", i, val, hist[i]);
+			ret = rc_ringbuf_get_value_ptr(&buf, i, &ptr);
+			CHECK(ret==0 && *ptr==hist[i], "get_value_ptr %d points at %d, expected %d",
+				i, ret==0 ? *ptr : 0, hist[i]);
+			break;
+		case 4:
+			n = rnd(size+1);
+			if(n && !h_known(n-1)) n = h_count;
+			order = rnd(2) ? RC_RINGBUF_OLDEST_FIRST : RC_RINGBUF_NEWEST_FIRST;
+			ret = rc_ringbuf_copy_ordered(&buf, dst, n, order);
+			CHECK(ret==0, "copy_ordered of %d returned %d", n, ret);
+			for(i=0;i<n;i++){
+				k = order==RC_RINGBUF_NEWEST_FIRST ? i : n-1-i;
+				CHECK(dst[i]==hist[k], "copy_ordered of %d order %d entry %d is %d, expected %d",
+					n, order, i, dst[i], hist[k]);
+			}
+			break;
+		case 5:
+			stride = 1+rnd(size);
+			n = rnd((size-1)/stride+2);
+			if(n && !h_known((n-1)*stride)) break;
+			order = rnd(2) ? RC_RINGBUF_OLDEST_FIRST : RC_RINGBUF_NEWEST_FIRST;
+			ret = rc_ringbuf_copy_decimated(&buf, dst, n, stride, order);
+			CHECK(ret==0, "copy_decimated of %d stride %d returned %d", n, stride, ret);
+			for(i=0;i<n;i++){
+				k = (order==RC_RINGBUF_NEWEST_FIRST ? i : n-1-i)*stride;
+				CHECK(dst[i]==hist[k], "copy_decimated of %d stride %d entry %d is %d, expected %d",
+					n, stride, i, dst[i], hist[k]);
+			}
+			break;
+		case 6:
+#ifdef RC_RINGBUF_MIRROR
+			ret = rc_ringbuf_window(&buf, &ptr);
+			CHECK(ret==0, "window returned %d", ret);
+			for(i=0;i<size;i++){
+				if(!h_known(i)) continue;
+				CHECK(ptr[size-1-i]==hist[i], "window position %d is %d, expected %d",
+					i, ptr[size-1-i], hist[i]);
+			}
+#endif
+			break;
+		case 7:
+			if(rnd(10)) break;
+			rc_ringbuf_reset(&buf);
+			h_count = 0;
+			inserts = 0;
+#if defined(RC_RINGBUF_STATS) || defined(RC_RINGBUF_MEDIAN)
+			memset(hist, 0, sizeof(hist));
+#else
+			h_wiped = 0;
+#endif
+			break;
+		default:
+			ring_stats(&buf, size);
+		}
+
+		ret = rc_ringbuf_count(&buf);
+		CHECK(ret==h_count, "count is %d, expected %d", ret, h_count);
+#ifdef RC_BUF_COUNTERS
+		rc_ringbuf_counters(&buf, &counters);
+		CHECK(counters.pushes==inserts && counters.overwrites==inserts-h_count,
+			"counters %llu inserts %llu overwrites, expected %llu %llu",
+			(unsigned long long)counters.pushes, (unsigned long long)counters.overwrites,
+			(unsigned long long)inserts, (unsigned long long)(inserts-h_count));
+#endif
+		if(errors>=10) break;
+	}
+	rc_ringbuf_free(&buf);
+}
+
+
+/*
+ * Stress runs. Each passes entries numbered 0 up from its producers to its
+ * consumers as fast as they go, yielding whenever the buffer is full or
+ * empty so they also make progress on a single core.
+ */
+static int stress_entries;
+static atomic_int stress_errors;
+static rc_fifobuf_spsc_t spsc = RC_FIFOBUF_SPSC_INITIALIZER;
+static atomic_int spsc_done;
+static int spsc_received;
+static rc_fifobuf_mpmc_t mpmc = RC_FIFOBUF_MPMC_INITIALIZER;
+static atomic_int mpmc_popped;
+static char* mpmc_seen;
+
+static double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+static void* spsc_producer(__attribute__((unused)) void* arg)
+{
+	int i;
+	for(i=0;i<stress_entries;i++){
+		while(rc_fifobuf_spsc_push(&spsc, i)) sched_yield();
+		// publish a partial batch now and then as a producer going idle would
+		if((i&0xFFF)==0) rc_fifobuf_spsc_flush(&spsc);
+	}
+	rc_fifobuf_spsc_flush(&spsc);
+	return NULL;
+}
+
+static void* spsc_consumer(__attribute__((unused)) void* arg)
+{
+	int val, next = 0;
+	while(next<stress_entries){
+		if(rc_fifobuf_spsc_pop(&spsc, &val)){
+			sched_yield();
+			continue;
+		}
+		if(val!=next) atomic_fetch_add(&stress_errors, 1);
+		next = val+1;
+	}
+	rc_fifobuf_spsc_flush_pop(&spsc);
+	return NULL;
+}
+
+// in overwrite mode the producer never waits, the consumer takes what is left
+static void* overwrite_producer(__attribute__((unused)) void* arg)
+{
+	int i;
+	for(i=0;i<stress_entries;i++){
+		if(rc_fifobuf_spsc_push(&spsc, i)) atomic_fetch_add(&stress_errors, 1);
+		// let a consumer on the same core in now and then, but rarely
+		// enough that the producer laps it and drops entries
+		if((i&0xFFF)==0) sched_yield();
+	}
+	atomic_store(&spsc_done, 1);
+	return NULL;
+}
+
+static void* overwrite_consumer(__attribute__((unused)) void* arg)
+{
+	int val, last = -1, done = 0;
+	spsc_received = 0;
+	for(;;){
+		if(rc_fifobuf_spsc_pop(&spsc, &val)){
+			// only stop once empty after seeing the producer finished, so
+			// nothing it pushed is missed
+			if(done) break;
+			done = atomic_load(&spsc_done);
+			if(!done) sched_yield();
+			continue;
+		}
+		// entries may be skipped but never repeated or reordered
+		if(val<=last || val>=stress_entries) atomic_fetch_add(&stress_errors, 1);
+		last = val;
+		spsc_received++;
+	}
+	return NULL;
+}
+
+static void* mpmc_producer(void* arg)
+{
+	int i, id = (int)(long)arg;
+	for(i=0;i<stress_entries;i++){
+		while(rc_fifobuf_mpmc_push(&mpmc, (id<<24)|i)) sched_yield();
+	}
+	return NULL;
+}
+
+static void* mpmc_consumer(__attribute__((unused)) void* arg)
+{
+	int i, val, id, last[MPMC_THREADS];
+	for(i=0;i<MPMC_THREADS;i++) last[i] = -1;
+	while(atomic_load(&mpmc_popped)<MPMC_THREADS*stress_entries){
+		if(rc_fifobuf_mpmc_pop(&mpmc, &val)){
+			sched_yield();
+			continue;
+		}
+		atomic_fetch_add(&mpmc_popped, 1);
+		id = val>>24;
+		val &= 0xFFFFFF;
+		// each producer's entries must arrive in order, and only once
+		if(val<=last[id] || mpmc_seen[id*stress_entries+val]) atomic_fetch_add(&stress_errors, 1);
+		mpmc_seen[id*stress_entries+val] = 1;
+		last[id] = val;
+	}
+	return NULL;
+}
+
+// fails the run if fewer than STRESS_MIN_RATE entries got through per second
+static void report_rate(const char* name, long entries, double sec)
+{
+	double rate = entries/sec;
+	printf("%s: %d errors, %.2f M entries/s\n", name, atomic_load(&stress_errors), rate*1e-6);
+	if(atomic_load(&stress_errors)) errors++;
+	if(rate<STRESS_MIN_RATE){
+		printf("FAIL %s moved under %d entries/s\n", name, STRESS_MIN_RATE);
+		errors++;
+	}
+	atomic_store(&stress_errors, 0);
+}
+
+static void stress_spsc(int batch)
+{
+	char name[32];
+	double t;
+	pthread_t prod, cons;
+
+	rc_fifobuf_spsc_alloc(&spsc, SPSC_SIZE);
+	rc_fifobuf_spsc_set_batch(&spsc, batch);
+	t = now();
+	pthread_create(&cons, NULL, spsc_consumer, NULL);
+	pthread_create(&prod, NULL, spsc_producer, NULL);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+	t = now()-t;
+	if(rc_fifobuf_spsc_available(&spsc)!=0) atomic_fetch_add(&stress_errors, 1);
+	rc_fifobuf_spsc_free(&spsc);
+	snprintf(name, sizeof(name), "spsc batch %d", batch);
+	report_rate(name, stress_entries, t);
+}
+
+static void stress_spsc_overwrite(void)
+{
+	double t;
+	long lost;
+	pthread_t prod, cons;
+
+	rc_fifobuf_spsc_alloc(&spsc, SPSC_SIZE);
+	rc_fifobuf_spsc_set_overwrite(&spsc, 1);
+	atomic_store(&spsc_done, 0);
+	t = now();
+	pthread_create(&cons, NULL, overwrite_consumer, NULL);
+	pthread_create(&prod, NULL, overwrite_producer, NULL);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+	t = now()-t;
+	// every entry that didn't arrive must have been counted as dropped
+	lost = stress_entries-spsc_received;
+	if(lost!=rc_fifobuf_spsc_dropped(&spsc)){
+		printf("FAIL spsc overwrite lost %ld entries but dropped %ld\n",
+			lost, rc_fifobuf_spsc_dropped(&spsc));
+		atomic_fetch_add(&stress_errors, 1);
+	}
+	if(rc_fifobuf_spsc_available(&spsc)!=0) atomic_fetch_add(&stress_errors, 1);
+	rc_fifobuf_spsc_free(&spsc);
+	report_rate("spsc overwrite", stress_entries, t);
+}
+
+static void stress_mpmc(void)
+{
+	int i;
+	double t;
+	pthread_t prod[MPMC_THREADS], cons[MPMC_THREADS];
+
+	rc_fifobuf_mpmc_alloc(&mpmc, MPMC_SIZE);
+	mpmc_seen = (char*)calloc((size_t)MPMC_THREADS*stress_entries, 1);
+	atomic_store(&mpmc_popped, 0);
+	t = now();
+	for(i=0;i<MPMC_THREADS;i++){
+		pthread_create(&cons[i], NULL, mpmc_consumer, NULL);
+		pthread_create(&prod[i], NULL, mpmc_producer, (void*)(long)i);
+	}
+	for(i=0;i<MPMC_THREADS;i++){
+		pthread_join(prod[i], NULL);
+		pthread_join(cons[i], NULL);
+	}
+	t = now()-t;
+	// anything never seen was lost
+	for(i=0;i<MPMC_THREADS*stress_entries;i++){
+		if(!mpmc_seen[i]) atomic_fetch_add(&stress_errors, 1);
+	}
+	if(rc_fifobuf_mpmc_available(&mpmc)!=0) atomic_fetch_add(&stress_errors, 1);
+	free(mpmc_seen);
+	rc_fifobuf_mpmc_free(&mpmc);
+	report_rate("mpmc 4x4", (long)MPMC_THREADS*stress_entries, t);
+}
+
+int main(int argc, char* argv[])
+{
+	int rounds = argc>1 ? atoi(argv[1]) : ROUNDS;
+	seed = argc>2 ? (unsigned int)strtoul(argv[2], NULL, 0) : 1;
+	stress_entries = argc>3 ? atoi(argv[3]) : STRESS_ENTRIES;
+	if(stress_entries>(1<<24)) stress_entries = 1<<24;
+	rng = seed ? seed : 1;
+
+	if(rounds>0){
+		printf("model checking %d fifo and %d ring buffers, seed %u\n", rounds, rounds, seed);
+		for(round_num=0;round_num<rounds && errors<10;round_num++){
+			fifo_round();
+			ring_round();
+		}
+		printf("model check errors, should be 0: %d\n", errors);
+	}
+
+	if(stress_entries>0){
+		printf("passing %d entries through each thread safe fifo\n", stress_entries);
+		stress_spsc(1);
+		stress_spsc(16);
+		stress_spsc_overwrite();
+		stress_mpmc();
+	}
+
+	printf(errors ? "FAILED\n" : "DONE\n");
+	return errors!=0;
+}
@@ -20,12 +20,17 @@
 #include <stdlib.h>
 #include <string.h>
 
-//#define FIFOBUF_TYPE int
+#ifndef FIFOBUF_TYPE
+#define FIFOBUF_TYPE int
+#endif
 #include "fifo_buf.h"
 
 
 #define SIZE 3
 
+// buffer living in static storage, no allocation needed
+RC_FIFOBUF_DECLARE_STATIC(static_buf, SIZE);
+
 static void print_buffer_contents(rc_fifobuf_t* buf_ptr)
 {
 	FIFOBUF_TYPE val;
@@ -36,7 +41,7 @@ static void print_buffer_contents(rc_fifobuf_t* buf_ptr)
 
 static void print_buffer_contents_ptr(rc_fifobuf_t* buf_ptr)
 {
-	FIFOBUF_TYPE * val_ptr;
+	FIFOBUF_TYPE * val_ptr = NULL;
 	rc_fifobuf_pop_ptr(buf_ptr, &val_ptr);
 	printf("%d ", *val_ptr);
 	return;
@@ -44,9 +49,14 @@ static void print_buffer_contents_ptr(rc_fifobuf_t* buf_ptr)
 
 int main()
 {
-	int i;
+	int i, n;
 	FIFOBUF_TYPE val;
+	FIFOBUF_TYPE bulk[4] = {7,8,9,10};
 	rc_fifobuf_t buf = RC_FIFOBUF_INITIALIZER;
+	rc_fifobuf_span_t span = {0};
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters = {0};
+#endif
 
 	printf("Allocating fifobuffer of size: %d\n", SIZE);
 	rc_fifobuf_alloc(&buf, SIZE);
@@ -102,8 +112,89 @@ int main()
 	printf("\n");
 	printf("available returned: %d\n", rc_fifobuf_available(&buf));
 
+	printf("pushing 7,8,9,10 with push_n, should return 3 since only 3 fit\n");
+	printf("push_n returned: %d\n", rc_fifobuf_push_n(&buf, bulk, 4));
+	printf("popping 2 with pop_n, should return 2 and read out 7 8\n");
+	printf("pop_n returned: %d\n", rc_fifobuf_pop_n(&buf, bulk, 2));
+	printf("pop_n read out: %d %d\n", bulk[0], bulk[1]);
+	printf("available returned: %d\n", rc_fifobuf_available(&buf));
+
+	printf("reserving 3 slots, should return 2 since 1 entry is waiting\n");
+	printf("reserve returned: %d\n", rc_fifobuf_reserve(&buf, 3, &span));
+	for(i=0;i<span.len[0];i++) span.d[0][i] = 11+i;
+	for(i=0;i<span.len[1];i++) span.d[1][i] = 11+span.len[0]+i;
+	printf("committing 11,12 written in place\n");
+	rc_fifobuf_commit(&buf, 2);
+	printf("peeking at all entries, should read 9 11 12\n");
+	n = rc_fifobuf_peek(&buf, 3, &span);
+	for(i=0;i<span.len[0];i++) printf("%d ", span.d[0][i]);
+	for(i=0;i<span.len[1];i++) printf("%d ", span.d[1][i]);
+	printf("\n");
+	printf("available before release: %d\n", rc_fifobuf_available(&buf));
+	rc_fifobuf_release(&buf, n);
+	printf("available after release: %d\n", rc_fifobuf_available(&buf));
+
+	printf("turning on overwrite mode and pushing 13,14,15,16, should drop 13\n");
+	rc_fifobuf_set_overwrite(&buf, 1);
+	for(i=13;i<=16;i++) printf("push returned: %d\n", rc_fifobuf_push(&buf, i));
+	printf("dropped returned: %ld\n", rc_fifobuf_dropped(&buf));
+	printf("pushing 17..21 with push_n, should keep 19 20 21\n");
+	printf("push_n returned: %d\n", rc_fifobuf_push_n(&buf, (int[]){17,18,19,20,21}, 5));
+	printf("dropped returned: %ld\n", rc_fifobuf_dropped(&buf));
+	for(i=0;i<SIZE;i++) print_buffer_contents(&buf);
+	printf("\n");
+
+#ifdef RC_BUF_COUNTERS
+	printf("counters should be 21 pushes 15 pops 2 rejected 6 overwrites peak 3\n");
+	rc_fifobuf_counters(&buf, &counters);
+	printf("counters, pushes: %llu pops: %llu rejected: %llu overwrites: %llu peak: %llu\n",
+		(unsigned long long)counters.pushes, (unsigned long long)counters.pops,
+		(unsigned long long)counters.rejected, (unsigned long long)counters.overwrites,
+		(unsigned long long)counters.peak);
+#endif
+
+	printf("pushing 1,2,3, peeking at 2, then pushing 4,5 which drops the peeked 1,2\n");
+	for(i=1;i<=SIZE;i++) rc_fifobuf_push(&buf, i);
+	rc_fifobuf_peek(&buf, 2, &span);
+	rc_fifobuf_push(&buf, 4);
+	rc_fifobuf_push(&buf, 5);
+	printf("releasing the 2 peeked entries, should still read 3 4 5\n");
+	rc_fifobuf_release(&buf, 2);
+	for(i=0;i<SIZE;i++) print_buffer_contents(&buf);
+	printf("\n");
+	printf("reallocating with size %d, dropped should go from 8 to 0\n", SIZE+1);
+	printf("dropped returned: %ld ", rc_fifobuf_dropped(&buf));
+	rc_fifobuf_alloc(&buf, SIZE+1);
+	printf("%ld\n", rc_fifobuf_dropped(&buf));
+
+	rc_fifobuf_free(&buf);
+
+	printf("allocating again with size %d, growable up to 12, shrinking after 4 low pops\n", SIZE);
+	rc_fifobuf_alloc(&buf, SIZE);
+	rc_fifobuf_set_growth(&buf, 12, 4);
+	printf("pushing 1,2,3, popping 2 then pushing 4..12 so the first growth wraps\n");
+	for(i=1;i<=3;i++) rc_fifobuf_push(&buf, i);
+	for(i=0;i<2;i++) rc_fifobuf_pop(&buf, &val);
+	for(i=4;i<=12;i++) rc_fifobuf_push(&buf, i);
+	printf("size should be 12: %d\n", buf.size);
+	printf("pushing 13,14,15 with push_n, should return 2 at the ceiling\n");
+	printf("push_n returned: %d\n", rc_fifobuf_push_n(&buf, (int[]){13,14,15}, 3));
+	printf("popping all 12, should read 3..14\n");
+	for(i=0;i<12;i++) print_buffer_contents(&buf);
+	printf("\n");
+	printf("size after 4 pops under a quarter full, should have shrunk to 6: %d\n", buf.size);
+	printf("reallocating at the same size, growth should be off, max_size 0: ");
+	rc_fifobuf_alloc(&buf, buf.size);
+	printf("%d\n", buf.max_size);
 	rc_fifobuf_free(&buf);
 
+	printf("pushing 1,2,3 into a static buffer, should read 1 2 3\n");
+	for(i=1;i<=SIZE;i++) rc_fifobuf_push(&static_buf, i);
+	for(i=0;i<SIZE;i++) print_buffer_contents(&static_buf);
+	printf("\n");
+	printf("prefault returned: %d\n", rc_fifobuf_prefault(&static_buf, 0));
+	rc_fifobuf_free(&static_buf);
+
 	printf("DONE\n");
 	return 0;
 
@@ -0,0 +1,149 @@
+/**
+ * @file test_fifo_buf_mpmc.c
+ *
+ * @brief      test of fifo_buf_mpmc.h
+ *
+ *             Several producer threads push tagged sequences of integers
+ *             while several consumer threads pop them, checking that every
+ *             value comes out exactly once and that each consumer sees each
+ *             producer's values in order. Half of the threads use the
+ *             blocking push_wait and pop_wait. Then checks overwrite mode
+ *             drops the oldest values.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define RC_FIFOBUF_WAIT
+#define FIFOBUF_TYPE int
+#include "fifo_buf_mpmc.h"
+
+
+#define SIZE 3
+#define THREADS 4
+#define COUNT 100000
+
+static rc_fifobuf_mpmc_t buf = RC_FIFOBUF_MPMC_INITIALIZER;
+static atomic_int popped;
+static atomic_int errors;
+static char seen[THREADS][COUNT];
+
+static void* producer(void* arg)
+{
+	int i, id = (int)(long)arg;
+	for(i=0;i<COUNT;i++){
+		if(id%2) rc_fifobuf_mpmc_push_wait(&buf,(id<<24)|i,-1);
+		else while(rc_fifobuf_mpmc_push(&buf,(id<<24)|i)) sched_yield();
+	}
+	return NULL;
+}
+
+static void* consumer(void* arg)
+{
+	int i, val, id, last[THREADS];
+	int wait = (int)(long)arg%2;
+	for(i=0;i<THREADS;i++) last[i] = -1;
+	while(atomic_load(&popped)<THREADS*COUNT){
+		// waiting consumers time out now and then to notice when the
+		// others have popped the last value
+		if(wait ? rc_fifobuf_mpmc_pop_wait(&buf,&val,1000)
+					: rc_fifobuf_mpmc_pop(&buf,&val)){
+			if(!wait) sched_yield();
+			continue;
+		}
+		atomic_fetch_add(&popped, 1);
+		id = val>>24;
+		val &= 0xFFFFFF;
+		if(val<=last[id] || seen[id][val]) atomic_fetch_add(&errors, 1);
+		seen[id][val] = 1;
+		last[id] = val;
+	}
+	return NULL;
+}
+
+int main()
+{
+	int i, val = 0;
+	pthread_t prod[THREADS], cons[THREADS];
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters;
+#endif
+
+	printf("Allocating mpmc fifobuffer of size: %d\n", SIZE);
+	rc_fifobuf_mpmc_alloc(&buf, SIZE);
+
+	printf("testing read of empty buffer, pop should return -1\n");
+	printf("pop returned: %d\n", rc_fifobuf_mpmc_pop(&buf, &val));
+
+	printf("adding 1,2,3 to the buffer\n");
+	for(i=1;i<=SIZE;i++) rc_fifobuf_mpmc_push(&buf,i);
+	printf("try pushing 4, should return -1 since it's full\n");
+	printf("try_push returned: %d\n", rc_fifobuf_mpmc_try_push(&buf, 4));
+	printf("available returned: %d\n", rc_fifobuf_mpmc_available(&buf));
+	printf("popping all 3 from buffer, should read 1 2 3\n");
+	for(i=0;i<SIZE;i++){
+		rc_fifobuf_mpmc_try_pop(&buf, &val);
+		printf("%d ", val);
+	}
+	printf("\n");
+
+	printf("passing %d values from each of %d producers to %d consumers\n",
+							COUNT, THREADS, THREADS);
+	for(i=0;i<THREADS;i++){
+		pthread_create(&cons[i], NULL, consumer, (void*)(long)i);
+		pthread_create(&prod[i], NULL, producer, (void*)(long)i);
+	}
+	for(i=0;i<THREADS;i++){
+		pthread_join(prod[i], NULL);
+		pthread_join(cons[i], NULL);
+	}
+	// anything never seen was lost
+	for(i=0;i<THREADS*COUNT;i++) if(!seen[i/COUNT][i%COUNT]) errors++;
+	printf("lost, duplicated or out of order values: %d\n", atomic_load(&errors));
+#ifdef RC_BUF_COUNTERS
+	// the buffer was drained so every push must have been popped
+	rc_fifobuf_mpmc_counters(&buf, &counters);
+	printf("counters, pushes: %llu pops: %llu rejected: %llu retries: %llu waits: %llu peak: %llu\n",
+		(unsigned long long)counters.pushes, (unsigned long long)counters.pops,
+		(unsigned long long)counters.rejected, (unsigned long long)counters.retries,
+		(unsigned long long)counters.waits, (unsigned long long)counters.peak);
+	if(counters.pushes!=counters.pops || counters.peak>SIZE) errors++;
+#endif
+	printf("available returned: %d\n", rc_fifobuf_mpmc_available(&buf));
+
+	printf("pushing 1..5 in overwrite mode, should read 3 4 5\n");
+	rc_fifobuf_mpmc_set_overwrite(&buf, 1);
+	for(i=1;i<=5;i++) rc_fifobuf_mpmc_push(&buf,i);
+	printf("dropped returned: %ld\n", rc_fifobuf_mpmc_dropped(&buf));
+#ifdef RC_BUF_COUNTERS
+	{
+		// dropping the oldest entries is an overwrite, not a pop
+		rc_buf_counters_t after;
+		rc_fifobuf_mpmc_counters(&buf, &after);
+		printf("counters since, should be 0 pops 2 overwrites\n");
+		printf("pops: %llu overwrites: %llu\n",
+			(unsigned long long)(after.pops-counters.pops),
+			(unsigned long long)(after.overwrites-counters.overwrites));
+		if(after.pops!=counters.pops || after.overwrites-counters.overwrites!=2) errors++;
+	}
+#endif
+	for(i=0;i<SIZE;i++){
+		rc_fifobuf_mpmc_pop(&buf, &val);
+		printf("%d ", val);
+	}
+	printf("\n");
+	printf("reallocating with size %d, overwrite should go from 1 to 0 and dropped from 2 to 0\n", SIZE+1);
+	printf("before: %d %ld ", buf.overwrite, rc_fifobuf_mpmc_dropped(&buf));
+	rc_fifobuf_mpmc_alloc(&buf, SIZE+1);
+	printf("after: %d %ld\n", buf.overwrite, rc_fifobuf_mpmc_dropped(&buf));
+
+	rc_fifobuf_mpmc_free(&buf);
+
+	printf("DONE\n");
+	return atomic_load(&errors)!=0;
+}
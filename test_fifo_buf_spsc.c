@@ -0,0 +1,193 @@
+/**
+ * @file test_fifo_buf_spsc.c
+ *
+ * @brief      test of fifo_buf_spsc.h
+ *
+ *             Pushes a sequence of integers from a producer thread while the
+ *             main thread pops them, checking that they come out in order
+ *             with nothing lost or duplicated, then does the same again
+ *             with the blocking push_wait and pop_wait, then with batched
+ *             publication of the indices, and finally in
+ *             overwrite mode where values may be dropped but never
+ *             reordered or duplicated.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define RC_FIFOBUF_WAIT
+#define FIFOBUF_TYPE int
+#include "fifo_buf_spsc.h"
+
+
+#define SIZE 3
+#define COUNT 1000000
+#define WAIT_COUNT 100000
+
+static rc_fifobuf_spsc_t buf = RC_FIFOBUF_SPSC_INITIALIZER;
+
+static void* producer(__attribute__((unused)) void* arg)
+{
+	int i;
+	for(i=0;i<COUNT;i++){
+		while(rc_fifobuf_spsc_push(&buf,i)) sched_yield();
+	}
+	return NULL;
+}
+
+static void* waiting_producer(__attribute__((unused)) void* arg)
+{
+	int i;
+	for(i=0;i<WAIT_COUNT;i++) rc_fifobuf_spsc_push_wait(&buf,i,-1);
+	// in batch mode the last few are only published here
+	rc_fifobuf_spsc_flush(&buf);
+	return NULL;
+}
+
+static void* batched_producer(__attribute__((unused)) void* arg)
+{
+	producer(arg);
+	rc_fifobuf_spsc_flush(&buf);
+	return NULL;
+}
+
+int main()
+{
+	int i, val, last, n, status, errors = 0;
+	pthread_t thread;
+	struct timespec t0, t1;
+	char name[64];
+	rc_fifobuf_spsc_t* shm;
+	pid_t pid;
+
+	printf("Allocating spsc fifobuffer of size: %d\n", SIZE);
+	rc_fifobuf_spsc_alloc(&buf, SIZE);
+	printf("data on its own cache line, should be 1: %d\n",
+			(int)((unsigned long)buf.d%RC_FIFOBUF_CACHELINE==0));
+
+	printf("testing read of empty buffer, pop should return -1\n");
+	printf("pop returned: %d\n", rc_fifobuf_spsc_pop(&buf, &val));
+
+	printf("adding 1,2,3 to the buffer\n");
+	for(i=1;i<=SIZE;i++) rc_fifobuf_spsc_push(&buf,i);
+	printf("try pushing 4, should return -1 since it's full\n");
+	printf("push returned: %d\n", rc_fifobuf_spsc_push(&buf, 4));
+	printf("available returned: %d\n", rc_fifobuf_spsc_available(&buf));
+	printf("popping all 3 from buffer, should read 1 2 3\n");
+	for(i=0;i<SIZE;i++){
+		rc_fifobuf_spsc_pop(&buf, &val);
+		printf("%d ", val);
+	}
+	printf("\n");
+
+	printf("passing %d values from a producer thread\n", COUNT);
+	pthread_create(&thread, NULL, producer, NULL);
+	for(i=0;i<COUNT;i++){
+		while(rc_fifobuf_spsc_pop(&buf,&val)) sched_yield();
+		if(val!=i) errors++;
+	}
+	pthread_join(thread, NULL);
+	printf("out of order values: %d\n", errors);
+	printf("available returned: %d\n", rc_fifobuf_spsc_available(&buf));
+
+	printf("waiting 10ms on empty buffer, pop_wait should return -1\n");
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	printf("pop_wait returned: %d\n", rc_fifobuf_spsc_pop_wait(&buf, &val, 10000));
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	printf("waited at least 10ms: %d\n",
+		(t1.tv_sec-t0.tv_sec)*1000000000L + (t1.tv_nsec-t0.tv_nsec) >= 10000000L);
+
+	printf("passing %d values with push_wait and pop_wait\n", WAIT_COUNT);
+	pthread_create(&thread, NULL, waiting_producer, NULL);
+	for(i=0;i<WAIT_COUNT;i++){
+		if(rc_fifobuf_spsc_pop_wait(&buf,&val,-1) || val!=i) errors++;
+	}
+	pthread_join(thread, NULL);
+	printf("out of order values: %d\n", errors);
+
+	printf("publishing every %d entries, a single push should not be visible yet\n", SIZE);
+	rc_fifobuf_spsc_set_batch(&buf, SIZE);
+	rc_fifobuf_spsc_push(&buf, 0);
+	printf("available before and after flush, should be 0 1: %d ", rc_fifobuf_spsc_available(&buf));
+	rc_fifobuf_spsc_flush(&buf);
+	printf("%d\n", rc_fifobuf_spsc_available(&buf));
+	rc_fifobuf_spsc_pop(&buf, &val);
+	rc_fifobuf_spsc_flush_pop(&buf);
+
+	printf("passing %d values from a producer thread in batches\n", COUNT);
+	pthread_create(&thread, NULL, batched_producer, NULL);
+	for(i=0;i<COUNT;i++){
+		while(rc_fifobuf_spsc_pop(&buf,&val)) sched_yield();
+		if(val!=i) errors++;
+	}
+	pthread_join(thread, NULL);
+	printf("out of order values: %d\n", errors);
+
+	printf("passing %d values with push_wait and pop_wait in batches\n", WAIT_COUNT);
+	pthread_create(&thread, NULL, waiting_producer, NULL);
+	for(i=0;i<WAIT_COUNT;i++){
+		if(rc_fifobuf_spsc_pop_wait(&buf,&val,-1) || val!=i) errors++;
+	}
+	pthread_join(thread, NULL);
+	printf("out of order values: %d\n", errors);
+
+	printf("passing %d values in overwrite mode\n", COUNT);
+	rc_fifobuf_spsc_set_overwrite(&buf, 1);
+	pthread_create(&thread, NULL, producer, NULL);
+	last = -1;
+	n = 0;
+	while(last<COUNT-1){
+		if(rc_fifobuf_spsc_pop(&buf,&val)) continue;
+		if(val<=last) errors++;
+		last = val;
+		n++;
+	}
+	pthread_join(thread, NULL);
+	printf("out of order values: %d\n", errors);
+	printf("popped + dropped is %d: %d\n", COUNT,
+				n+rc_fifobuf_spsc_dropped(&buf)==COUNT);
+	for(i=0;i<SIZE+2;i++) rc_fifobuf_spsc_push(&buf,i);
+	printf("reallocating with size %d, overwrite and dropped should go to 0\n", SIZE+1);
+	printf("before: %d %d ", buf.overwrite, rc_fifobuf_spsc_dropped(&buf)>0);
+	rc_fifobuf_spsc_alloc(&buf, SIZE+1);
+	printf("after: %d %ld\n", buf.overwrite, rc_fifobuf_spsc_dropped(&buf));
+
+	rc_fifobuf_spsc_free(&buf);
+
+	printf("passing %d values over shared memory from a child process\n", WAIT_COUNT);
+	snprintf(name, sizeof(name), "/test_fifo_buf_spsc_%d", (int)getpid());
+	shm = rc_fifobuf_spsc_shm_create(name, SIZE);
+	if(shm==NULL) return -1;
+	pid = fork();
+	if(pid==0){
+		// the child maps the segment again by name, at its own address
+		rc_fifobuf_spsc_t* child = rc_fifobuf_spsc_shm_attach(name);
+		if(child==NULL) _exit(1);
+		for(i=0;i<WAIT_COUNT;i++) rc_fifobuf_spsc_push_wait(child,i,-1);
+		rc_fifobuf_spsc_shm_detach(child);
+		_exit(0);
+	}
+	last = -1;
+	n = 0;
+	for(i=0;i<WAIT_COUNT;i++){
+		if(rc_fifobuf_spsc_pop_wait(shm,&val,1000000)) break;
+		if(val!=last+1) n++;
+		last = val;
+	}
+	waitpid(pid, &status, 0);
+	if(i!=WAIT_COUNT || !WIFEXITED(status) || WEXITSTATUS(status)) n++;
+	printf("missing or out of order values: %d\n", n);
+	errors += n;
+	rc_fifobuf_spsc_shm_detach(shm);
+	shm_unlink(name);
+
+	printf("DONE\n");
+	return errors!=0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file test_msg_buf.c
+ *
+ * @brief      test of msg_buf.h
+ *
+ *             Pushes records of different lengths into a small buffer and
+ *             reads them back, both copied out and in place, including one
+ *             which has to go back at the start of memory because it doesn't
+ *             fit before the end.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msg_buf.h"
+
+
+#define SIZE 32
+
+static void print_record(const void* ptr, int len)
+{
+	printf("%d bytes: %.*s\n", len, len, (const char*)ptr);
+	return;
+}
+
+int main()
+{
+	int len;
+	char out[SIZE];
+	const void* ptr = "";
+	void* wptr;
+	rc_msgbuf_t buf = RC_MSGBUF_INITIALIZER;
+
+	printf("Allocating msgbuffer of %d bytes\n", SIZE);
+	rc_msgbuf_alloc(&buf, SIZE);
+
+	printf("testing read of empty buffer, pop should return -1\n");
+	printf("pop returned: %d\n", rc_msgbuf_pop(&buf, out, sizeof(out)));
+
+	printf("pushing \"hi\", \"hello\" and \"\", should take 8+12+4 bytes\n");
+	rc_msgbuf_push(&buf, "hi", 2);
+	rc_msgbuf_push(&buf, "hello", 5);
+	rc_msgbuf_push(&buf, "", 0);
+	printf("available returned: %d used returned: %d\n",
+			rc_msgbuf_available(&buf), rc_msgbuf_used(&buf));
+	printf("try pushing 8 more bytes, should return -1 since it's full\n");
+	printf("push returned: %d\n", rc_msgbuf_push(&buf, "12345678", 8));
+
+	printf("popping \"hi\" and peeking at \"hello\" in place\n");
+	len = rc_msgbuf_pop(&buf, out, sizeof(out));
+	print_record(out, len);
+	len = rc_msgbuf_peek(&buf, &ptr);
+	print_record(ptr, len);
+	rc_msgbuf_release(&buf);
+
+	printf("writing \"world!\" in place, it has to wrap to the start\n");
+	rc_msgbuf_reserve(&buf, 8, &wptr);
+	memcpy(wptr, "world!", 6);
+	rc_msgbuf_commit(&buf, 6);
+	printf("record starts at the beginning of memory: %d\n",
+			(int)((char*)wptr-(char*)buf.d==4));
+
+	printf("popping the rest, should read an empty record then \"world!\"\n");
+	while((len = rc_msgbuf_pop(&buf, out, sizeof(out)))>=0) print_record(out, len);
+	printf("available returned: %d used returned: %d\n",
+			rc_msgbuf_available(&buf), rc_msgbuf_used(&buf));
+
+	rc_msgbuf_free(&buf);
+
+	printf("DONE\n");
+	return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * @file test_rc_buf.cpp
+ *
+ * @brief      test of rc_buf.hpp
+ *
+ *             Runs the same steps as test_ring_buf.c and test_fifo_buf.c on
+ *             the C++ templates, then checks a move-only element type, the
+ *             segment views across the wraparound and inserting a copy of
+ *             the element about to be evicted.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <string>
+
+#include "rc_buf.hpp"
+
+
+static void print_ring(const rc::ring_buf<int, 3>& buf)
+{
+	printf("contents: ");
+	for(std::size_t i=0;i<buf.count();i++) printf("%d ", buf[i]);
+	printf("\n");
+}
+
+int main()
+{
+	int val;
+	rc::ring_buf<int, 3> ring;
+	rc::ring_buf<double, 4> dring;
+	rc::fifo_buf<int, 3> fifo;
+	rc::fifo_buf<std::unique_ptr<std::string>, 2> strings;
+	std::unique_ptr<std::string> s;
+	rc::ring_buf<std::string, 2> names;
+	rc::fifo_buf<std::string, 2> queue;
+	std::string str;
+
+	printf("ring_buf capacity: %zu count of empty buffer: %zu\n",
+			ring.capacity(), ring.count());
+
+	printf("put 1,2,3,4 into ring, should contain: 4 3 2\n");
+	for(int i=1;i<=4;i++) ring.insert(i);
+	print_ring(ring);
+	printf("iterating oldest first, should read: 2 3 4\n");
+	for(int v : ring) printf("%d ", v);
+	printf("\n");
+	printf("sum through iterators, should be 9: %d\n",
+			std::accumulate(ring.begin(), ring.end(), 0));
+
+	printf("put 0.5..5.5 into a power of two sized ring, segments should be 2 and 2 long\n");
+	for(int i=0;i<6;i++) dring.insert(i+0.5);
+	auto seg = dring.segments();
+	printf("segment lengths: %zu %zu first: %.1f newest: %.1f\n",
+			seg[0].size(), seg[1].size(), seg[0][0], dring.newest());
+
+	printf("fifo: push 1,2,3 then 4 should fail\n");
+	for(int i=1;i<=3;i++) fifo.push(i);
+	printf("push returned: %d available: %zu\n", (int)fifo.push(4), fifo.available());
+	printf("popping all 3, should read 1 2 3\n");
+	while(fifo.pop(val)) printf("%d ", val);
+	printf("\n");
+
+	printf("pushing 1..5 in overwrite mode, should read 3 4 5\n");
+	fifo.set_overwrite(true);
+	for(int i=1;i<=5;i++) fifo.push(i);
+	printf("dropped returned: %lu\n", fifo.dropped());
+	while(fifo.pop(val)) printf("%d ", val);
+	printf("\n");
+
+	printf("moving unique_ptrs through a fifo, should read: alpha beta\n");
+	strings.push(std::make_unique<std::string>("alpha"));
+	strings.emplace(new std::string("beta"));
+	printf("push to full returned: %d\n",
+			(int)strings.push(std::make_unique<std::string>("gamma")));
+	while(strings.pop(s)) printf("%s ", s->c_str());
+	printf("\n");
+
+	// long enough to live on the heap, so reading one after it was
+	// destroyed shows up under a sanitizer
+	printf("full ring of strings, inserting a copy of the oldest, should read: second first\n");
+	names.insert("first string, too long for the small string buffer");
+	names.insert("second string, too long for the small string buffer");
+	names.insert(names.oldest());
+	printf("%.6s %.5s\n", names[1].c_str(), names[0].c_str());
+	printf("full fifo in overwrite mode, pushing a copy of the front, should read: second first\n");
+	queue.set_overwrite(true);
+	queue.push("first string, too long for the small string buffer");
+	queue.push("second string, too long for the small string buffer");
+	queue.push(queue.front());
+	while(queue.pop(str)) printf("%.*s ", (int)str.find(' '), str.c_str());
+	printf("\n");
+
+	printf("DONE\n");
+	return 0;
+}
@@ -15,13 +15,28 @@
 #define RINGBUF_TYPE int
 #include "ring_buf.h"
 
+// second instantiation in the same file with its own name
+#undef RINGBUF_TYPE
+#define RINGBUF_TYPE double
+#define RINGBUF_NAME dbl
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#define RINGBUF_TYPE int
+
 
 #define SIZE 3
 
+// buffer living in static storage, no allocation needed
+#if !defined(RC_RINGBUF_STATS) && !defined(RC_RINGBUF_MEDIAN)
+static int static_mem[RC_RINGBUF_STORAGE_LEN(SIZE)];
+static rc_ringbuf_t static_buf = RC_RINGBUF_STATIC_INITIALIZER(static_mem, SIZE);
+#endif
+
 static void print_buffer_contents(rc_ringbuf_t* buf_ptr)
 {
 	int i;
-	RINGBUF_TYPE val;
+	RINGBUF_TYPE val = 0;
 	printf("contents: ");
 	for(i=0;i<SIZE;i++){
 		rc_ringbuf_get_value(buf_ptr, i, &val);
@@ -34,7 +49,7 @@ static void print_buffer_contents(rc_ringbuf_t* buf_ptr)
 static void print_buffer_contents_ptr(rc_ringbuf_t* buf_ptr)
 {
 	int i;
-	RINGBUF_TYPE * val_ptr;
+	RINGBUF_TYPE * val_ptr = NULL;
 	printf("contents: ");
 	for(i=0;i<SIZE;i++){
 		rc_ringbuf_get_value_ptr(buf_ptr, i, &val_ptr);
@@ -44,13 +59,35 @@ static void print_buffer_contents_ptr(rc_ringbuf_t* buf_ptr)
 	return;
 }
 
+static void print_array(RINGBUF_TYPE* a, int n)
+{
+	int i;
+	printf("contents: ");
+	for(i=0;i<n;i++) printf("%d ", a[i]);
+	printf("\n");
+	return;
+}
+
 int main()
 {
 	int i;
+	RINGBUF_TYPE copy[SIZE];
 	rc_ringbuf_t buf = RC_RINGBUF_INITIALIZER;
+	rc_ringbuf_dbl_t dbuf = RC_RINGBUF_INITIALIZER;
+	double dval = 0;
+#ifdef RC_BUF_COUNTERS
+	rc_buf_counters_t counters = {0};
+#endif
+#ifdef RC_RINGBUF_MIRROR
+	RINGBUF_TYPE* window = NULL;
+#endif
+#ifdef RC_RINGBUF_STATS
+	RINGBUF_TYPE lo, hi;
+#endif
 
 	printf("Allocating ringbuffer of size: %d\n", SIZE);
 	rc_ringbuf_alloc(&buf, SIZE);
+	printf("count of empty buffer, should be 0: %d\n", rc_ringbuf_count(&buf));
 
 	// print contents of empty buffer
 	printf("Printing empty buffer contents, should contain: 0 0 0\n");
@@ -70,6 +107,97 @@ int main()
 	printf("Reading back same contents but straight from memory, should contain: 3 2 1\n");
 	print_buffer_contents_ptr(&buf);
 	
+	printf("Putting 4,5 in with insert_n, should contain: 5 4 3\n");
+	rc_ringbuf_insert_n(&buf, (RINGBUF_TYPE[]){4,5}, 2);
+	print_buffer_contents(&buf);
+	printf("Putting 6..10 in with insert_n, should contain: 10 9 8\n");
+	rc_ringbuf_insert_n(&buf, (RINGBUF_TYPE[]){6,7,8,9,10}, 5);
+	print_buffer_contents(&buf);
+	// put back 1 2 3 for the tests below
+	rc_ringbuf_insert_n(&buf, (RINGBUF_TYPE[]){1,2,3}, 3);
+
+	printf("Copying out oldest first, should contain: 1 2 3\n");
+	rc_ringbuf_copy_ordered(&buf, copy, SIZE, RC_RINGBUF_OLDEST_FIRST);
+	print_array(copy, SIZE);
+	printf("Copying out newest first, should contain: 3 2 1\n");
+	rc_ringbuf_copy_ordered(&buf, copy, SIZE, RC_RINGBUF_NEWEST_FIRST);
+	print_array(copy, SIZE);
+	printf("Copying out every other value oldest first, should contain: 1 3\n");
+	rc_ringbuf_copy_decimated(&buf, copy, 2, 2, RC_RINGBUF_OLDEST_FIRST);
+	print_array(copy, 2);
+
+#ifdef RC_RINGBUF_MIRROR
+	printf("Reading contiguous window oldest first, should contain: 1 2 3\n");
+	rc_ringbuf_window(&buf, &window);
+	printf("contents: ");
+	for(i=0;i<SIZE;i++) printf("%d ", window[i]);
+	printf("\n");
+#endif
+
+#ifdef RC_RINGBUF_STATS
+	printf("Running statistics of 3 2 1, should be sum 6 mean 2 variance 0.667 min 1 max 3\n");
+	rc_ringbuf_sum(&buf, &dval);
+	printf("sum: %g ", dval);
+	rc_ringbuf_mean(&buf, &dval);
+	printf("mean: %g ", dval);
+	rc_ringbuf_variance(&buf, &dval);
+	printf("variance: %.3f ", dval);
+	rc_ringbuf_min(&buf, &lo);
+	rc_ringbuf_max(&buf, &hi);
+	printf("min: %d max: %d\n", lo, hi);
+#endif
+
+#ifdef RC_BUF_COUNTERS
+	rc_ringbuf_counters(&buf, &counters);
+	printf("counters should be 17 inserts 14 overwrites peak 3\n");
+	printf("inserts: %llu overwrites: %llu peak: %llu\n",
+		(unsigned long long)counters.pushes, (unsigned long long)counters.overwrites,
+		(unsigned long long)counters.peak);
+#endif
+
+#ifdef RC_RINGBUF_MEDIAN
+	printf("Sliding median of 3 2 1, should be median 2 25th percentile 1.5 max 3\n");
+	rc_ringbuf_median(&buf, &dval);
+	printf("median: %g ", dval);
+	rc_ringbuf_percentile(&buf, 25.0, &dval);
+	printf("25th: %g ", dval);
+	rc_ringbuf_percentile(&buf, 100.0, &dval);
+	printf("100th: %g\n", dval);
+	printf("Spike of 100 after 3 2 1 then 4, median should be 3 then 4\n");
+	rc_ringbuf_insert(&buf, 100);
+	rc_ringbuf_median(&buf, &dval);
+	printf("median: %g ", dval);
+	rc_ringbuf_insert(&buf, 4);
+	rc_ringbuf_median(&buf, &dval);
+	printf("%g\n", dval);
+#endif
+
+	printf("Resetting and putting 7 in, count should go from 3 to 0 to 1\n");
+	printf("count: %d ", rc_ringbuf_count(&buf));
+	rc_ringbuf_reset(&buf);
+	printf("%d ", rc_ringbuf_count(&buf));
+	rc_ringbuf_insert(&buf, 7);
+	printf("%d\n", rc_ringbuf_count(&buf));
+
+	printf("Putting 0.5,1.5,2.5 into a double buffer, should contain: 2.5 1.5 0.5\n");
+	rc_ringbuf_dbl_alloc(&dbuf, SIZE);
+	for(i=0;i<SIZE;i++) rc_ringbuf_dbl_insert(&dbuf, i+0.5);
+	printf("contents: ");
+	for(i=0;i<SIZE;i++){
+		rc_ringbuf_dbl_get_value(&dbuf, i, &dval);
+		printf("%.1f ", dval);
+	}
+	printf("\n");
+	rc_ringbuf_dbl_free(&dbuf);
+
+#if !defined(RC_RINGBUF_STATS) && !defined(RC_RINGBUF_MEDIAN)
+	printf("Putting 1,2,3 into a static buffer, should contain: 3 2 1\n");
+	for(i=1;i<=SIZE;i++) rc_ringbuf_insert(&static_buf, i);
+	print_buffer_contents(&static_buf);
+	printf("prefault returned: %d\n", rc_ringbuf_prefault(&static_buf, 0));
+	rc_ringbuf_free(&static_buf);
+#endif
+
 	rc_ringbuf_free(&buf);
 
 	printf("DONE\n");
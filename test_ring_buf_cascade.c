@@ -0,0 +1,65 @@
+/**
+ * @file test_ring_buf_cascade.c
+ *
+ * @brief      test of ring_buf_cascade.h
+ *
+ *             Feeds a ramp into a three level cascade which halves the rate
+ *             at each level and prints what each level remembers.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RINGBUF_TYPE double
+#include "ring_buf.h"
+#include "ring_buf_cascade.h"
+
+
+#define LEVELS 3
+
+static void print_ring(rc_ringbuf_t* buf)
+{
+	int i;
+	double val = 0;
+	printf("contents: ");
+	for(i=0;i<rc_ringbuf_count(buf);i++){
+		rc_ringbuf_get_value(buf, i, &val);
+		printf("%g ", val);
+	}
+	printf("\n");
+	return;
+}
+
+int main()
+{
+	int i;
+	int sizes[LEVELS] = {4, 3, 3};
+	int factors[LEVELS] = {1, 2, 2};
+	rc_ringbuf_cascade_t c = RC_RINGBUF_CASCADE_INITIALIZER;
+
+	printf("Allocating cascade with %d levels, each half the rate of the last\n", LEVELS);
+	rc_ringbuf_cascade_alloc(&c, LEVELS, sizes, factors);
+
+	printf("put 1..16 in\n");
+	for(i=1;i<=16;i++) rc_ringbuf_cascade_insert(&c, i);
+
+	printf("level 0 should contain: 16 15 14 13\n");
+	print_ring(rc_ringbuf_cascade_level(&c, 0, RC_RINGBUF_CASCADE_MEAN));
+	printf("level 1 means should be: 15.5 13.5 11.5\n");
+	print_ring(rc_ringbuf_cascade_level(&c, 1, RC_RINGBUF_CASCADE_MEAN));
+	printf("level 2 means should be: 14.5 10.5 6.5\n");
+	print_ring(rc_ringbuf_cascade_level(&c, 2, RC_RINGBUF_CASCADE_MEAN));
+	printf("level 2 mins should be: 13 9 5\n");
+	print_ring(rc_ringbuf_cascade_level(&c, 2, RC_RINGBUF_CASCADE_MIN));
+	printf("level 2 maxes should be: 16 12 8\n");
+	print_ring(rc_ringbuf_cascade_level(&c, 2, RC_RINGBUF_CASCADE_MAX));
+
+	rc_ringbuf_cascade_free(&c);
+
+	printf("DONE\n");
+	return 0;
+}
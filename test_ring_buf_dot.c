@@ -0,0 +1,121 @@
+/**
+ * @file test_ring_buf_dot.c
+ *
+ * @brief      test of rc_ringbuf_dot
+ *
+ *             Checks rc_ringbuf_dot on float and double buffers against a
+ *             plain loop over rc_ringbuf_get_value, for every number of
+ *             coefficients up to the buffer size and with the buffer index
+ *             at every position, so each vector loop is run with every
+ *             leftover tail length and with the wraparound falling at every
+ *             point. The values and coefficients are small integers so the
+ *             sums are exact whatever order the kernel adds them in.
+ *
+ *             The kernel is picked at compile time, so build and run it
+ *             once for each path the target has, with and without the
+ *             mirror, for example on x86:
+ *
+ *             gcc -O2 test_ring_buf_dot.c -o test_ring_buf_dot
+ *             gcc -O2 -mavx test_ring_buf_dot.c -o test_ring_buf_dot
+ *             gcc -O2 -mavx -mfma test_ring_buf_dot.c -o test_ring_buf_dot
+ *             gcc -O2 -DRC_RINGBUF_NO_SIMD test_ring_buf_dot.c -o test_ring_buf_dot
+ *
+ *             each also with -DRC_RINGBUF_MIRROR, and on arm with and without
+ *             -mfpu=neon or on aarch64.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define RINGBUF_TYPE float
+#define RINGBUF_NAME f32
+#define RC_RINGBUF_FLOAT
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#undef RC_RINGBUF_FLOAT
+#define RINGBUF_TYPE double
+#define RINGBUF_NAME f64
+#define RC_RINGBUF_DOUBLE
+#include "ring_buf.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#undef RC_RINGBUF_DOUBLE
+
+
+// longer than two rounds of the widest unrolled loop plus its tail
+#define SIZE 37
+
+/*
+ * Fills the buffer past one full lap and after each insert compares dot
+ * against get_value for every n, returns the number of mismatches.
+ */
+#define TEST_TYPE(NAME, TYPE)							\
+static int test_##NAME(void)							\
+{										\
+	int i, n, k, errors = 0;						\
+	TYPE coeffs[SIZE], out, val, expect;					\
+	rc_ringbuf_##NAME##_t buf = RC_RINGBUF_INITIALIZER;			\
+	for(i=0;i<SIZE;i++) coeffs[i] = (TYPE)((i*7)%11-5);			\
+	rc_ringbuf_##NAME##_alloc(&buf, SIZE);					\
+	for(i=0;i<2*SIZE;i++){							\
+		rc_ringbuf_##NAME##_insert(&buf, (TYPE)((i*5)%13-6));		\
+		for(n=1;n<=SIZE;n++){						\
+			expect = 0;						\
+			for(k=0;k<n;k++){					\
+				val = 0;					\
+				rc_ringbuf_##NAME##_get_value(&buf, k, &val);	\
+				expect += coeffs[n-1-k]*val;			\
+			}							\
+			out = 0;						\
+			if(rc_ringbuf_##NAME##_dot(&buf, coeffs, n, &out) || out!=expect){ \
+				if(errors<5) printf("insert %d n %d: got %g expected %g\n", \
+					i, n, (double)out, (double)expect);	\
+				errors++;					\
+			}							\
+		}								\
+	}									\
+	rc_ringbuf_##NAME##_free(&buf);						\
+	return errors;								\
+}
+
+TEST_TYPE(f32, float)
+TEST_TYPE(f64, double)
+
+int main()
+{
+	int errors, e;
+
+#if defined(RC_RINGBUF_NO_SIMD)
+	printf("kernel: scalar\n");
+#elif defined(__AVX__) && defined(__FMA__)
+	printf("kernel: avx with fma\n");
+#elif defined(__AVX__)
+	printf("kernel: avx\n");
+#elif defined(__SSE2__)
+	printf("kernel: sse2\n");
+#elif defined(__ARM_NEON)
+	printf("kernel: neon\n");
+#else
+	printf("kernel: scalar\n");
+#endif
+#ifdef RC_RINGBUF_MIRROR
+	printf("mirrored buffer\n");
+#endif
+
+	printf("float dot against get_value, mismatches should be 0\n");
+	errors = test_f32();
+	printf("%d\n", errors);
+	printf("double dot against get_value, mismatches should be 0\n");
+	e = test_f64();
+	printf("%d\n", e);
+	errors += e;
+
+	printf(errors ? "FAILED\n" : "DONE\n");
+	return errors!=0;
+}
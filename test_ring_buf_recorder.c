@@ -0,0 +1,139 @@
+/**
+ * @file test_ring_buf_recorder.c
+ *
+ * @brief      test of ring_buf_recorder.h
+ *
+ *             Records samples into a file backed ring, reopens it to check
+ *             they were kept, then has a child process die partway through
+ *             an insert and recovers what it left behind. The child dies
+ *             once before the new index is published and once after, with
+ *             the ring full and with it partly filled.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define RINGBUF_TYPE double
+#include "ring_buf.h"
+#include "ring_buf_recorder.h"
+
+
+#define SIZE 5
+#define PATH "/tmp/test_ring_buf_recorder.bin"
+
+// prints what recovery makes of the file
+static void print_recovered(void)
+{
+	int i, n;
+	double* data = NULL;
+	rc_ringbuf_recorder_header_t hdr;
+	n = rc_ringbuf_recorder_recover(PATH, &hdr, (void**)&data);
+	printf("%d samples, generation odd: %d\n", n, (int)(hdr.generation&1));
+	for(i=0;i<n;i++) printf("%g ", data[i]);
+	printf("\n");
+	free(data);
+}
+
+// has a child record val completely apart from the closing generation bump,
+// as if killed after publishing the new index and count
+static void die_after_publish(double val)
+{
+	pid_t pid = fork();
+	if(pid==0){
+		rc_ringbuf_recorder_t buf = RC_RINGBUF_RECORDER_INITIALIZER;
+		rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+		rc_ringbuf_recorder_insert(&buf, val);
+		buf.hdr->generation--;
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+static void print_ring(rc_ringbuf_t* buf)
+{
+	int i;
+	double val = 0;
+	printf("contents: ");
+	for(i=0;i<rc_ringbuf_count(buf);i++){
+		rc_ringbuf_get_value(buf, i, &val);
+		printf("%g ", val);
+	}
+	printf("\n");
+	return;
+}
+
+int main()
+{
+	int i;
+	pid_t pid;
+	rc_ringbuf_recorder_t buf = RC_RINGBUF_RECORDER_INITIALIZER;
+	rc_ringbuf_recorder_t other = RC_RINGBUF_RECORDER_INITIALIZER;
+
+	unlink(PATH);
+	printf("Creating recorder of size %d in %s\n", SIZE, PATH);
+	rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+	printf("put values 1..7 in and close\n");
+	for(i=1;i<=7;i++) rc_ringbuf_recorder_insert(&buf, i);
+	rc_ringbuf_recorder_close(&buf);
+
+	printf("reopening, should still contain 7 6 5 4 3\n");
+	rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+	print_ring(&buf.ring);
+	printf("opening with another size should fail\n");
+	printf("returned: %d\n", rc_ringbuf_recorder_open(&other, PATH, SIZE+1));
+	rc_ringbuf_recorder_close(&buf);
+
+	printf("child records 8, 9, 10 then dies partway through recording 11\n");
+	pid = fork();
+	if(pid==0){
+		rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+		for(i=8;i<=10;i++) rc_ringbuf_recorder_insert(&buf, i);
+		// the first half of an insert, as if killed right after it
+		buf.hdr->writing = (buf.ring.index+1)%SIZE;
+		buf.hdr->writing_count = SIZE;
+		buf.hdr->generation++;
+		buf.ring.d[buf.hdr->writing] = 11;
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+
+	printf("recovering, should be 4 samples 7 8 9 10 oldest first\n");
+	print_recovered();
+
+	printf("reopening and recording 12, should contain 12 10 9 8 7\n");
+	rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+	rc_ringbuf_recorder_insert(&buf, 12);
+	print_ring(&buf.ring);
+	printf("sync returned: %d\n", rc_ringbuf_recorder_sync(&buf));
+	rc_ringbuf_recorder_insert(&buf, 13);
+	rc_ringbuf_recorder_close(&buf);
+
+	printf("child records 14 and dies after publishing its index\n");
+	die_after_publish(14);
+	printf("recovering, should be 4 samples 9 10 12 13 oldest first\n");
+	print_recovered();
+	printf("reopening, should contain 13 12 10 9\n");
+	rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+	print_ring(&buf.ring);
+	rc_ringbuf_recorder_close(&buf);
+	unlink(PATH);
+
+	printf("new file, recording 1 and 2, child dies after publishing 3\n");
+	rc_ringbuf_recorder_open(&buf, PATH, SIZE);
+	rc_ringbuf_recorder_insert(&buf, 1);
+	rc_ringbuf_recorder_insert(&buf, 2);
+	rc_ringbuf_recorder_close(&buf);
+	die_after_publish(3);
+	printf("recovering, should be 2 samples 1 2 oldest first\n");
+	print_recovered();
+	unlink(PATH);
+
+	printf("DONE\n");
+	return 0;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file test_ring_buf_soa.c
+ *
+ * @brief      test of ring_buf_soa.h
+ *
+ *             Puts 3 channel samples into a multi-channel ring buffer, reads
+ *             them back per channel and runs a filter over one channel's
+ *             column through a view.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define RINGBUF_TYPE double
+#define RC_RINGBUF_DOUBLE
+#include "ring_buf.h"
+#include "ring_buf_soa.h"
+
+
+#define CHANNELS 3
+#define SIZE 4
+
+static void print_ring(rc_ringbuf_t* buf)
+{
+	int i;
+	double val = 0;
+	printf("contents: ");
+	for(i=0;i<rc_ringbuf_count(buf);i++){
+		rc_ringbuf_get_value(buf, i, &val);
+		printf("%g ", val);
+	}
+	printf("\n");
+	return;
+}
+
+int main()
+{
+	int i, ch;
+	double sample[CHANNELS], val = 0;
+	double coeffs[2] = {0.5, 0.5};
+	rc_ringbuf_soa_t buf = RC_RINGBUF_SOA_INITIALIZER;
+	rc_ringbuf_t view;
+
+	printf("Allocating buffer of %d samples with %d channels\n", SIZE, CHANNELS);
+	rc_ringbuf_soa_alloc(&buf, CHANNELS, SIZE);
+	printf("column stride: %d elements, second column cache line aligned: %d\n",
+		buf.stride, (int)(((uintptr_t)&buf.d[buf.stride])%64==0));
+
+	printf("put samples {i, 10i, 100i} for i=1..6 in\n");
+	for(i=1;i<=6;i++){
+		sample[0] = i;
+		sample[1] = 10*i;
+		sample[2] = 100*i;
+		rc_ringbuf_soa_insert(&buf, sample);
+	}
+	printf("most recent sample should be: 6 60 600\n");
+	for(ch=0;ch<CHANNELS;ch++){
+		rc_ringbuf_soa_get_value(&buf, ch, 0, &val);
+		printf("%g ", val);
+	}
+	printf("\n");
+
+	printf("channel 1 should contain: 60 50 40 30\n");
+	rc_ringbuf_soa_channel(&buf, 1, &view);
+	print_ring(&view);
+	printf("2 tap moving average of channel 2, should be 550\n");
+	rc_ringbuf_soa_channel(&buf, 2, &view);
+	rc_ringbuf_dot(&view, coeffs, 2, &val);
+	printf("result: %g\n", val);
+
+	printf("resetting, count now: ");
+	rc_ringbuf_soa_reset(&buf);
+	rc_ringbuf_soa_channel(&buf, 0, &view);
+	printf("%d\n", rc_ringbuf_count(&view));
+
+	rc_ringbuf_soa_free(&buf);
+
+	printf("DONE\n");
+	return 0;
+}
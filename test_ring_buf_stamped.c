@@ -0,0 +1,109 @@
+/**
+ * @file test_ring_buf_stamped.c
+ *
+ * @brief      test of ring_buf_stamped.h
+ *
+ *             Fills a timestamped ring past its wraparound with samples of a
+ *             ramp at uneven intervals, then looks values up by time and
+ *             checks lookups outside the window fail. Then does the same
+ *             with a struct of two values blended by a user lerp.
+ *
+ * @author     James Strawson
+ * @date       2019
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct vec2_t {
+	double x, y;
+} vec2_t;
+
+static inline vec2_t vec2_lerp(vec2_t a, vec2_t b, double f)
+{
+	vec2_t v = {a.x+(b.x-a.x)*f, a.y+(b.y-a.y)*f};
+	return v;
+}
+
+#define RINGBUF_TYPE double
+#define RC_RINGBUF_STAMPED_INTERPOLATE
+#include "ring_buf.h"
+#include "ring_buf_stamped.h"
+#undef RINGBUF_TYPE
+#undef RC_RINGBUF_STAMPED_INTERPOLATE
+#define RINGBUF_TYPE vec2_t
+#define RINGBUF_NAME vec2
+#define RC_RINGBUF_STAMPED_LERP(a, b, f)	vec2_lerp(a, b, f)
+#include "ring_buf.h"
+#include "ring_buf_stamped.h"
+#undef RINGBUF_TYPE
+#undef RINGBUF_NAME
+#undef RC_RINGBUF_STAMPED_LERP
+
+
+#define SIZE 5
+
+int main()
+{
+	int i;
+	double val;
+	vec2_t v = {0, 0};
+	uint64_t stamps[7] = {100, 200, 250, 400, 420, 500, 700};
+	rc_ringbuf_stamped_t buf = RC_RINGBUF_STAMPED_INITIALIZER;
+	rc_ringbuf_stamped_vec2_t vbuf = RC_RINGBUF_STAMPED_INITIALIZER;
+
+	printf("Allocating buffer of size %d\n", SIZE);
+	rc_ringbuf_stamped_alloc(&buf, SIZE);
+
+	printf("lookup in empty buffer should return -1: %d\n",
+		rc_ringbuf_stamped_find(&buf, 100));
+
+	printf("put values 1..7 in at times 100 200 250 400 420 500 700\n");
+	for(i=0;i<7;i++) rc_ringbuf_stamped_insert(&buf, stamps[i], i+1);
+	printf("inserting at time 600 should fail\n");
+	printf("returned: %d\n", rc_ringbuf_stamped_insert(&buf, 600, 8.0));
+
+	printf("positions of times 250 399 420 699 900, should be: 4 4 2 1 0\n");
+	printf("%d %d %d %d %d\n",
+		rc_ringbuf_stamped_find(&buf, 250),
+		rc_ringbuf_stamped_find(&buf, 399),
+		rc_ringbuf_stamped_find(&buf, 420),
+		rc_ringbuf_stamped_find(&buf, 699),
+		rc_ringbuf_stamped_find(&buf, 900));
+	printf("time 200 is older than the window, should be -1: %d\n",
+		rc_ringbuf_stamped_find(&buf, 200));
+
+	printf("values at times 250 325 410 600 700, should be: 3 3.5 4.5 6.5 7\n");
+	rc_ringbuf_stamped_interpolate(&buf, 250, &val);
+	printf("%g ", val);
+	rc_ringbuf_stamped_interpolate(&buf, 325, &val);
+	printf("%g ", val);
+	rc_ringbuf_stamped_interpolate(&buf, 410, &val);
+	printf("%g ", val);
+	rc_ringbuf_stamped_interpolate(&buf, 600, &val);
+	printf("%g ", val);
+	rc_ringbuf_stamped_interpolate(&buf, 700, &val);
+	printf("%g\n", val);
+	printf("interpolating at time 701 should return -1: %d\n",
+		rc_ringbuf_stamped_interpolate(&buf, 701, &val));
+
+	rc_ringbuf_stamped_free(&buf);
+
+	printf("put {i, -10i} for i=1..7 in a struct buffer at the same times\n");
+	rc_ringbuf_stamped_vec2_alloc(&vbuf, SIZE);
+	for(i=0;i<7;i++){
+		v.x = i+1;
+		v.y = -10*(i+1);
+		rc_ringbuf_stamped_vec2_insert(&vbuf, stamps[i], v);
+	}
+	printf("position of time 420 should be 2: %d\n",
+		rc_ringbuf_stamped_vec2_find(&vbuf, 420));
+	printf("value at time 325 should be: 3.5 -35\n");
+	rc_ringbuf_stamped_vec2_interpolate(&vbuf, 325, &v);
+	printf("%g %g\n", v.x, v.y);
+	rc_ringbuf_stamped_vec2_free(&vbuf);
+
+	printf("DONE\n");
+	return 0;
+}